@@ -0,0 +1,491 @@
+#include "Benchmark.h"
+#include "VulkanApp.h"
+#include "SimdMath.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+
+static std::vector<uint32_t> ParseList(const char* text)
+{
+	std::vector<uint32_t> result;
+	std::stringstream list(text);
+	std::string item;
+	while (std::getline(list, item, ',')) result.push_back((uint32_t)std::stoul(item));
+	return result;
+}
+
+BenchmarkOptions BenchmarkOptions::Parse(int argc, char** argv)
+{
+	BenchmarkOptions options;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--frames" && i + 1 < argc) options.frames = (uint32_t)std::stoul(argv[++i]);
+		else if (arg == "--warmup" && i + 1 < argc) options.warmupFrames = (uint32_t)std::stoul(argv[++i]);
+		else if (arg == "--out" && i + 1 < argc) options.outputPath = argv[++i];
+		else if (arg == "--baseline" && i + 1 < argc) options.baselinePath = argv[++i];
+		else if (arg == "--threshold" && i + 1 < argc) options.threshold = std::stod(argv[++i]);
+		else if (arg == "--triangles" && i + 1 < argc) options.triangleCounts = ParseList(argv[++i]);
+		else if (arg == "--objects" && i + 1 < argc) options.instanceCounts = ParseList(argv[++i]);
+		else if (arg == "--mesh-triangles" && i + 1 < argc) options.meshTriangleCounts = ParseList(argv[++i]);
+		else if (arg == "--particle-counts" && i + 1 < argc) options.particleCounts = ParseList(argv[++i]);
+		else if (arg == "--capture-formats" && i + 1 < argc) {
+			options.captureFormats.clear();
+			std::stringstream list(argv[++i]);
+			std::string item;
+			while (std::getline(list, item, ',')) {
+				options.captureFormats.emplace_back();
+				if (!ParseCaptureFormat(item, options.captureFormats.back())) throw std::runtime_error("unknown capture format");
+			}
+		}
+	}
+	return options;
+}
+
+Percentiles Percentiles::From(std::vector<double> samples)
+{
+	Percentiles result;
+	if (samples.empty()) return result;
+	std::sort(samples.begin(), samples.end());
+	auto rank = [&](double p) {
+		size_t index = (size_t)(p * (samples.size() - 1) + 0.5);
+		return samples[std::min(index, samples.size() - 1)];
+	};
+	double sum = 0;
+	for (auto sample : samples) sum += sample;
+	result.mean = sum / samples.size();
+	result.p50 = rank(0.50);
+	result.p95 = rank(0.95);
+	result.p99 = rank(0.99);
+	return result;
+}
+
+static ScenarioResult RunScenario(AppConfig config, const BenchmarkOptions& options, const std::string& name)
+{
+	config.readback = false;
+	VulkanApp app(config);
+	std::vector<double> stages[(size_t)FrameStage::Count];
+	std::vector<double> gpu;
+	std::vector<double> latency;
+	std::vector<double> scales;
+	for (uint32_t i = 0; i < options.warmupFrames; i++) {
+		if (!app.PumpEvents()) break;
+		app.DrawFrame();
+	}
+	auto start = std::chrono::steady_clock::now();
+	uint32_t frames = 0;
+	for (; frames < options.frames; frames++) {
+		if (!app.PumpEvents()) break;
+		app.DrawFrame();
+		auto& timing = app.LastFrameTiming();
+		for (size_t s = 0; s < (size_t)FrameStage::Count; s++) stages[s].push_back(timing.cpu[s]);
+		if (timing.gpu >= 0) gpu.push_back(timing.gpu);
+		if (timing.latency >= 0) latency.push_back(timing.latency);
+		if (app.DynamicResolution()) scales.push_back(app.Resolution().scale);
+	}
+	auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	ScenarioResult result;
+	result.name = name;
+	result.objects = (uint32_t)app.ObjectCount();
+	result.visibleObjects = (uint32_t)app.VisibleCount();
+	result.triangles = config.triangleCount * std::max(1u, config.instanceCount);
+	result.drawCalls = (uint32_t)app.DrawCallsPerFrame();
+	result.frames = frames;
+	result.seconds = seconds;
+	result.fps = seconds > 0 ? frames / seconds : 0;
+	result.trianglesPerSecond = result.fps * result.triangles;
+	result.drawsPerSecond = result.fps * result.objects;
+	result.pipelineCreateTime = app.PipelineCreateTime();
+	result.pipelineCacheWarm = app.PipelineCacheWarm();
+	auto memory = app.MemoryUsage();
+	result.memoryUsedBytes = memory.usedBytes;
+	result.memoryReservedBytes = memory.reservedBytes;
+	result.deviceAllocations = memory.deviceAllocations;
+	result.meshLoad = app.MeshLoad();
+	result.particles = (uint32_t)app.ParticleCount();
+	result.asyncCompute = result.particles > 0 && app.AsyncCompute();
+	result.overlapped = result.particles > 0 && config.particleOverlap;
+	if (!config.capture.directory.empty()) {
+		auto capture = app.CaptureStatistics();
+		result.captureFormat = CaptureFormatName(config.capture.format);
+		result.capturedFrames = capture.captured;
+		result.droppedFrames = capture.dropped;
+	}
+	if (!scales.empty()) {
+		result.dynamicResolution = true;
+		result.renderScale = Percentiles::From(std::move(scales));
+		result.scaleChanges = app.Resolution().raises + app.Resolution().lowers;
+	}
+	for (size_t s = 0; s < (size_t)FrameStage::Count; s++) {
+		result.stages.emplace_back(FrameStageName((FrameStage)s), Percentiles::From(std::move(stages[s])));
+	}
+	if (!gpu.empty()) result.stages.emplace_back("gpu", Percentiles::From(std::move(gpu)));
+	if (!latency.empty()) result.stages.emplace_back("latency", Percentiles::From(std::move(latency)));
+	return result;
+}
+
+static void WriteJson(std::ostream& out, const std::vector<ScenarioResult>& results)
+{
+	out.precision(6);
+	out << std::fixed << "{\n\t\"scenarios\": [\n";
+	for (size_t i = 0; i < results.size(); i++) {
+		auto& r = results[i];
+		out << "\t\t{\n";
+		out << "\t\t\t\"name\": \"" << r.name << "\",\n";
+		out << "\t\t\t\"triangles\": " << r.triangles << ",\n";
+		out << "\t\t\t\"objects\": " << r.objects << ",\n";
+		out << "\t\t\t\"visibleObjects\": " << r.visibleObjects << ",\n";
+		out << "\t\t\t\"drawCalls\": " << r.drawCalls << ",\n";
+		out << "\t\t\t\"frames\": " << r.frames << ",\n";
+		out << "\t\t\t\"seconds\": " << r.seconds << ",\n";
+		out << "\t\t\t\"fps\": " << r.fps << ",\n";
+		out << "\t\t\t\"trianglesPerSecond\": " << r.trianglesPerSecond << ",\n";
+		out << "\t\t\t\"drawsPerSecond\": " << r.drawsPerSecond << ",\n";
+		out << "\t\t\t\"pipelineCreateMs\": " << r.pipelineCreateTime << ",\n";
+		out << "\t\t\t\"pipelineCacheWarm\": " << (r.pipelineCacheWarm ? 1 : 0) << ",\n";
+		out << "\t\t\t\"memoryUsedBytes\": " << r.memoryUsedBytes << ",\n";
+		out << "\t\t\t\"memoryReservedBytes\": " << r.memoryReservedBytes << ",\n";
+		out << "\t\t\t\"deviceAllocations\": " << r.deviceAllocations << ",\n";
+		if (r.meshLoad.bytes > 0) {
+			out << "\t\t\t\"meshBytes\": " << r.meshLoad.bytes << ",\n";
+			out << "\t\t\t\"meshReadMs\": " << r.meshReadTime << ",\n";
+			out << "\t\t\t\"meshOpenMs\": " << r.meshLoad.open << ",\n";
+			out << "\t\t\t\"meshFirstChunkMs\": " << r.meshLoad.firstChunk << ",\n";
+			out << "\t\t\t\"meshResidentMs\": " << r.meshLoad.resident << ",\n";
+			out << "\t\t\t\"meshResidentFrames\": " << r.meshLoad.residentFrames << ",\n";
+		}
+		if (r.particles > 0) {
+			out << "\t\t\t\"particles\": " << r.particles << ",\n";
+			out << "\t\t\t\"asyncCompute\": " << (r.asyncCompute ? 1 : 0) << ",\n";
+			out << "\t\t\t\"overlapped\": " << (r.overlapped ? 1 : 0) << ",\n";
+		}
+		if (!r.captureFormat.empty()) {
+			out << "\t\t\t\"captureFormat\": \"" << r.captureFormat << "\",\n";
+			out << "\t\t\t\"capturedFrames\": " << r.capturedFrames << ",\n";
+			out << "\t\t\t\"droppedFrames\": " << r.droppedFrames << ",\n";
+		}
+		if (r.dynamicResolution) {
+			out << "\t\t\t\"renderScale\": { \"mean\": " << r.renderScale.mean << ", \"p50\": " << r.renderScale.p50
+				<< ", \"p95\": " << r.renderScale.p95 << ", \"p99\": " << r.renderScale.p99 << " },\n";
+			out << "\t\t\t\"scaleChanges\": " << r.scaleChanges << ",\n";
+		}
+		out << "\t\t\t\"stages\": {\n";
+		for (size_t s = 0; s < r.stages.size(); s++) {
+			auto& p = r.stages[s].second;
+			out << "\t\t\t\t\"" << r.stages[s].first << "\": { \"mean\": " << p.mean << ", \"p50\": " << p.p50
+				<< ", \"p95\": " << p.p95 << ", \"p99\": " << p.p99 << " }" << (s + 1 < r.stages.size() ? ",\n" : "\n");
+		}
+		out << "\t\t\t}\n";
+		out << "\t\t}" << (i + 1 < results.size() ? ",\n" : "\n");
+	}
+	out << "\t]\n}\n";
+}
+
+// Just enough JSON to read back what WriteJson produces.
+struct JsonValue {
+	enum class Type { Null, Number, String, Array, Object } type = Type::Null;
+	double number = 0;
+	std::string string;
+	std::vector<JsonValue> array;
+	std::vector<std::pair<std::string, JsonValue>> object;
+
+	const JsonValue* Find(const std::string& key) const
+	{
+		for (auto& member : object) {
+			if (member.first == key) return &member.second;
+		}
+		return nullptr;
+	}
+};
+
+class JsonReader
+{
+	const std::string& text;
+	size_t pos = 0;
+
+	void SkipSpace()
+	{
+		while (pos < text.size() && isspace((unsigned char)text[pos])) pos++;
+	}
+	bool Consume(char c)
+	{
+		SkipSpace();
+		if (pos < text.size() && text[pos] == c) {
+			pos++;
+			return true;
+		}
+		return false;
+	}
+	std::string ParseString()
+	{
+		std::string result;
+		while (pos < text.size() && text[pos] != '"') {
+			if (text[pos] == '\\' && pos + 1 < text.size()) pos++;
+			result += text[pos++];
+		}
+		pos++;
+		return result;
+	}
+public:
+	explicit JsonReader(const std::string& text) : text(text) {}
+
+	JsonValue Parse()
+	{
+		JsonValue value;
+		SkipSpace();
+		if (pos >= text.size()) throw std::runtime_error("unexpected end of json");
+		if (Consume('{')) {
+			value.type = JsonValue::Type::Object;
+			if (Consume('}')) return value;
+			do {
+				if (!Consume('"')) throw std::runtime_error("expected json key");
+				auto key = ParseString();
+				if (!Consume(':')) throw std::runtime_error("expected ':'");
+				value.object.emplace_back(key, Parse());
+			} while (Consume(','));
+			if (!Consume('}')) throw std::runtime_error("expected '}'");
+		}
+		else if (Consume('[')) {
+			value.type = JsonValue::Type::Array;
+			if (Consume(']')) return value;
+			do value.array.push_back(Parse()); while (Consume(','));
+			if (!Consume(']')) throw std::runtime_error("expected ']'");
+		}
+		else if (Consume('"')) {
+			value.type = JsonValue::Type::String;
+			value.string = ParseString();
+		}
+		else {
+			size_t end = pos;
+			while (end < text.size() && (isdigit((unsigned char)text[end]) || strchr("+-.eE", text[end]))) end++;
+			if (end == pos) throw std::runtime_error("unexpected json token");
+			value.type = JsonValue::Type::Number;
+			value.number = std::stod(text.substr(pos, end - pos));
+			pos = end;
+		}
+		return value;
+	}
+};
+
+static bool CompareBaseline(const std::vector<ScenarioResult>& results, const std::string& path, double threshold)
+{
+	std::ifstream file(path);
+	if (!file.is_open()) throw std::runtime_error("failed to open baseline!");
+	std::stringstream content;
+	content << file.rdbuf();
+	auto text = content.str();
+	auto baseline = JsonReader(text).Parse();
+	auto scenarios = baseline.Find("scenarios");
+	if (scenarios == nullptr) throw std::runtime_error("baseline has no scenarios");
+	bool regressed = false;
+	for (auto& result : results) {
+		const JsonValue* previous = nullptr;
+		for (auto& scenario : scenarios->array) {
+			auto name = scenario.Find("name");
+			if (name != nullptr && name->string == result.name) previous = &scenario;
+		}
+		if (previous == nullptr) {
+			printf("%-20s no baseline\n", result.name.c_str());
+			continue;
+		}
+		auto stages = previous->Find("stages");
+		for (auto& stage : result.stages) {
+			if (stage.first != "frame" && stage.first != "gpu") continue;
+			auto old = stages ? stages->Find(stage.first) : nullptr;
+			if (old == nullptr) continue;
+			std::pair<const char*, double> metrics[] = { { "p50", stage.second.p50 }, { "p95", stage.second.p95 } };
+			for (auto& metric : metrics) {
+				auto before = old->Find(metric.first);
+				if (before == nullptr || before->number <= 0) continue;
+				double change = metric.second / before->number - 1;
+				bool bad = change > threshold;
+				regressed |= bad;
+				printf("%-20s %-6s %s %9.4fms -> %9.4fms (%+6.1f%%)%s\n", result.name.c_str(), stage.first.c_str(), metric.first,
+					before->number, metric.second, change * 100, bad ? " REGRESSION" : "");
+			}
+		}
+	}
+	return regressed;
+}
+
+int RunBenchmark(int argc, char** argv)
+{
+	auto config = AppConfig::Parse(argc, argv);
+	auto options = BenchmarkOptions::Parse(argc, argv);
+	std::vector<ScenarioResult> results;
+	auto run = [&](const AppConfig& scenario, const std::string& name) {
+		results.push_back(RunScenario(scenario, options, name));
+		auto& r = results.back();
+		auto& frame = r.stages[(size_t)FrameStage::Frame].second;
+		printf("%-20s %8.1f fps %12.0f draws/s  frame p50 %.4fms p95 %.4fms p99 %.4fms\n", r.name.c_str(), r.fps, r.drawsPerSecond, frame.p50, frame.p95, frame.p99);
+	};
+	for (auto triangles : options.triangleCounts) {
+		AppConfig scenario = config;
+		scenario.triangleCount = triangles;
+		scenario.instanceCount = 0;
+		run(scenario, "triangles_" + std::to_string(triangles));
+	}
+	for (auto objects : options.instanceCounts) {
+		AppConfig scenario = config;
+		scenario.triangleCount = 1;
+		scenario.instanceCount = objects;
+		scenario.indirect = false;
+		run(scenario, "direct_" + std::to_string(objects));
+		// Same per-object draw calls through the loader's trampolines, to measure the device dispatch table.
+		scenario.deviceDispatch = false;
+		run(scenario, "direct_" + std::to_string(objects) + "_loader");
+		scenario.deviceDispatch = config.deviceDispatch;
+		scenario.indirect = true;
+		run(scenario, "indirect_" + std::to_string(objects));
+	}
+	for (auto triangles : options.meshTriangleCounts) {
+		auto name = "mesh_" + std::to_string(triangles);
+		AppConfig scenario = config;
+		scenario.meshPath = name + ".mesh";
+		scenario.triangleCount = triangles;
+		scenario.instanceCount = 0;
+		scenario.indirect = false;
+		WriteMeshFile(scenario.meshPath, VulkanApp::GenerateTriangles(triangles));
+		// What loading cost before mesh files: the whole file copied into a vector, before any upload starts.
+		auto start = std::chrono::steady_clock::now();
+		{
+			std::ifstream file(scenario.meshPath, std::ios::ate | std::ios::binary);
+			std::vector<char> bytes((size_t)file.tellg());
+			file.seekg(0);
+			file.read(bytes.data(), bytes.size());
+		}
+		double readTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		run(scenario, name);
+		auto& r = results.back();
+		r.meshReadTime = readTime;
+		printf("%-20s %8.1f MB  read %.1fms  open %.2fms  first chunk %.1fms  resident %.1fms after %u frames\n", r.name.c_str(), r.meshLoad.bytes / 1048576.0,
+			r.meshReadTime, r.meshLoad.open, r.meshLoad.firstChunk, r.meshLoad.resident, r.meshLoad.residentFrames);
+		std::remove(scenario.meshPath.c_str());
+	}
+	for (auto particles : options.particleCounts) {
+		AppConfig scenario = config;
+		scenario.triangleCount = 1;
+		scenario.instanceCount = 0;
+		scenario.particleCount = particles;
+		// The same simulation, drawn a frame behind so it runs beside graphics, then waited on before every frame.
+		double frameTimes[2] = {};
+		for (bool overlap : { true, false }) {
+			scenario.particleOverlap = overlap;
+			run(scenario, "particles_" + std::to_string(particles) + (overlap ? "_overlap" : "_serial"));
+			frameTimes[overlap ? 0 : 1] = results.back().stages[(size_t)FrameStage::Frame].second.p50;
+		}
+		printf("%-20s %s compute queue, overlapped frame p50 %.4fms vs serialized %.4fms\n", ("particles_" + std::to_string(particles)).c_str(),
+			results.back().asyncCompute ? "async" : "graphics", frameTimes[0], frameTimes[1]);
+	}
+	for (auto format : options.captureFormats) {
+		AppConfig scenario = config;
+		scenario.triangleCount = 1;
+		scenario.instanceCount = 0;
+		scenario.particleCount = 0;
+		scenario.capture.directory = std::string("capture_") + CaptureFormatName(format);
+		scenario.capture.format = format;
+		scenario.capture.interval = 1;
+		// Compared against triangles_1, the same scene without capture.
+		run(scenario, scenario.capture.directory);
+		auto& r = results.back();
+		printf("%-20s %llu frames captured, %llu dropped with the ring full\n", r.name.c_str(), (unsigned long long)r.capturedFrames, (unsigned long long)r.droppedFrames);
+		std::error_code error;
+		std::filesystem::remove_all(scenario.capture.directory, error);
+	}
+	std::ofstream out(options.outputPath);
+	if (!out.is_open()) throw std::runtime_error("failed to open benchmark output!");
+	WriteJson(out, results);
+	if (!options.baselinePath.empty() && CompareBaseline(results, options.baselinePath, options.threshold)) return 2;
+	return 0;
+}
+
+// Median milliseconds per call of kernel, repeated for at least a quarter second.
+static double TimeKernel(const std::function<void()>& kernel)
+{
+	std::vector<double> samples;
+	auto start = std::chrono::steady_clock::now();
+	while (samples.size() < 5 || std::chrono::steady_clock::now() - start < std::chrono::milliseconds(250)) {
+		auto begin = std::chrono::steady_clock::now();
+		kernel();
+		samples.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count());
+	}
+	return Percentiles::From(std::move(samples)).p50;
+}
+
+int RunMathBenchmark(int argc, char** argv)
+{
+	std::vector<uint32_t> objectCounts = { 100000, 1000000 };
+	std::string outputPath = "math_benchmark.json";
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--objects" && i + 1 < argc) objectCounts = ParseList(argv[++i]);
+		else if (arg == "--out" && i + 1 < argc) outputPath = argv[++i];
+	}
+	auto best = DetectSimdLevel();
+	ThreadPool workers(std::max(1u, std::thread::hardware_concurrency()) - 1);
+	std::vector<size_t> threadCounts = { 1 };
+	if (workers.Concurrency() > 1) threadCounts.push_back(workers.Concurrency());
+	auto planes = ClipVolumePlanes();
+	// Four times the clip volume's area, so about a quarter of the spheres survive and compaction has real work.
+	auto view = Affine3::ScaleTranslate({ 0.5f, 0.5f, 1 }, { 0, 0, 0 });
+	std::vector<KernelResult> results;
+	for (auto objects : objectCounts) {
+		std::mt19937 random(objects);
+		std::uniform_real_distribution<float> position(-1, 1), depth(0, 1), radius(0.001f, 0.01f);
+		SphereSoA world, clip;
+		for (uint32_t i = 0; i < objects; i++) world.Push({ position(random) * 2, position(random) * 2, depth(random), radius(random) });
+		clip.Resize(objects);
+		TransformSpheres(SimdLevel::Scalar, world, view, clip, 0, objects);
+		std::vector<uint32_t> visible(objects);
+		for (int level = 0; level <= (int)best; level++) {
+			auto simd = (SimdLevel)level;
+			for (size_t threads : threadCounts) {
+				// Jobs the size VulkanApp::CullDraws uses; a single thread runs the whole range as one.
+				size_t jobSize = threads == 1 ? objects : 4096;
+				size_t jobs = (objects + jobSize - 1) / jobSize;
+				auto forEachJob = [&](const std::function<void(size_t, size_t)>& run) {
+					auto job = [&](size_t index) { run(index * jobSize, std::min<size_t>(objects, (index + 1) * jobSize)); };
+					if (threads == 1) job(0);
+					else workers.ParallelFor(jobs, job);
+				};
+				double transformMs = TimeKernel([&] {
+					forEachJob([&](size_t begin, size_t end) { TransformSpheres(simd, world, view, clip, begin, end); });
+				});
+				double cullMs = TimeKernel([&] {
+					forEachJob([&](size_t begin, size_t end) { CullSpheres(simd, clip, planes.data(), planes.size(), begin, end, visible.data() + begin); });
+				});
+				for (auto& kernel : { std::make_pair("transform", transformMs), std::make_pair("cull", cullMs) }) {
+					KernelResult r;
+					r.kernel = kernel.first;
+					r.simd = SimdLevelName(simd);
+					r.objects = objects;
+					r.threads = (uint32_t)threads;
+					r.ms = kernel.second;
+					r.objectsPerSecond = r.ms > 0 ? objects / (r.ms / 1000) : 0;
+					results.push_back(r);
+					printf("%-10s %-7s %8u objects %3u threads %9.3fms %9.1f Mobjects/s\n", r.kernel.c_str(), r.simd.c_str(), r.objects, r.threads,
+						r.ms, r.objectsPerSecond / 1e6);
+				}
+			}
+		}
+	}
+	std::ofstream out(outputPath);
+	if (!out.is_open()) throw std::runtime_error("failed to open benchmark output!");
+	out.precision(6);
+	out << std::fixed << "{\n\t\"kernels\": [\n";
+	for (size_t i = 0; i < results.size(); i++) {
+		auto& r = results[i];
+		out << "\t\t{ \"kernel\": \"" << r.kernel << "\", \"simd\": \"" << r.simd << "\", \"objects\": " << r.objects << ", \"threads\": " << r.threads
+			<< ", \"ms\": " << r.ms << ", \"objectsPerSecond\": " << r.objectsPerSecond << " }" << (i + 1 < results.size() ? ",\n" : "\n");
+	}
+	out << "\t]\n}\n";
+	return 0;
+}
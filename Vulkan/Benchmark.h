@@ -0,0 +1,89 @@
+#pragma once
+#include "ImageCodec.h"
+#include "MeshFile.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <utility>
+
+struct BenchmarkOptions {
+	uint32_t frames = 500;
+	uint32_t warmupFrames = 30;
+	std::string outputPath = "benchmark.json";
+	std::string baselinePath;
+	// Relative slowdown of a compared percentile that counts as a regression.
+	double threshold = 0.1;
+	std::vector<uint32_t> triangleCounts = { 1, 1000, 100000, 1000000 };
+	// Object counts drawn once with a draw call per object and once through indexed indirect draws.
+	std::vector<uint32_t> instanceCounts = { 1000, 100000 };
+	// Generated meshes written to a mesh file and streamed back in, to time loading.
+	std::vector<uint32_t> meshTriangleCounts = { 1000000 };
+	// Particle counts simulated on the compute queue, once overlapping graphics work and once serialized before it.
+	std::vector<uint32_t> particleCounts = { 1000000 };
+	// Formats every frame is captured to disk in, to show what streaming frames costs the render loop.
+	std::vector<CaptureFormat> captureFormats = { CaptureFormat::RawLz, CaptureFormat::Png };
+
+	static BenchmarkOptions Parse(int argc, char** argv);
+};
+
+struct Percentiles {
+	double mean = 0;
+	double p50 = 0;
+	double p95 = 0;
+	double p99 = 0;
+
+	static Percentiles From(std::vector<double> samples);
+};
+
+struct ScenarioResult {
+	std::string name;
+	uint32_t triangles = 0;
+	uint32_t objects = 0;
+	// Objects left after culling in the last frame.
+	uint32_t visibleObjects = 0;
+	uint32_t drawCalls = 0;
+	uint32_t frames = 0;
+	double seconds = 0;
+	double fps = 0;
+	double trianglesPerSecond = 0;
+	double drawsPerSecond = 0;
+	double pipelineCreateTime = 0;
+	bool pipelineCacheWarm = false;
+	uint64_t memoryUsedBytes = 0;
+	uint64_t memoryReservedBytes = 0;
+	uint32_t deviceAllocations = 0;
+	std::vector<std::pair<std::string, Percentiles>> stages;
+	// Mesh scenarios only: the streaming milestones, and the time to read the same file into memory in one go.
+	MeshLoadStats meshLoad;
+	double meshReadTime = 0;
+	// Dynamic resolution only: the render scale over the measured frames and how often the controller changed it.
+	bool dynamicResolution = false;
+	Percentiles renderScale;
+	uint64_t scaleChanges = 0;
+	// Particle scenarios only: how many were simulated, whether on a queue beside graphics, and whether overlapped.
+	uint32_t particles = 0;
+	bool asyncCompute = false;
+	bool overlapped = false;
+	// Capture scenarios only: frames copied into the capture ring and frames dropped because it was full.
+	std::string captureFormat;
+	uint64_t capturedFrames = 0;
+	uint64_t droppedFrames = 0;
+};
+
+// Runs every scenario for a fixed number of frames, writes the results as JSON and,
+// when a baseline is given, returns 2 if any scenario regressed past the threshold.
+int RunBenchmark(int argc, char** argv);
+
+// Throughput of one math kernel at one instruction set level.
+struct KernelResult {
+	std::string kernel;
+	std::string simd;
+	uint32_t objects = 0;
+	uint32_t threads = 0;
+	double ms = 0;
+	double objectsPerSecond = 0;
+};
+
+// Times the sphere transform and culling kernels at every instruction set level the CPU supports, on one thread
+// and across a thread pool, and writes the throughput as JSON.
+int RunMathBenchmark(int argc, char** argv);
@@ -0,0 +1,132 @@
+#include "ComputeQueue.h"
+#ifdef _DEBUG
+#include <cassert>
+#else
+#define assert(X) (void)(X)
+#endif
+
+#include <stdexcept>
+
+using namespace vk;
+
+void ComputePipeline::Create(Device device, vk::PipelineCache cache, DescriptorSetLayout bindlessLayout, uint32_t pushConstantSize, SpirvCode code)
+{
+	this->device = device;
+	PushConstantRange pushConstantRange{};
+	pushConstantRange.stageFlags = ShaderStageFlagBits::eCompute;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = pushConstantSize;
+	PipelineLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = StructureType::ePipelineLayoutCreateInfo;
+	layoutInfo.setLayoutCount = 1;
+	layoutInfo.pSetLayouts = &bindlessLayout;
+	layoutInfo.pushConstantRangeCount = 1;
+	layoutInfo.pPushConstantRanges = &pushConstantRange;
+	assert(device.createPipelineLayout(&layoutInfo, nullptr, &layout) == Result::eSuccess);
+	ShaderModuleCreateInfo moduleInfo{};
+	moduleInfo.sType = StructureType::eShaderModuleCreateInfo;
+	moduleInfo.codeSize = code.size;
+	moduleInfo.pCode = code.words;
+	ShaderModule module;
+	assert(device.createShaderModule(&moduleInfo, nullptr, &module) == Result::eSuccess);
+	ComputePipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = StructureType::eComputePipelineCreateInfo;
+	pipelineInfo.stage.sType = StructureType::ePipelineShaderStageCreateInfo;
+	pipelineInfo.stage.stage = ShaderStageFlagBits::eCompute;
+	pipelineInfo.stage.module = module;
+	pipelineInfo.stage.pName = "main";
+	pipelineInfo.layout = layout;
+	auto result = device.createComputePipelines(cache, 1, &pipelineInfo, nullptr, &pipeline);
+	device.destroyShaderModule(module, nullptr);
+	if (result != Result::eSuccess) throw std::runtime_error("failed to create compute pipeline!");
+}
+
+void ComputePipeline::Destroy()
+{
+	device.destroyPipeline(pipeline, nullptr);
+	device.destroyPipelineLayout(layout, nullptr);
+}
+
+void ComputeQueue::Create(Device device, Queue queue, uint32_t family, uint32_t graphicsFamily, uint32_t slotCount)
+{
+	this->device = device;
+	this->queue = queue;
+	this->family = family;
+	this->graphicsFamily = graphicsFamily;
+	SemaphoreTypeCreateInfo typeInfo{};
+	typeInfo.sType = StructureType::eSemaphoreTypeCreateInfo;
+	typeInfo.semaphoreType = SemaphoreType::eTimeline;
+	typeInfo.initialValue = 0;
+	SemaphoreCreateInfo semaphoreInfo{};
+	semaphoreInfo.sType = StructureType::eSemaphoreCreateInfo;
+	semaphoreInfo.pNext = &typeInfo;
+	assert(device.createSemaphore(&semaphoreInfo, nullptr, &timeline) == Result::eSuccess);
+	CommandPoolCreateInfo poolInfo{};
+	poolInfo.sType = StructureType::eCommandPoolCreateInfo;
+	poolInfo.flags = CommandPoolCreateFlagBits::eTransient;
+	poolInfo.queueFamilyIndex = family;
+	slots.resize(slotCount);
+	for (auto& slot : slots) {
+		assert(device.createCommandPool(&poolInfo, nullptr, &slot.pool) == Result::eSuccess);
+		CommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = StructureType::eCommandBufferAllocateInfo;
+		allocInfo.commandPool = slot.pool;
+		allocInfo.level = CommandBufferLevel::ePrimary;
+		allocInfo.commandBufferCount = 1;
+		assert(device.allocateCommandBuffers(&allocInfo, &slot.commandBuffer) == Result::eSuccess);
+	}
+}
+
+void ComputeQueue::Destroy()
+{
+	for (auto& slot : slots) device.destroyCommandPool(slot.pool, nullptr);
+	slots.clear();
+	device.destroySemaphore(timeline, nullptr);
+}
+
+CommandBuffer ComputeQueue::Begin(uint32_t slot)
+{
+	auto& current = slots[slot];
+	// Graphics may lag the simulation it draws, so the frame fence does not cover this slot's last submission.
+	if (current.value > 0) {
+		SemaphoreWaitInfo waitInfo{};
+		waitInfo.sType = StructureType::eSemaphoreWaitInfo;
+		waitInfo.semaphoreCount = 1;
+		waitInfo.pSemaphores = &timeline;
+		waitInfo.pValues = &current.value;
+		assert(device.waitSemaphores(&waitInfo, UINT64_MAX) == Result::eSuccess);
+	}
+	device.resetCommandPool(current.pool, {});
+	CommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = StructureType::eCommandBufferBeginInfo;
+	beginInfo.flags = CommandBufferUsageFlagBits::eOneTimeSubmit;
+	assert(current.commandBuffer.begin(&beginInfo) == Result::eSuccess);
+	return current.commandBuffer;
+}
+
+void ComputeQueue::Submit(uint32_t slot, uint64_t value, Semaphore waitSemaphore, uint64_t waitValue)
+{
+	auto& current = slots[slot];
+	current.commandBuffer.end();
+	current.value = value;
+	PipelineStageFlags waitStage = PipelineStageFlagBits::eComputeShader;
+	TimelineSemaphoreSubmitInfo timelineInfo{};
+	timelineInfo.sType = StructureType::eTimelineSemaphoreSubmitInfo;
+	timelineInfo.waitSemaphoreValueCount = waitSemaphore ? 1 : 0;
+	timelineInfo.pWaitSemaphoreValues = &waitValue;
+	timelineInfo.signalSemaphoreValueCount = 1;
+	timelineInfo.pSignalSemaphoreValues = &value;
+	SubmitInfo submitInfo{};
+	submitInfo.sType = StructureType::eSubmitInfo;
+	submitInfo.pNext = &timelineInfo;
+	if (waitSemaphore) {
+		submitInfo.waitSemaphoreCount = 1;
+		submitInfo.pWaitSemaphores = &waitSemaphore;
+		submitInfo.pWaitDstStageMask = &waitStage;
+	}
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &current.commandBuffer;
+	submitInfo.signalSemaphoreCount = 1;
+	submitInfo.pSignalSemaphores = &timeline;
+	assert(queue.submit(1, &submitInfo, nullptr) == Result::eSuccess);
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include "Dispatch.h"
+#include "Shaders.h"
+#include <cstdint>
+#include <vector>
+
+// One compute shader and the layout it is dispatched with: the bindless table at set 0 and a push constant block.
+class ComputePipeline
+{
+	vk::Device device;
+	vk::PipelineLayout layout;
+	vk::Pipeline pipeline;
+public:
+	void Create(vk::Device device, vk::PipelineCache cache, vk::DescriptorSetLayout bindlessLayout, uint32_t pushConstantSize, SpirvCode code);
+	void Destroy();
+	vk::PipelineLayout Layout() const { return layout; }
+	vk::Pipeline Handle() const { return pipeline; }
+};
+
+// Submits compute work on a timeline semaphore of its own. The queue belongs to a family without graphics when the
+// device has one, so the work runs beside the graphics queue; otherwise it is the graphics queue itself and the
+// work is merely ordered by the same semaphores. Buffers written here and read by graphics change queue family
+// ownership only in the first case (Async()). Command buffers are recorded per slot, one slot per frame in flight.
+class ComputeQueue
+{
+	struct Slot {
+		vk::CommandPool pool;
+		vk::CommandBuffer commandBuffer;
+		// Timeline value the slot was last submitted with.
+		uint64_t value = 0;
+	};
+
+	vk::Device device;
+	vk::Queue queue;
+	uint32_t family = 0;
+	uint32_t graphicsFamily = 0;
+	vk::Semaphore timeline;
+	std::vector<Slot> slots;
+public:
+	void Create(vk::Device device, vk::Queue queue, uint32_t family, uint32_t graphicsFamily, uint32_t slotCount);
+	void Destroy();
+	bool Async() const { return family != graphicsFamily; }
+	uint32_t Family() const { return family; }
+	uint32_t GraphicsFamily() const { return graphicsFamily; }
+	vk::Semaphore Timeline() const { return timeline; }
+	// Waits for slot's previous submission, then begins recording its command buffer.
+	vk::CommandBuffer Begin(uint32_t slot);
+	// Submits slot's command buffer, signaling value on the timeline once it completes. When waitSemaphore is set
+	// the compute stage first waits for that timeline semaphore to reach waitValue.
+	void Submit(uint32_t slot, uint64_t value, vk::Semaphore waitSemaphore = {}, uint64_t waitValue = 0);
+};
@@ -0,0 +1,138 @@
+#include "DeletionQueue.h"
+#include "Log.h"
+#ifdef _DEBUG
+#include <cassert>
+#else
+#define assert(X) (void)(X)
+#endif
+
+#include <algorithm>
+#include <iterator>
+
+using namespace vk;
+
+const char* HandleTypeName(HandleType type)
+{
+	switch (type)
+	{
+	case HandleType::Buffer: return "buffers";
+	case HandleType::Image: return "images";
+	case HandleType::ImageView: return "image views";
+	case HandleType::Framebuffer: return "framebuffers";
+	case HandleType::Pipeline: return "pipelines";
+	case HandleType::Swapchain: return "swapchains";
+	case HandleType::Memory: return "memory ranges";
+	default: return "unknown";
+	}
+}
+
+void DeletionQueue::Create(Device device, MemoryAllocator& allocator)
+{
+	this->device = device;
+	this->allocator = &allocator;
+}
+
+void DeletionQueue::Destroy()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	for (auto& entry : entries) {
+		entry.destroy();
+		destroyed[(size_t)entry.type]++;
+	}
+	entries.clear();
+	uint64_t total = 0;
+	uint64_t leaked = 0;
+	for (size_t type = 0; type < (size_t)HandleType::Count; type++) {
+		total += created[type];
+		if (created[type] == destroyed[type]) continue;
+		leaked += created[type] - destroyed[type];
+		Log("resources: %llu of %llu %s never released", (unsigned long long)(created[type] - destroyed[type]), (unsigned long long)created[type],
+			HandleTypeName((HandleType)type));
+	}
+	Log("resources: %llu objects tracked, %llu leaked", (unsigned long long)total, (unsigned long long)leaked);
+}
+
+void DeletionQueue::Track(HandleType type)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	created[(size_t)type]++;
+}
+
+Owned<Buffer> DeletionQueue::CreateBuffer(const BufferCreateInfo& info, MemoryPropertyFlags properties)
+{
+	Buffer buffer;
+	assert(device.createBuffer(&info, nullptr, &buffer) == Result::eSuccess);
+	return Owned<Buffer>(*this, buffer, allocator->AllocateBuffer(buffer, properties));
+}
+
+Owned<Image> DeletionQueue::CreateImage(const ImageCreateInfo& info, MemoryPropertyFlags properties)
+{
+	Image image;
+	assert(device.createImage(&info, nullptr, &image) == Result::eSuccess);
+	return Owned<Image>(*this, image, allocator->AllocateImage(image, properties, info.tiling));
+}
+
+void DeletionQueue::Push(HandleType type, uint64_t value, std::function<void()> destroy)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	entries.push_back({ type, value, std::move(destroy) });
+}
+
+void DeletionQueue::Retire(Buffer buffer, Allocation allocation, uint64_t value)
+{
+	Push(HandleType::Buffer, value, [this, buffer, allocation]() mutable {
+		device.destroyBuffer(buffer, nullptr);
+		allocator->Free(allocation);
+	});
+}
+
+void DeletionQueue::Retire(Image image, Allocation allocation, uint64_t value)
+{
+	Push(HandleType::Image, value, [this, image, allocation]() mutable {
+		device.destroyImage(image, nullptr);
+		allocator->Free(allocation);
+	});
+}
+
+void DeletionQueue::Retire(ImageView view, uint64_t value)
+{
+	Push(HandleType::ImageView, value, [this, view] { device.destroyImageView(view, nullptr); });
+}
+
+void DeletionQueue::Retire(Framebuffer framebuffer, uint64_t value)
+{
+	Push(HandleType::Framebuffer, value, [this, framebuffer] { device.destroyFramebuffer(framebuffer, nullptr); });
+}
+
+void DeletionQueue::Retire(Pipeline pipeline, uint64_t value)
+{
+	Push(HandleType::Pipeline, value, [this, pipeline] { device.destroyPipeline(pipeline, nullptr); });
+}
+
+void DeletionQueue::Retire(SwapchainKHR swapchain, uint64_t value)
+{
+	Push(HandleType::Swapchain, value, [this, swapchain] { device.destroySwapchainKHR(swapchain, nullptr); });
+}
+
+void DeletionQueue::Retire(Allocation allocation, uint64_t value)
+{
+	Push(HandleType::Memory, value, [this, allocation]() mutable { allocator->Free(allocation); });
+}
+
+void DeletionQueue::Collect(uint64_t submitted, uint64_t completed)
+{
+	// Destroyed outside the lock, so destroying never stalls a thread retiring something meanwhile.
+	std::vector<Entry> done;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (auto& entry : entries) {
+			if (entry.value == 0) entry.value = submitted;
+		}
+		auto split = std::stable_partition(entries.begin(), entries.end(), [&](const Entry& entry) { return entry.value > completed; });
+		std::move(split, entries.end(), std::back_inserter(done));
+		entries.erase(split, entries.end());
+	}
+	for (auto& entry : done) entry.destroy();
+	std::lock_guard<std::mutex> lock(mutex);
+	for (auto& entry : done) destroyed[(size_t)entry.type]++;
+}
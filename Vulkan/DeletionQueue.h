@@ -0,0 +1,121 @@
+#pragma once
+#include "MemoryAllocator.h"
+#include <array>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+// Objects whose lifetime the deletion queue tracks.
+enum class HandleType {
+	Buffer,
+	Image,
+	ImageView,
+	Framebuffer,
+	Pipeline,
+	Swapchain,
+	// Sub-allocations not owned by any one buffer or image, such as memory shared by aliased transients.
+	Memory,
+	Count
+};
+
+const char* HandleTypeName(HandleType type);
+
+template <typename T> struct HandleTypeOf;
+template <> struct HandleTypeOf<vk::Buffer> { static constexpr HandleType value = HandleType::Buffer; };
+template <> struct HandleTypeOf<vk::Image> { static constexpr HandleType value = HandleType::Image; };
+
+template <typename T> class Owned;
+
+// Destroys objects once the GPU is done with them, instead of idling the device before replacing anything.
+// Each retired object waits for a frame timeline value: either the one it is retired with, or, when that is 0,
+// the newest frame submitted by the next Collect(), which is the last frame that can have recorded it. Objects are
+// counted per type from Track() to their destruction, so anything never released is reported at shutdown.
+// Every member may be called from any thread.
+class DeletionQueue
+{
+	struct Entry {
+		HandleType type;
+		uint64_t value;
+		std::function<void()> destroy;
+	};
+
+	vk::Device device;
+	MemoryAllocator* allocator = nullptr;
+	std::mutex mutex;
+	std::vector<Entry> entries;
+	std::array<uint64_t, (size_t)HandleType::Count> created{};
+	std::array<uint64_t, (size_t)HandleType::Count> destroyed{};
+
+	void Push(HandleType type, uint64_t value, std::function<void()> destroy);
+public:
+	void Create(vk::Device device, MemoryAllocator& allocator);
+	// Destroys everything still queued and logs the objects that were created but never retired. The device must be
+	// idle.
+	void Destroy();
+
+	// Counts an object that will be retired through the queue.
+	void Track(HandleType type);
+	// A buffer or image created with memory from the queue's allocator and bound to it, owned by the result.
+	Owned<vk::Buffer> CreateBuffer(const vk::BufferCreateInfo& info, vk::MemoryPropertyFlags properties);
+	Owned<vk::Image> CreateImage(const vk::ImageCreateInfo& info, vk::MemoryPropertyFlags properties);
+
+	// allocation is freed along with the object; it may be empty.
+	void Retire(vk::Buffer buffer, Allocation allocation, uint64_t value = 0);
+	void Retire(vk::Image image, Allocation allocation, uint64_t value = 0);
+	void Retire(vk::ImageView view, uint64_t value = 0);
+	void Retire(vk::Framebuffer framebuffer, uint64_t value = 0);
+	void Retire(vk::Pipeline pipeline, uint64_t value = 0);
+	void Retire(vk::SwapchainKHR swapchain, uint64_t value = 0);
+	void Retire(Allocation allocation, uint64_t value = 0);
+	// Stamps objects retired without a value with submitted, then destroys every object whose value is at or below
+	// completed. Call once per frame.
+	void Collect(uint64_t submitted, uint64_t completed);
+};
+
+// Owns a buffer or image and its memory. Resetting, reassigning or destroying the owner retires both to the
+// deletion queue, so frames still in flight keep reading a valid object.
+template <typename T>
+class Owned
+{
+	DeletionQueue* deletions = nullptr;
+	T handle;
+	Allocation allocation;
+public:
+	Owned() = default;
+	// Takes over handle and allocation, which are counted from here on.
+	Owned(DeletionQueue& deletions, T handle, Allocation allocation) : deletions(&deletions), handle(handle), allocation(allocation)
+	{
+		deletions.Track(HandleTypeOf<T>::value);
+	}
+	Owned(const Owned&) = delete;
+	Owned& operator=(const Owned&) = delete;
+	Owned(Owned&& other) noexcept : deletions(other.deletions), handle(other.handle), allocation(other.allocation)
+	{
+		other.handle = nullptr;
+		other.allocation = {};
+	}
+	Owned& operator=(Owned&& other) noexcept
+	{
+		if (this != &other) {
+			Reset();
+			deletions = other.deletions;
+			handle = other.handle;
+			allocation = other.allocation;
+			other.handle = nullptr;
+			other.allocation = {};
+		}
+		return *this;
+	}
+	~Owned() { Reset(); }
+
+	T Get() const { return handle; }
+	const Allocation& Memory() const { return allocation; }
+	explicit operator bool() const { return (bool)handle; }
+	void Reset()
+	{
+		if (!handle) return;
+		deletions->Retire(handle, allocation);
+		handle = nullptr;
+		allocation = {};
+	}
+};
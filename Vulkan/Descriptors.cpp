@@ -0,0 +1,253 @@
+#include "Descriptors.h"
+#ifdef _DEBUG
+#include <cassert>
+#else
+#define assert(X) (void)(X)
+#endif
+
+#include <algorithm>
+#include <stdexcept>
+
+using namespace vk;
+
+void UniformRing::Create(PhysicalDevice physicalDevice, Device device, MemoryAllocator& allocator, uint32_t frames, DeviceSize range, DeviceSize frameSize)
+{
+	this->device = device;
+	this->allocator = &allocator;
+	PhysicalDeviceProperties properties;
+	physicalDevice.getProperties(&properties);
+	alignment = std::max<DeviceSize>(properties.limits.minUniformBufferOffsetAlignment, 16);
+	this->range = std::min<DeviceSize>((range + alignment - 1) / alignment * alignment, properties.limits.maxUniformBufferRange);
+	this->frameSize = std::max(frameSize, this->range) / alignment * alignment;
+	BufferCreateInfo bufferInfo{};
+	bufferInfo.sType = StructureType::eBufferCreateInfo;
+	bufferInfo.size = this->frameSize * frames;
+	bufferInfo.usage = BufferUsageFlagBits::eUniformBuffer;
+	bufferInfo.sharingMode = SharingMode::eExclusive;
+	assert(device.createBuffer(&bufferInfo, nullptr, &buffer) == Result::eSuccess);
+	allocation = allocator.AllocateBuffer(buffer, MemoryPropertyFlagBits::eHostVisible | MemoryPropertyFlagBits::eHostCoherent);
+
+	DescriptorSetLayoutBinding binding{};
+	binding.binding = 0;
+	binding.descriptorType = DescriptorType::eUniformBufferDynamic;
+	binding.descriptorCount = 1;
+	binding.stageFlags = ShaderStageFlagBits::eVertex | ShaderStageFlagBits::eFragment;
+	DescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = StructureType::eDescriptorSetLayoutCreateInfo;
+	layoutInfo.bindingCount = 1;
+	layoutInfo.pBindings = &binding;
+	assert(device.createDescriptorSetLayout(&layoutInfo, nullptr, &layout) == Result::eSuccess);
+	DescriptorPoolSize poolSize{};
+	poolSize.type = DescriptorType::eUniformBufferDynamic;
+	poolSize.descriptorCount = 1;
+	DescriptorPoolCreateInfo poolInfo{};
+	poolInfo.sType = StructureType::eDescriptorPoolCreateInfo;
+	poolInfo.maxSets = 1;
+	poolInfo.poolSizeCount = 1;
+	poolInfo.pPoolSizes = &poolSize;
+	assert(device.createDescriptorPool(&poolInfo, nullptr, &pool) == Result::eSuccess);
+	DescriptorSetAllocateInfo allocInfo{};
+	allocInfo.sType = StructureType::eDescriptorSetAllocateInfo;
+	allocInfo.descriptorPool = pool;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &layout;
+	assert(device.allocateDescriptorSets(&allocInfo, &set) == Result::eSuccess);
+	DescriptorBufferInfo info{};
+	info.buffer = buffer;
+	info.offset = 0;
+	info.range = this->range;
+	WriteDescriptorSet write{};
+	write.sType = StructureType::eWriteDescriptorSet;
+	write.dstSet = set;
+	write.dstBinding = 0;
+	write.descriptorCount = 1;
+	write.descriptorType = DescriptorType::eUniformBufferDynamic;
+	write.pBufferInfo = &info;
+	device.updateDescriptorSets(1, &write, 0, nullptr);
+}
+
+void UniformRing::Destroy()
+{
+	device.destroyDescriptorPool(pool, nullptr);
+	device.destroyDescriptorSetLayout(layout, nullptr);
+	device.destroyBuffer(buffer, nullptr);
+	allocator->Free(allocation);
+}
+
+void UniformRing::BeginFrame(uint32_t frame)
+{
+	frameBase = frameSize * frame;
+	head = 0;
+}
+
+uint32_t UniformRing::Allocate(DeviceSize size, void** data)
+{
+	// The descriptor reads range bytes from every offset, so each allocation needs that much room before the region ends.
+	if (size > range || head + range > frameSize) throw std::runtime_error("uniform ring frame region exhausted!");
+	auto offset = frameBase + head;
+	head += (size + alignment - 1) / alignment * alignment;
+	*data = static_cast<uint8_t*>(allocation.mapped) + offset;
+	return (uint32_t)offset;
+}
+
+bool BindlessTable::EnableFeatures(const PhysicalDeviceVulkan12Features& supported, PhysicalDeviceVulkan12Features& enabled)
+{
+	enabled.runtimeDescriptorArray = supported.runtimeDescriptorArray;
+	enabled.descriptorBindingPartiallyBound = supported.descriptorBindingPartiallyBound;
+	enabled.descriptorBindingStorageBufferUpdateAfterBind = supported.descriptorBindingStorageBufferUpdateAfterBind;
+	enabled.descriptorBindingSampledImageUpdateAfterBind = supported.descriptorBindingSampledImageUpdateAfterBind;
+	enabled.descriptorBindingUpdateUnusedWhilePending = supported.descriptorBindingUpdateUnusedWhilePending;
+	return supported.runtimeDescriptorArray && supported.descriptorBindingPartiallyBound && supported.descriptorBindingStorageBufferUpdateAfterBind
+		&& supported.descriptorBindingSampledImageUpdateAfterBind && supported.descriptorBindingUpdateUnusedWhilePending;
+}
+
+void BindlessTable::Create(PhysicalDevice physicalDevice, Device device, uint32_t bufferCapacity, uint32_t imageCapacity)
+{
+	this->device = device;
+	PhysicalDeviceVulkan12Properties properties12{};
+	properties12.sType = StructureType::ePhysicalDeviceVulkan12Properties;
+	PhysicalDeviceProperties2 properties2{};
+	properties2.sType = StructureType::ePhysicalDeviceProperties2;
+	properties2.pNext = &properties12;
+	physicalDevice.getProperties2(&properties2);
+	// Leave room for the few non-bindless descriptors a stage also uses.
+	uint32_t stageResources = properties12.maxPerStageUpdateAfterBindResources > 64 ? properties12.maxPerStageUpdateAfterBindResources - 64 : properties12.maxPerStageUpdateAfterBindResources / 2;
+	this->bufferCapacity = std::min({ bufferCapacity, properties12.maxPerStageDescriptorUpdateAfterBindStorageBuffers, properties12.maxDescriptorSetUpdateAfterBindStorageBuffers, stageResources / 2 });
+	this->imageCapacity = std::min({ imageCapacity, properties12.maxPerStageDescriptorUpdateAfterBindSampledImages, properties12.maxDescriptorSetUpdateAfterBindSampledImages, stageResources / 2 });
+
+	SamplerCreateInfo samplerInfo{};
+	samplerInfo.sType = StructureType::eSamplerCreateInfo;
+	samplerInfo.magFilter = Filter::eLinear;
+	samplerInfo.minFilter = Filter::eLinear;
+	samplerInfo.mipmapMode = SamplerMipmapMode::eLinear;
+	samplerInfo.addressModeU = SamplerAddressMode::eRepeat;
+	samplerInfo.addressModeV = SamplerAddressMode::eRepeat;
+	samplerInfo.addressModeW = SamplerAddressMode::eRepeat;
+	samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+	assert(device.createSampler(&samplerInfo, nullptr, &sampler) == Result::eSuccess);
+
+	DescriptorSetLayoutBinding bindings[3]{};
+	bindings[0].binding = BufferBinding;
+	bindings[0].descriptorType = DescriptorType::eStorageBuffer;
+	bindings[0].descriptorCount = this->bufferCapacity;
+	// Compute shaders write buffers the graphics stages then read.
+	bindings[0].stageFlags = ShaderStageFlagBits::eVertex | ShaderStageFlagBits::eFragment | ShaderStageFlagBits::eCompute;
+	bindings[1].binding = ImageBinding;
+	bindings[1].descriptorType = DescriptorType::eSampledImage;
+	bindings[1].descriptorCount = this->imageCapacity;
+	bindings[1].stageFlags = ShaderStageFlagBits::eVertex | ShaderStageFlagBits::eFragment;
+	bindings[2].binding = SamplerBinding;
+	bindings[2].descriptorType = DescriptorType::eSampler;
+	bindings[2].descriptorCount = 1;
+	bindings[2].stageFlags = ShaderStageFlagBits::eFragment;
+	bindings[2].pImmutableSamplers = &sampler;
+	// Empty slots are never read, and slots are written while frames using other slots are in flight.
+	DescriptorBindingFlags tableFlags = DescriptorBindingFlagBits::ePartiallyBound | DescriptorBindingFlagBits::eUpdateAfterBind | DescriptorBindingFlagBits::eUpdateUnusedWhilePending;
+	DescriptorBindingFlags bindingFlags[3] = { tableFlags, tableFlags, {} };
+	DescriptorSetLayoutBindingFlagsCreateInfo flagsInfo{};
+	flagsInfo.sType = StructureType::eDescriptorSetLayoutBindingFlagsCreateInfo;
+	flagsInfo.bindingCount = 3;
+	flagsInfo.pBindingFlags = bindingFlags;
+	DescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = StructureType::eDescriptorSetLayoutCreateInfo;
+	layoutInfo.pNext = &flagsInfo;
+	layoutInfo.flags = DescriptorSetLayoutCreateFlagBits::eUpdateAfterBindPool;
+	layoutInfo.bindingCount = 3;
+	layoutInfo.pBindings = bindings;
+	assert(device.createDescriptorSetLayout(&layoutInfo, nullptr, &layout) == Result::eSuccess);
+
+	DescriptorPoolSize poolSizes[3]{};
+	poolSizes[0].type = DescriptorType::eStorageBuffer;
+	poolSizes[0].descriptorCount = this->bufferCapacity;
+	poolSizes[1].type = DescriptorType::eSampledImage;
+	poolSizes[1].descriptorCount = this->imageCapacity;
+	poolSizes[2].type = DescriptorType::eSampler;
+	poolSizes[2].descriptorCount = 1;
+	DescriptorPoolCreateInfo poolInfo{};
+	poolInfo.sType = StructureType::eDescriptorPoolCreateInfo;
+	poolInfo.flags = DescriptorPoolCreateFlagBits::eUpdateAfterBind;
+	poolInfo.maxSets = 1;
+	poolInfo.poolSizeCount = 3;
+	poolInfo.pPoolSizes = poolSizes;
+	assert(device.createDescriptorPool(&poolInfo, nullptr, &pool) == Result::eSuccess);
+	DescriptorSetAllocateInfo allocInfo{};
+	allocInfo.sType = StructureType::eDescriptorSetAllocateInfo;
+	allocInfo.descriptorPool = pool;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &layout;
+	assert(device.allocateDescriptorSets(&allocInfo, &set) == Result::eSuccess);
+}
+
+void BindlessTable::Destroy()
+{
+	device.destroyDescriptorPool(pool, nullptr);
+	device.destroyDescriptorSetLayout(layout, nullptr);
+	device.destroySampler(sampler, nullptr);
+}
+
+uint32_t BindlessTable::AddBuffer(Buffer buffer, DeviceSize offset, DeviceSize range)
+{
+	uint32_t slot;
+	if (!freeBuffers.empty()) {
+		slot = freeBuffers.back();
+		freeBuffers.pop_back();
+	}
+	else if (bufferCount < bufferCapacity) {
+		slot = bufferCount++;
+	}
+	else {
+		throw std::runtime_error("bindless buffer table is full!");
+	}
+	DescriptorBufferInfo info{};
+	info.buffer = buffer;
+	info.offset = offset;
+	info.range = range;
+	WriteDescriptorSet write{};
+	write.sType = StructureType::eWriteDescriptorSet;
+	write.dstSet = set;
+	write.dstBinding = BufferBinding;
+	write.dstArrayElement = slot;
+	write.descriptorCount = 1;
+	write.descriptorType = DescriptorType::eStorageBuffer;
+	write.pBufferInfo = &info;
+	device.updateDescriptorSets(1, &write, 0, nullptr);
+	return slot;
+}
+
+uint32_t BindlessTable::AddImage(ImageView view, ImageLayout layout)
+{
+	uint32_t slot;
+	if (!freeImages.empty()) {
+		slot = freeImages.back();
+		freeImages.pop_back();
+	}
+	else if (imageCount < imageCapacity) {
+		slot = imageCount++;
+	}
+	else {
+		throw std::runtime_error("bindless image table is full!");
+	}
+	DescriptorImageInfo info{};
+	info.imageView = view;
+	info.imageLayout = layout;
+	WriteDescriptorSet write{};
+	write.sType = StructureType::eWriteDescriptorSet;
+	write.dstSet = set;
+	write.dstBinding = ImageBinding;
+	write.dstArrayElement = slot;
+	write.descriptorCount = 1;
+	write.descriptorType = DescriptorType::eSampledImage;
+	write.pImageInfo = &info;
+	device.updateDescriptorSets(1, &write, 0, nullptr);
+	return slot;
+}
+
+void BindlessTable::RemoveBuffer(uint32_t slot)
+{
+	freeBuffers.push_back(slot);
+}
+
+void BindlessTable::RemoveImage(uint32_t slot)
+{
+	freeImages.push_back(slot);
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include "MemoryAllocator.h"
+#include <cstring>
+#include <vector>
+
+// Per-frame constants in a persistently mapped, host-coherent buffer split into one region per frame in flight.
+// Allocations bump through the current frame's region and are addressed by dynamic offsets into a single
+// descriptor, so writing new constants never touches a descriptor set.
+class UniformRing
+{
+	vk::Device device;
+	MemoryAllocator* allocator = nullptr;
+	vk::Buffer buffer;
+	Allocation allocation;
+	vk::DescriptorSetLayout layout;
+	vk::DescriptorPool pool;
+	vk::DescriptorSet set;
+	vk::DeviceSize alignment = 256;
+	vk::DeviceSize range = 0;
+	vk::DeviceSize frameSize = 0;
+	vk::DeviceSize frameBase = 0;
+	vk::DeviceSize head = 0;
+public:
+	// range is the largest single allocation; it is also the size the descriptor exposes at each offset.
+	void Create(vk::PhysicalDevice physicalDevice, vk::Device device, MemoryAllocator& allocator, uint32_t frames, vk::DeviceSize range = 256, vk::DeviceSize frameSize = 64ull << 10);
+	void Destroy();
+	// Starts allocating from frame's region; the caller has waited for the GPU to finish the frame last using it.
+	void BeginFrame(uint32_t frame);
+	// Reserves size bytes and returns their dynamic offset, with data pointing at the mapped bytes.
+	uint32_t Allocate(vk::DeviceSize size, void** data);
+	template <typename T>
+	uint32_t Push(const T& value)
+	{
+		void* data;
+		auto offset = Allocate(sizeof(T), &data);
+		memcpy(data, &value, sizeof(T));
+		return offset;
+	}
+	// One dynamic uniform buffer at binding 0.
+	vk::DescriptorSetLayout Layout() const { return layout; }
+	vk::DescriptorSet Set() const { return set; }
+};
+
+// One descriptor set holding every storage buffer and texture the shaders can reach, addressed by slot index
+// through descriptor indexing. It is bound once per command buffer; draws select resources with indices passed
+// in push constants or read from buffers. Slots can be written while earlier frames still use other slots.
+class BindlessTable
+{
+	vk::Device device;
+	vk::DescriptorSetLayout layout;
+	vk::DescriptorPool pool;
+	vk::DescriptorSet set;
+	vk::Sampler sampler;
+	uint32_t bufferCapacity = 0;
+	uint32_t imageCapacity = 0;
+	uint32_t bufferCount = 0;
+	uint32_t imageCount = 0;
+	std::vector<uint32_t> freeBuffers;
+	std::vector<uint32_t> freeImages;
+public:
+	static constexpr uint32_t BufferBinding = 0;
+	static constexpr uint32_t ImageBinding = 1;
+	static constexpr uint32_t SamplerBinding = 2;
+
+	// The descriptor indexing features Create relies on; enables them in enabled and returns false if any is missing.
+	static bool EnableFeatures(const vk::PhysicalDeviceVulkan12Features& supported, vk::PhysicalDeviceVulkan12Features& enabled);
+	// Capacities are clamped to the device's update-after-bind limits.
+	void Create(vk::PhysicalDevice physicalDevice, vk::Device device, uint32_t bufferCapacity = 4096, uint32_t imageCapacity = 4096);
+	void Destroy();
+	// Returns the slot shaders index with; throws when the table is full.
+	uint32_t AddBuffer(vk::Buffer buffer, vk::DeviceSize offset = 0, vk::DeviceSize range = VK_WHOLE_SIZE);
+	// Sampled with the table's linear, repeating sampler.
+	uint32_t AddImage(vk::ImageView view, vk::ImageLayout layout = vk::ImageLayout::eShaderReadOnlyOptimal);
+	// The slot may be reused right away, so only remove resources no pending frame reads through it.
+	void RemoveBuffer(uint32_t slot);
+	void RemoveImage(uint32_t slot);
+	vk::DescriptorSetLayout Layout() const { return layout; }
+	vk::DescriptorSet Set() const { return set; }
+};
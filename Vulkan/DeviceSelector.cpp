@@ -0,0 +1,162 @@
+#include "DeviceSelector.h"
+#include "Descriptors.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+using namespace vk;
+
+bool AdapterInfo::HasExtension(const char* name) const
+{
+	return std::find(extensions.begin(), extensions.end(), name) != extensions.end();
+}
+
+AdapterInfo DescribeAdapter(PhysicalDevice physicalDevice, const std::function<bool(uint32_t family)>& presentSupport)
+{
+	AdapterInfo adapter;
+	PhysicalDeviceProperties properties;
+	physicalDevice.getProperties(&properties);
+	adapter.name = properties.deviceName;
+	adapter.type = properties.deviceType;
+	adapter.apiVersion = properties.apiVersion;
+	PhysicalDeviceMemoryProperties memory;
+	physicalDevice.getMemoryProperties(&memory);
+	for (uint32_t i = 0; i < memory.memoryHeapCount; i++) {
+		if (memory.memoryHeaps[i].flags & MemoryHeapFlagBits::eDeviceLocal) adapter.localHeapBytes += memory.memoryHeaps[i].size;
+	}
+	uint32_t familyCount = 0;
+	physicalDevice.getQueueFamilyProperties(&familyCount, nullptr);
+	adapter.families.resize(familyCount);
+	physicalDevice.getQueueFamilyProperties(&familyCount, adapter.families.data());
+	for (uint32_t i = 0; i < familyCount; i++) adapter.presentSupport.push_back(presentSupport(i));
+	uint32_t extensionCount = 0;
+	physicalDevice.enumerateDeviceExtensionProperties(nullptr, &extensionCount, nullptr);
+	std::vector<ExtensionProperties> extensions(extensionCount);
+	physicalDevice.enumerateDeviceExtensionProperties(nullptr, &extensionCount, extensions.data());
+	for (auto& extension : extensions) adapter.extensions.push_back(extension.extensionName);
+	// The 1.2 feature struct may only be chained on devices that know it.
+	if (adapter.apiVersion < VK_API_VERSION_1_2) {
+		physicalDevice.getFeatures(&adapter.features);
+		return adapter;
+	}
+	bool hasDynamicRendering = adapter.HasExtension(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+	PhysicalDeviceDynamicRenderingFeaturesKHR dynamicRendering{};
+	dynamicRendering.sType = StructureType::ePhysicalDeviceDynamicRenderingFeaturesKHR;
+	PhysicalDeviceVulkan12Features features12{};
+	features12.sType = StructureType::ePhysicalDeviceVulkan12Features;
+	if (hasDynamicRendering) features12.pNext = &dynamicRendering;
+	PhysicalDeviceFeatures2 features2{};
+	features2.sType = StructureType::ePhysicalDeviceFeatures2;
+	features2.pNext = &features12;
+	physicalDevice.getFeatures2(&features2);
+	adapter.features = features2.features;
+	adapter.features12 = features12;
+	adapter.features12.pNext = nullptr;
+	adapter.dynamicRendering = hasDynamicRendering && dynamicRendering.dynamicRendering;
+	return adapter;
+}
+
+const char* AdapterTypeName(PhysicalDeviceType type)
+{
+	switch (type)
+	{
+	case PhysicalDeviceType::eDiscreteGpu: return "discrete";
+	case PhysicalDeviceType::eIntegratedGpu: return "integrated";
+	case PhysicalDeviceType::eVirtualGpu: return "virtual";
+	case PhysicalDeviceType::eCpu: return "cpu";
+	default: return "other";
+	}
+}
+
+static uint64_t TypeRank(PhysicalDeviceType type)
+{
+	switch (type)
+	{
+	case PhysicalDeviceType::eDiscreteGpu: return 4;
+	case PhysicalDeviceType::eIntegratedGpu: return 3;
+	case PhysicalDeviceType::eVirtualGpu: return 2;
+	// Software rasterizers such as lavapipe come last, but still run when they are all there is.
+	case PhysicalDeviceType::eCpu: return 0;
+	default: return 1;
+	}
+}
+
+static QueueSelection SelectQueues(const AdapterInfo& adapter, const DeviceRequirements& requirements)
+{
+	QueueSelection queues;
+	auto& families = adapter.families;
+	for (uint32_t i = 0; i < families.size() && queues.graphics == UINT32_MAX; i++) {
+		if (!(families[i].queueFlags & QueueFlagBits::eGraphics) || families[i].queueCount == 0) continue;
+		if (requirements.present && !adapter.presentSupport[i]) continue;
+		queues.graphics = i;
+	}
+	if (queues.graphics == UINT32_MAX) return queues;
+	// A compute family without graphics runs beside the graphics queue on hardware with async compute; a family
+	// with neither maps to the copy engines on discrete hardware.
+	queues.compute = queues.graphics;
+	queues.transfer = queues.graphics;
+	for (uint32_t i = 0; i < families.size(); i++) {
+		auto flags = families[i].queueFlags;
+		if (families[i].queueCount == 0 || flags & QueueFlagBits::eGraphics) continue;
+		if (flags & QueueFlagBits::eCompute) {
+			if (queues.compute == queues.graphics) queues.compute = i;
+		}
+		else if (flags & QueueFlagBits::eTransfer) {
+			if (queues.transfer == queues.graphics) queues.transfer = i;
+		}
+	}
+	return queues;
+}
+
+AdapterScore ScoreAdapter(const AdapterInfo& adapter, const DeviceRequirements& requirements)
+{
+	AdapterScore result;
+	// Frame pacing is built on timeline semaphores and all resources are reached through bindless descriptors.
+	PhysicalDeviceVulkan12Features bindless{};
+	if (adapter.apiVersion < VK_API_VERSION_1_2) result.reason = "Vulkan 1.2 unsupported";
+	else if (!adapter.features12.timelineSemaphore) result.reason = "no timeline semaphores";
+	else if (!BindlessTable::EnableFeatures(adapter.features12, bindless)) result.reason = "no descriptor indexing";
+	else if (requirements.present && !adapter.HasExtension(VK_KHR_SWAPCHAIN_EXTENSION_NAME)) result.reason = "no swapchain";
+	if (!result.reason.empty()) return result;
+	result.queues = SelectQueues(adapter, requirements);
+	if (result.queues.graphics == UINT32_MAX) {
+		result.reason = requirements.present ? "no graphics queue that can present" : "no graphics queue";
+		return result;
+	}
+	result.suitable = true;
+	bool optional[] = {
+		adapter.dynamicRendering,
+		(bool)adapter.features.multiDrawIndirect,
+		(bool)adapter.features.drawIndirectFirstInstance,
+		(bool)adapter.features12.drawIndirectCount,
+		result.queues.compute != result.queues.graphics,
+		result.queues.transfer != result.queues.graphics
+	};
+	uint64_t features = std::count(std::begin(optional), std::end(optional), true);
+	uint64_t heapMiB = std::min<uint64_t>(adapter.localHeapBytes >> 20, (1ull << 32) - 1);
+	result.score = TypeRank(adapter.type) << 40 | features << 32 | heapMiB;
+	return result;
+}
+
+int SelectAdapter(const std::vector<AdapterInfo>& adapters, const DeviceRequirements& requirements, const std::string& preference, std::vector<AdapterScore>& scores)
+{
+	scores.clear();
+	for (auto& adapter : adapters) scores.push_back(ScoreAdapter(adapter, requirements));
+	if (!preference.empty()) {
+		bool isIndex = std::all_of(preference.begin(), preference.end(), [](char c) { return std::isdigit((unsigned char)c) != 0; });
+		auto lower = [](std::string text) {
+			std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+			return text;
+		};
+		for (size_t i = 0; i < adapters.size(); i++) {
+			bool named = isIndex ? std::stoul(preference) == i : lower(adapters[i].name).find(lower(preference)) != std::string::npos;
+			if (named && scores[i].suitable) return (int)i;
+		}
+	}
+	int best = -1;
+	for (size_t i = 0; i < adapters.size(); i++) {
+		if (scores[i].suitable && (best < 0 || scores[i].score > scores[best].score)) best = (int)i;
+	}
+	return best;
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include "Dispatch.h"
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// What adapter selection looks at, gathered by DescribeAdapter() or filled in by hand to exercise the selection
+// without a device. Feature structs are copies with pNext cleared.
+struct AdapterInfo {
+	std::string name;
+	vk::PhysicalDeviceType type = vk::PhysicalDeviceType::eOther;
+	uint32_t apiVersion = 0;
+	// Sum of the device-local heaps; shared system memory on integrated and software adapters.
+	vk::DeviceSize localHeapBytes = 0;
+	std::vector<vk::QueueFamilyProperties> families;
+	// Per family, whether it can present to the window.
+	std::vector<bool> presentSupport;
+	std::vector<std::string> extensions;
+	vk::PhysicalDeviceFeatures features;
+	vk::PhysicalDeviceVulkan12Features features12;
+	// VK_KHR_dynamic_rendering is exposed and its feature supported.
+	bool dynamicRendering = false;
+
+	bool HasExtension(const char* name) const;
+};
+
+struct DeviceRequirements {
+	// The graphics family must be able to present, and the swapchain extension must exist.
+	bool present = true;
+};
+
+// Queue families the renderer uses. compute and transfer fall back to graphics when the adapter has no family
+// dedicated to them.
+struct QueueSelection {
+	uint32_t graphics = UINT32_MAX;
+	uint32_t compute = UINT32_MAX;
+	uint32_t transfer = UINT32_MAX;
+};
+
+struct AdapterScore {
+	bool suitable = false;
+	// Why an unsuitable adapter was rejected.
+	std::string reason;
+	// Higher is better. Adapter type dominates, then the optional features, then the local heap size.
+	uint64_t score = 0;
+	QueueSelection queues;
+};
+
+AdapterInfo DescribeAdapter(vk::PhysicalDevice physicalDevice, const std::function<bool(uint32_t family)>& presentSupport);
+const char* AdapterTypeName(vk::PhysicalDeviceType type);
+AdapterScore ScoreAdapter(const AdapterInfo& adapter, const DeviceRequirements& requirements);
+// Index of the suitable adapter with the highest score, or -1. A non-empty preference, either an index or part of
+// an adapter name, wins over the scores as long as it names a suitable adapter. scores receives one entry per
+// adapter.
+int SelectAdapter(const std::vector<AdapterInfo>& adapters, const DeviceRequirements& requirements, const std::string& preference, std::vector<AdapterScore>& scores);
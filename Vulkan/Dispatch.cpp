@@ -0,0 +1,27 @@
+#include "Dispatch.h"
+#include <stdexcept>
+
+#if !VULKAN_HPP_DISPATCH_LOADER_DYNAMIC
+#error "VULKAN_HPP_DISPATCH_LOADER_DYNAMIC must not be overridden to 0; vk:: calls rely on the dispatch table"
+#endif
+
+VULKAN_HPP_DEFAULT_DISPATCH_LOADER_DYNAMIC_STORAGE
+
+void Dispatch::LoadLoader()
+{
+	// Opens vulkan-1.dll or libvulkan.so.1 at runtime, so nothing links against the loader.
+	static vk::DynamicLoader loader;
+	auto getInstanceProcAddr = loader.getProcAddress<PFN_vkGetInstanceProcAddr>("vkGetInstanceProcAddr");
+	if (getInstanceProcAddr == nullptr) throw std::runtime_error("Vulkan loader not found");
+	VULKAN_HPP_DEFAULT_DISPATCHER.init(getInstanceProcAddr);
+}
+
+void Dispatch::LoadInstance(vk::Instance instance)
+{
+	VULKAN_HPP_DEFAULT_DISPATCHER.init(instance);
+}
+
+void Dispatch::LoadDevice(vk::Device device)
+{
+	VULKAN_HPP_DEFAULT_DISPATCHER.init(device);
+}
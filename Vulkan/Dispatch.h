@@ -0,0 +1,22 @@
+#pragma once
+// Every translation unit must see the same configuration, since it shapes the dispatch table's layout. Headers
+// include this one instead of vulkan.hpp so the build does not depend on project-wide defines.
+#ifndef VULKAN_HPP_DISPATCH_LOADER_DYNAMIC
+#define VULKAN_HPP_DISPATCH_LOADER_DYNAMIC 1
+#endif
+#if defined(_WIN32) && !defined(VK_USE_PLATFORM_WIN32_KHR)
+#define VK_USE_PLATFORM_WIN32_KHR
+#endif
+#include <vulkan/vulkan.hpp>
+
+// Every vk:: call goes through vulkan.hpp's default dynamic dispatcher, whose table is generated from the registry
+// and covers every command. Device commands are fetched with vkGetDeviceProcAddr, so hot-path calls jump straight
+// into the driver instead of through loader trampolines.
+namespace Dispatch {
+	// Loads the Vulkan loader and the global commands; call before creating an instance.
+	void LoadLoader();
+	// Resolves instance commands, and device commands as loader trampolines.
+	void LoadInstance(vk::Instance instance);
+	// Replaces the device commands with entry points owned by device.
+	void LoadDevice(vk::Device device);
+}
@@ -0,0 +1,48 @@
+#include "DynamicResolution.h"
+
+#include <algorithm>
+#include <cmath>
+
+void ResolutionController::Configure(const ResolutionSettings& settings, uint32_t latency)
+{
+	this->settings = settings;
+	this->settings.maxScale = std::max(settings.minScale, settings.maxScale);
+	this->latency = latency;
+	stats = {};
+	stats.scale = std::clamp(1.0f, this->settings.minScale, this->settings.maxScale);
+	settling = 0;
+	filtered = -1;
+}
+
+float ResolutionController::Update(double gpuMs)
+{
+	if (settling > 0) {
+		settling--;
+		stats.holds++;
+		return stats.scale;
+	}
+	// Smoothed so a single slow frame does not cost the next several frames their resolution.
+	filtered = filtered < 0 ? gpuMs : filtered + (gpuMs - filtered) * 0.25;
+	stats.gpuMs = filtered;
+	if (std::abs(filtered / settings.targetMs - 1) <= settings.hysteresis || filtered <= 0) {
+		stats.holds++;
+		return stats.scale;
+	}
+	float ideal = stats.scale * (float)std::sqrt(settings.targetMs / filtered);
+	float next = std::clamp(stats.scale + (ideal - stats.scale) * 0.5f, settings.minScale, settings.maxScale);
+	if (std::abs(next - stats.scale) < 0.01f) {
+		stats.holds++;
+		return stats.scale;
+	}
+	if (next > stats.scale) stats.raises++;
+	else stats.lowers++;
+	stats.scale = next;
+	settling = latency;
+	filtered = -1;
+	return stats.scale;
+}
+
+vk::Extent2D ResolutionController::Apply(vk::Extent2D full, float scale)
+{
+	return vk::Extent2D(std::max(1u, (uint32_t)std::lround(full.width * scale)), std::max(1u, (uint32_t)std::lround(full.height * scale)));
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include "Dispatch.h"
+#include <cstdint>
+
+struct ResolutionSettings {
+	// GPU milliseconds per frame the controller steers towards.
+	double targetMs = 16.6;
+	// Bounds on the scale of each axis relative to the output.
+	float minScale = 0.5f;
+	float maxScale = 1.0f;
+	// GPU time within this fraction of the target leaves the scale alone.
+	float hysteresis = 0.05f;
+};
+
+struct ResolutionStats {
+	float scale = 1.0f;
+	// Smoothed GPU frame time the last decision was based on; negative before the first one.
+	double gpuMs = -1;
+	uint64_t raises = 0;
+	uint64_t lowers = 0;
+	// Samples that changed nothing: within the hysteresis band, against a bound, or still from before a change.
+	uint64_t holds = 0;
+};
+
+// Feedback controller picking the render scale from measured GPU frame times. GPU time is taken to grow with the
+// pixel count, so each step aims for the scale that would have hit the target and goes half way there. After a
+// change the samples of frames already in flight at the old scale are discarded.
+class ResolutionController
+{
+	ResolutionSettings settings;
+	ResolutionStats stats;
+	// Samples still to discard after a change.
+	uint32_t settling = 0;
+	uint32_t latency = 0;
+	double filtered = -1;
+public:
+	// latency is how many frames old a GPU time is when it is read back.
+	void Configure(const ResolutionSettings& settings, uint32_t latency);
+	// Feeds the GPU time of one frame and returns the scale for the next.
+	float Update(double gpuMs);
+	float Scale() const { return stats.scale; }
+	float MaxScale() const { return settings.maxScale; }
+	const ResolutionStats& Stats() const { return stats; }
+	// full scaled by scale, never empty.
+	static vk::Extent2D Apply(vk::Extent2D full, float scale);
+};
@@ -0,0 +1,22 @@
+# Turns a SPIR-V binary into a header declaring it as a constexpr array of 32-bit words, so shaders are
+# compiled into the executable. Run by the shader custom build steps in Vulkan.vcxproj.
+param(
+	[Parameter(Mandatory = $true)][string]$Spirv,
+	[Parameter(Mandatory = $true)][string]$Header,
+	[Parameter(Mandatory = $true)][string]$Name
+)
+
+$bytes = [System.IO.File]::ReadAllBytes($Spirv)
+if ($bytes.Length % 4 -ne 0) { throw "$Spirv is not a whole number of SPIR-V words" }
+$builder = New-Object System.Text.StringBuilder
+[void]$builder.AppendLine("// Generated from $([System.IO.Path]::GetFileName($Spirv)) by EmbedSpirv.ps1; do not edit.")
+[void]$builder.AppendLine("#pragma once")
+[void]$builder.AppendLine("#include <cstdint>")
+[void]$builder.AppendLine("")
+[void]$builder.Append("alignas(4) constexpr uint32_t $Name[] = {")
+for ($i = 0; $i -lt $bytes.Length; $i += 4) {
+	if (($i / 4) % 8 -eq 0) { [void]$builder.Append("`n`t") }
+	[void]$builder.AppendFormat("0x{0:x8}, ", [System.BitConverter]::ToUInt32($bytes, $i))
+}
+[void]$builder.AppendLine("`n};")
+[System.IO.File]::WriteAllText($Header, $builder.ToString())
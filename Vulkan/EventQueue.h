@@ -0,0 +1,31 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+
+// Bounded single-producer/single-consumer ring. Push and Pop never block or allocate; Push fails when the ring is full.
+template <typename T, size_t Capacity>
+class SpscQueue
+{
+	static_assert((Capacity & (Capacity - 1)) == 0, "capacity must be a power of two");
+	T items[Capacity];
+	// Each index is written by one side only; the other side reads it with acquire to see the item it covers.
+	alignas(64) std::atomic<size_t> head{ 0 };
+	alignas(64) std::atomic<size_t> tail{ 0 };
+public:
+	bool Push(const T& item)
+	{
+		size_t back = tail.load(std::memory_order_relaxed);
+		if (back - head.load(std::memory_order_acquire) == Capacity) return false;
+		items[back & (Capacity - 1)] = item;
+		tail.store(back + 1, std::memory_order_release);
+		return true;
+	}
+	bool Pop(T& item)
+	{
+		size_t front = head.load(std::memory_order_relaxed);
+		if (front == tail.load(std::memory_order_acquire)) return false;
+		item = items[front & (Capacity - 1)];
+		head.store(front + 1, std::memory_order_release);
+		return true;
+	}
+};
@@ -0,0 +1,159 @@
+#include "FrameCapture.h"
+#include "Log.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+using namespace vk;
+namespace fs = std::filesystem;
+
+// Bytes per pixel of the color target, which is R8G8B8A8.
+static constexpr DeviceSize PixelBytes = 4;
+
+void FrameCapture::Create(MemoryAllocator& allocator, DeletionQueue& deletions, const CaptureSettings& settings, Extent2D extent)
+{
+	this->settings = settings;
+	this->deletions = &deletions;
+	std::error_code error;
+	fs::create_directories(settings.directory, error);
+	if (!fs::is_directory(settings.directory)) throw std::runtime_error("failed to create capture directory!");
+	// The writer reads every byte once; cached memory makes that a memcpy-speed read instead of one over the bus.
+	properties = MemoryPropertyFlagBits::eHostVisible | MemoryPropertyFlagBits::eHostCoherent;
+	if (allocator.HasMemoryType(properties | MemoryPropertyFlagBits::eHostCached)) properties |= MemoryPropertyFlagBits::eHostCached;
+	slots.resize(std::max(1u, settings.ringSize));
+	for (auto& slot : slots) Allocate(slot, (DeviceSize)extent.width * extent.height * PixelBytes);
+	writer = std::thread(&FrameCapture::Run, this);
+	Log("capture: %s frames to %s, %zu slots%s, read back %u frames late", CaptureFormatName(settings.format), settings.directory.c_str(), slots.size(),
+		properties & MemoryPropertyFlagBits::eHostCached ? " in cached memory" : "", settings.delay);
+}
+
+void FrameCapture::Destroy(uint64_t completed)
+{
+	if (!Enabled()) return;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (uint32_t i = 0; i < slots.size(); i++) {
+			if (slots[i].state == SlotState::Pending && slots[i].value <= completed) {
+				slots[i].state = SlotState::Writing;
+				queue.push_back(i);
+			}
+		}
+		stopping = true;
+	}
+	wake.notify_all();
+	writer.join();
+	for (auto& slot : slots) slot.buffer.Reset();
+	slots.clear();
+	Log("capture: %llu frames written (%.1f MB, %.2fms encode mean), %llu dropped, %llu failed", (unsigned long long)stats.written, stats.bytes / 1048576.0,
+		stats.written + stats.failed > 0 ? stats.encodeMs / (stats.written + stats.failed) : 0.0, (unsigned long long)stats.dropped, (unsigned long long)stats.failed);
+}
+
+void FrameCapture::Allocate(Slot& slot, DeviceSize size)
+{
+	BufferCreateInfo bufferInfo{};
+	bufferInfo.sType = StructureType::eBufferCreateInfo;
+	bufferInfo.size = size;
+	bufferInfo.usage = BufferUsageFlagBits::eTransferDst;
+	bufferInfo.sharingMode = SharingMode::eExclusive;
+	// Assigning retires the outgrown buffer, which the frames that last synchronized on it may still reference.
+	slot.buffer = deletions->CreateBuffer(bufferInfo, properties);
+	slot.capacity = size;
+}
+
+void FrameCapture::Poll(uint64_t submitted, uint64_t completed)
+{
+	if (!Enabled()) return;
+	bool handed = false;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (uint32_t i = 0; i < slots.size(); i++) {
+			auto& slot = slots[i];
+			if (slot.state != SlotState::Pending || slot.value > completed || slot.value + settings.delay > submitted) continue;
+			slot.state = SlotState::Writing;
+			queue.push_back(i);
+			handed = true;
+		}
+	}
+	if (handed) wake.notify_one();
+}
+
+bool FrameCapture::Claim(uint64_t value, Extent2D extent)
+{
+	claimed = UINT32_MAX;
+	if (!Enabled() || frames++ % std::max(1u, settings.interval) != 0) return false;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (uint32_t i = 0; i < slots.size(); i++) {
+			if (slots[i].state != SlotState::Free) continue;
+			slots[i].state = SlotState::Pending;
+			claimed = i;
+			break;
+		}
+		if (!Claimed()) {
+			stats.dropped++;
+			return false;
+		}
+		stats.captured++;
+	}
+	auto& slot = slots[claimed];
+	slot.value = value;
+	slot.extent = extent;
+	DeviceSize size = (DeviceSize)extent.width * extent.height * PixelBytes;
+	if (slot.capacity < size) Allocate(slot, size);
+	return true;
+}
+
+CaptureStats FrameCapture::Stats() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return stats;
+}
+
+void FrameCapture::Run()
+{
+	Trace::SetThreadName("capture");
+	std::unique_lock<std::mutex> lock(mutex);
+	for (;;) {
+		wake.wait(lock, [&] { return stopping || !queue.empty(); });
+		// Stopping still drains the queue, so every frame handed over is written.
+		if (queue.empty()) return;
+		auto& slot = slots[queue.front()];
+		queue.pop_front();
+		lock.unlock();
+		auto start = std::chrono::steady_clock::now();
+		auto pixels = static_cast<const uint8_t*>(slot.buffer.Memory().mapped);
+		std::vector<uint8_t> encoded;
+		{
+			TraceScope trace("encodeFrame");
+			if (settings.format == CaptureFormat::Png) encoded = EncodePng(pixels, slot.extent.width, slot.extent.height);
+			else encoded = EncodeRaw(pixels, slot.extent.width, slot.extent.height, slot.value, settings.format == CaptureFormat::RawLz);
+		}
+		double encodeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		char name[64];
+		snprintf(name, sizeof(name), "frame_%06llu.%s", (unsigned long long)slot.value, CaptureFormatExtension(settings.format));
+		auto path = (fs::path(settings.directory) / name).string();
+		bool written;
+		{
+			TraceScope trace("writeFrame");
+			std::ofstream file(path, std::ios::binary);
+			file.write(reinterpret_cast<const char*>(encoded.data()), encoded.size());
+			written = file.good();
+		}
+		lock.lock();
+		slot.state = SlotState::Free;
+		stats.encodeMs += encodeMs;
+		if (written) {
+			stats.written++;
+			stats.bytes += encoded.size();
+		}
+		// Only the first failure is logged; a full disk would otherwise log every frame.
+		else if (stats.failed++ == 0) {
+			Log("capture: failed to write %s", path.c_str());
+		}
+	}
+}
@@ -0,0 +1,92 @@
+#pragma once
+#include "DeletionQueue.h"
+#include "ImageCodec.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct CaptureSettings {
+	// Directory frames are written to as frame_<timeline value>.<extension>; empty disables capture.
+	std::string directory;
+	CaptureFormat format = CaptureFormat::Png;
+	// Host-readable buffers frames are copied into. A frame finding all of them waiting or being written is dropped.
+	uint32_t ringSize = 4;
+	// Frames submitted after a captured one before its copy is read, on top of the GPU having finished it.
+	uint32_t delay = 2;
+	// Capture every n-th frame.
+	uint32_t interval = 1;
+};
+
+struct CaptureStats {
+	// Render thread: frames copied into the ring, and frames skipped because the ring was full.
+	uint64_t captured = 0;
+	uint64_t dropped = 0;
+	// Writer thread: files written, failed writes, bytes written and the time spent encoding.
+	uint64_t written = 0;
+	uint64_t failed = 0;
+	uint64_t bytes = 0;
+	double encodeMs = 0;
+};
+
+// Streams rendered frames to disk without the render thread ever waiting for them. Each captured frame copies its
+// image into a free slot of a ring of persistently mapped host buffers; once the GPU has completed the frame and
+// delay more frames have been submitted, the slot goes to a writer thread that encodes and writes it, then frees
+// it. When the writer falls behind the ring fills up and frames are dropped instead. Slots grow with the frame
+// size on reuse; the buffers they outgrow are retired to the deletion queue.
+class FrameCapture
+{
+	enum class SlotState {
+		Free,
+		// Claimed by a frame that may still be on the GPU.
+		Pending,
+		// Handed to the writer thread.
+		Writing
+	};
+	struct Slot {
+		Owned<vk::Buffer> buffer;
+		vk::DeviceSize capacity = 0;
+		SlotState state = SlotState::Free;
+		// Timeline value and size of the frame copied in.
+		uint64_t value = 0;
+		vk::Extent2D extent;
+	};
+
+	CaptureSettings settings;
+	DeletionQueue* deletions = nullptr;
+	vk::MemoryPropertyFlags properties;
+	// Fixed once Create() returns; slot states are guarded by mutex, the rest only change while a slot is Free.
+	std::vector<Slot> slots;
+	// Slot the current frame copies into; UINT32_MAX when it copies nothing.
+	uint32_t claimed = UINT32_MAX;
+	uint64_t frames = 0;
+	std::thread writer;
+	mutable std::mutex mutex;
+	std::condition_variable wake;
+	std::deque<uint32_t> queue;
+	bool stopping = false;
+	CaptureStats stats;
+
+	void Allocate(Slot& slot, vk::DeviceSize size);
+	void Run();
+public:
+	// Allocates the whole ring for extent up front and starts the writer; throws when the directory cannot be created.
+	void Create(MemoryAllocator& allocator, DeletionQueue& deletions, const CaptureSettings& settings, vk::Extent2D extent);
+	// Hands over every frame at or below completed, writes everything handed over, stops the writer and retires the
+	// ring. Frames still pending past completed are lost.
+	void Destroy(uint64_t completed);
+	bool Enabled() const { return !slots.empty(); }
+	// Hands the slots of frames the GPU has reached and that are delay frames behind submitted to the writer. Never
+	// blocks; call once per frame.
+	void Poll(uint64_t submitted, uint64_t completed);
+	// Picks the slot the frame signaling value copies its extent-sized image into, unless the frame is skipped by the
+	// interval or the ring is full; returns whether it got one.
+	bool Claim(uint64_t value, vk::Extent2D extent);
+	bool Claimed() const { return claimed != UINT32_MAX; }
+	// The claimed slot's buffer, or any slot's when the frame copies nothing, so the pass copying into it always has
+	// a valid buffer to synchronize.
+	vk::Buffer Target() const { return slots[Claimed() ? claimed : 0].buffer.Get(); }
+	CaptureStats Stats() const;
+};
@@ -0,0 +1,108 @@
+#include "FramePacer.h"
+#ifdef _DEBUG
+#include <cassert>
+#else
+#define assert(X) (void)(X)
+#endif
+
+#include <algorithm>
+#include <string>
+#include <thread>
+
+using namespace vk;
+
+const char* PacingModeName(PacingMode mode)
+{
+	switch (mode)
+	{
+	case PacingMode::LowLatency: return "low-latency";
+	case PacingMode::Throughput: return "throughput";
+	case PacingMode::Vsync: return "vsync";
+	default: return "unknown";
+	}
+}
+
+bool ParsePacingMode(const std::string& name, PacingMode& mode)
+{
+	for (auto candidate : { PacingMode::LowLatency, PacingMode::Throughput, PacingMode::Vsync }) {
+		if (name == PacingModeName(candidate)) {
+			mode = candidate;
+			return true;
+		}
+	}
+	return false;
+}
+
+uint32_t FramesInFlight(PacingMode mode, uint32_t requested)
+{
+	switch (mode)
+	{
+	case PacingMode::LowLatency: return requested > 0 ? std::min(requested, 2u) : 2;
+	case PacingMode::Throughput: return requested > 0 ? requested : 3;
+	default: return requested > 0 ? requested : 2;
+	}
+}
+
+void FramePacer::Create(Device device)
+{
+	this->device = device;
+	SemaphoreTypeCreateInfo typeInfo{};
+	typeInfo.sType = StructureType::eSemaphoreTypeCreateInfo;
+	typeInfo.semaphoreType = SemaphoreType::eTimeline;
+	typeInfo.initialValue = 0;
+	SemaphoreCreateInfo semaphoreInfo{};
+	semaphoreInfo.sType = StructureType::eSemaphoreCreateInfo;
+	semaphoreInfo.pNext = &typeInfo;
+	assert(device.createSemaphore(&semaphoreInfo, nullptr, &timeline) == Result::eSuccess);
+}
+
+void FramePacer::Destroy()
+{
+	device.destroySemaphore(timeline, nullptr);
+	pending.clear();
+}
+
+void FramePacer::Wait(uint64_t value)
+{
+	if (value <= completed) return;
+	SemaphoreWaitInfo waitInfo{};
+	waitInfo.sType = StructureType::eSemaphoreWaitInfo;
+	waitInfo.semaphoreCount = 1;
+	waitInfo.pSemaphores = &timeline;
+	waitInfo.pValues = &value;
+	assert(device.waitSemaphores(&waitInfo, UINT64_MAX) == Result::eSuccess);
+}
+
+void FramePacer::Submitted(Clock::time_point inputTime)
+{
+	pending.push_back({ ++submitted, inputTime });
+}
+
+double FramePacer::Poll()
+{
+	if (pending.empty()) return -1;
+	assert(device.getSemaphoreCounterValue(timeline, &completed) == Result::eSuccess);
+	auto now = Clock::now();
+	double latency = -1;
+	// Completion is only observed here, so the latency is an upper bound that is at most one poll late.
+	while (!pending.empty() && pending.front().value <= completed) {
+		latency = std::chrono::duration<double, std::milli>(now - pending.front().inputTime).count();
+		pending.pop_front();
+	}
+	return latency;
+}
+
+FrameLimiter::FrameLimiter(double maxFps) : deadline(Clock::now())
+{
+	if (maxFps > 0) interval = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / maxFps));
+}
+
+void FrameLimiter::Wait()
+{
+	if (interval == Clock::duration::zero()) return;
+	deadline += interval;
+	auto now = Clock::now();
+	// A frame that overran its slot restarts the schedule instead of letting the next frames catch up back to back.
+	if (deadline < now) deadline = now;
+	else std::this_thread::sleep_until(deadline);
+}
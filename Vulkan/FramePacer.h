@@ -0,0 +1,62 @@
+#pragma once
+#include "Dispatch.h"
+#include <chrono>
+#include <deque>
+#include <string>
+
+enum class PacingMode {
+	// Mailbox, else immediate, with at most two frames queued so input reaches the screen quickly.
+	LowLatency,
+	// Immediate, else mailbox, with a deeper queue so the GPU never waits on the CPU.
+	Throughput,
+	// FIFO only; every other mode also falls back to it when the surface offers nothing better.
+	Vsync
+};
+
+const char* PacingModeName(PacingMode mode);
+bool ParsePacingMode(const std::string& name, PacingMode& mode);
+// Frames the CPU may record ahead of the GPU for mode, honoring requested when it is non-zero.
+uint32_t FramesInFlight(PacingMode mode, uint32_t requested);
+
+// Paces the CPU against the GPU with one timeline semaphore: every submitted frame signals the next value
+// and the CPU waits for the value a frame slot was last submitted with before it reuses that slot.
+class FramePacer
+{
+	using Clock = std::chrono::steady_clock;
+	struct PendingFrame {
+		uint64_t value;
+		Clock::time_point inputTime;
+	};
+
+	vk::Device device;
+	vk::Semaphore timeline;
+	uint64_t submitted = 0;
+	uint64_t completed = 0;
+	std::deque<PendingFrame> pending;
+public:
+	void Create(vk::Device device);
+	void Destroy();
+	vk::Semaphore Semaphore() const { return timeline; }
+	// Value the next submitted frame signals.
+	uint64_t NextValue() const { return submitted + 1; }
+	// Newest value the GPU was seen to reach by the last Poll().
+	uint64_t Completed() const { return completed; }
+	// Blocks until the GPU has reached value; 0 never blocks.
+	void Wait(uint64_t value);
+	// Records that a frame which sampled input at inputTime was submitted signaling NextValue().
+	void Submitted(Clock::time_point inputTime);
+	// Retires every frame the GPU has finished and returns the input-to-completion latency in milliseconds of the
+	// newest one, or a negative value when none finished since the last call.
+	double Poll();
+};
+
+// Caps the render loop's frame rate by sleeping until the next frame's deadline; a zero cap never sleeps.
+class FrameLimiter
+{
+	using Clock = std::chrono::steady_clock;
+	Clock::duration interval{};
+	Clock::time_point deadline;
+public:
+	explicit FrameLimiter(double maxFps);
+	void Wait();
+};
@@ -0,0 +1,445 @@
+#include "ImageCodec.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+	constexpr uint32_t RawMagic = 0x46524B56; // "VKRF"
+	constexpr uint32_t RawVersion = 1;
+
+	// Deflate limits (RFC 1951).
+	constexpr size_t WindowSize = 32768;
+	constexpr size_t DeflateMinMatch = 3;
+	constexpr size_t DeflateMaxMatch = 258;
+	// Candidates tried per position; deeper chains buy a few percent of ratio at a multiple of the time.
+	constexpr uint32_t MaxChain = 16;
+	constexpr uint32_t DeflateHashBits = 15;
+
+	// LZ4 block rules: matches are at least 4 bytes, the last 5 bytes are literals, and no match starts in the
+	// last 12.
+	constexpr size_t LzMinMatch = 4;
+	constexpr size_t LzLastLiterals = 5;
+	constexpr size_t LzMatchFindLimit = 12;
+	constexpr size_t LzMaxOffset = 65535;
+	constexpr uint32_t LzHashBits = 16;
+
+	constexpr size_t NoPosition = SIZE_MAX;
+
+	constexpr uint16_t LengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+	constexpr uint8_t LengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+	constexpr uint16_t DistanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097,
+		6145, 8193, 12289, 16385, 24577 };
+
+	// Appends bits least significant first, the order deflate packs everything in; Huffman codes are stored
+	// reversed so they come out most significant first.
+	class BitWriter
+	{
+		std::vector<uint8_t>& out;
+		uint64_t bits = 0;
+		uint32_t count = 0;
+	public:
+		explicit BitWriter(std::vector<uint8_t>& out) : out(out) {}
+		void Put(uint32_t value, uint32_t length)
+		{
+			bits |= (uint64_t)value << count;
+			count += length;
+			while (count >= 8) {
+				out.push_back((uint8_t)bits);
+				bits >>= 8;
+				count -= 8;
+			}
+		}
+		void Flush()
+		{
+			if (count > 0) out.push_back((uint8_t)bits);
+			bits = 0;
+			count = 0;
+		}
+	};
+
+	struct HuffmanCode {
+		uint16_t bits;
+		uint8_t length;
+	};
+
+	uint16_t Reverse(uint32_t code, uint32_t length)
+	{
+		uint32_t result = 0;
+		for (uint32_t i = 0; i < length; i++, code >>= 1) result = result << 1 | (code & 1);
+		return (uint16_t)result;
+	}
+
+	struct FixedCodes {
+		std::array<HuffmanCode, 288> literals;
+		std::array<HuffmanCode, 30> distances;
+		// Length symbol index into LengthBase for every match length.
+		std::array<uint8_t, DeflateMaxMatch + 1> lengthSymbols;
+
+		FixedCodes()
+		{
+			for (uint32_t symbol = 0; symbol < 288; symbol++) {
+				if (symbol < 144) literals[symbol] = { Reverse(0x30 + symbol, 8), 8 };
+				else if (symbol < 256) literals[symbol] = { Reverse(0x190 + symbol - 144, 9), 9 };
+				else if (symbol < 280) literals[symbol] = { Reverse(symbol - 256, 7), 7 };
+				else literals[symbol] = { Reverse(0xC0 + symbol - 280, 8), 8 };
+			}
+			for (uint32_t symbol = 0; symbol < 30; symbol++) distances[symbol] = { Reverse(symbol, 5), 5 };
+			for (uint32_t symbol = 0; symbol < 29; symbol++) {
+				uint32_t end = symbol == 28 ? DeflateMaxMatch + 1 : LengthBase[symbol + 1];
+				for (uint32_t length = LengthBase[symbol]; length < end; length++) lengthSymbols[length] = (uint8_t)symbol;
+			}
+		}
+	};
+
+	const FixedCodes& Codes()
+	{
+		static const FixedCodes codes;
+		return codes;
+	}
+
+	uint32_t DistanceSymbol(uint32_t distance)
+	{
+		uint32_t d = distance - 1;
+		if (d < 4) return d;
+		uint32_t log = 0;
+		while (d >> (log + 1)) log++;
+		return 2 * log + (d >> (log - 1) & 1);
+	}
+
+	uint32_t Load32(const uint8_t* data)
+	{
+		uint32_t value;
+		memcpy(&value, data, sizeof(value));
+		return value;
+	}
+
+	void PutBigEndian(std::vector<uint8_t>& out, uint32_t value)
+	{
+		out.insert(out.end(), { (uint8_t)(value >> 24), (uint8_t)(value >> 16), (uint8_t)(value >> 8), (uint8_t)value });
+	}
+
+	void PutChunk(std::vector<uint8_t>& out, const char* type, const uint8_t* data, size_t size)
+	{
+		PutBigEndian(out, (uint32_t)size);
+		size_t start = out.size();
+		out.insert(out.end(), type, type + 4);
+		out.insert(out.end(), data, data + size);
+		PutBigEndian(out, Crc32(out.data() + start, 4 + size));
+	}
+
+	// Literal and match lengths above the token's 4 bits continue in bytes of 255 and a final remainder.
+	void PutLzLength(std::vector<uint8_t>& out, size_t length)
+	{
+		for (; length >= 255; length -= 255) out.push_back(255);
+		out.push_back((uint8_t)length);
+	}
+
+	void PutLzSequence(std::vector<uint8_t>& out, const uint8_t* literals, size_t literalCount, size_t offset, size_t matchLength)
+	{
+		size_t matchCode = matchLength - LzMinMatch;
+		out.push_back((uint8_t)(std::min<size_t>(literalCount, 15) << 4 | std::min<size_t>(matchCode, 15)));
+		if (literalCount >= 15) PutLzLength(out, literalCount - 15);
+		out.insert(out.end(), literals, literals + literalCount);
+		out.push_back((uint8_t)offset);
+		out.push_back((uint8_t)(offset >> 8));
+		if (matchCode >= 15) PutLzLength(out, matchCode - 15);
+	}
+
+	bool ReadLzLength(const uint8_t* data, size_t size, size_t& in, size_t& length)
+	{
+		uint8_t byte;
+		do {
+			if (in >= size) return false;
+			byte = data[in++];
+			length += byte;
+		} while (byte == 255);
+		return true;
+	}
+}
+
+static_assert(sizeof(RawCaptureHeader) == 48, "raw capture header layout is part of the file format");
+
+const char* CaptureFormatName(CaptureFormat format)
+{
+	switch (format)
+	{
+	case CaptureFormat::Png: return "png";
+	case CaptureFormat::Raw: return "raw";
+	case CaptureFormat::RawLz: return "raw-lz";
+	default: return "unknown";
+	}
+}
+
+bool ParseCaptureFormat(const std::string& name, CaptureFormat& format)
+{
+	for (auto candidate : { CaptureFormat::Png, CaptureFormat::Raw, CaptureFormat::RawLz }) {
+		if (name == CaptureFormatName(candidate)) {
+			format = candidate;
+			return true;
+		}
+	}
+	return false;
+}
+
+const char* CaptureFormatExtension(CaptureFormat format)
+{
+	return format == CaptureFormat::Png ? "png" : "raw";
+}
+
+uint32_t Crc32(const uint8_t* data, size_t size, uint32_t crc)
+{
+	static const auto table = [] {
+		std::array<uint32_t, 256> result{};
+		for (uint32_t i = 0; i < 256; i++) {
+			uint32_t c = i;
+			for (int bit = 0; bit < 8; bit++) c = c & 1 ? 0xEDB88320u ^ c >> 1 : c >> 1;
+			result[i] = c;
+		}
+		return result;
+	}();
+	crc = ~crc;
+	for (size_t i = 0; i < size; i++) crc = table[(crc ^ data[i]) & 0xFF] ^ crc >> 8;
+	return ~crc;
+}
+
+uint32_t Adler32(const uint8_t* data, size_t size, uint32_t adler)
+{
+	constexpr uint32_t Modulus = 65521;
+	// The most bytes summed before b can overflow 32 bits.
+	constexpr size_t Run = 5552;
+	uint32_t a = adler & 0xFFFF;
+	uint32_t b = adler >> 16;
+	while (size > 0) {
+		size_t run = std::min(size, Run);
+		for (size_t i = 0; i < run; i++) {
+			a += data[i];
+			b += a;
+		}
+		a %= Modulus;
+		b %= Modulus;
+		data += run;
+		size -= run;
+	}
+	return b << 16 | a;
+}
+
+std::vector<uint8_t> Deflate(const uint8_t* data, size_t size)
+{
+	auto& codes = Codes();
+	std::vector<uint8_t> out;
+	out.reserve(size / 2 + 64);
+	// CMF: deflate with a 32K window; FLG: fastest level, and the check bits that make the pair a multiple of 31.
+	out.push_back(0x78);
+	out.push_back(0x01);
+	BitWriter writer(out);
+	// A single final block with the fixed codes.
+	writer.Put(1, 1);
+	writer.Put(1, 2);
+	auto putLiteral = [&](uint32_t symbol) { writer.Put(codes.literals[symbol].bits, codes.literals[symbol].length); };
+	std::vector<size_t> head((size_t)1 << DeflateHashBits, NoPosition);
+	std::vector<size_t> previous(WindowSize, NoPosition);
+	auto hash = [&](size_t position) {
+		uint32_t key = (uint32_t)data[position] << 16 | (uint32_t)data[position + 1] << 8 | data[position + 2];
+		return (key * 2654435761u) >> (32 - DeflateHashBits);
+	};
+	auto insert = [&](size_t position) {
+		auto& bucket = head[hash(position)];
+		size_t candidate = bucket;
+		previous[position % WindowSize] = candidate;
+		bucket = position;
+		return candidate;
+	};
+	size_t i = 0;
+	while (i < size) {
+		size_t bestLength = 0;
+		size_t bestDistance = 0;
+		if (i + DeflateMinMatch <= size) {
+			size_t candidate = insert(i);
+			size_t limit = std::min(DeflateMaxMatch, size - i);
+			for (uint32_t chain = 0; candidate != NoPosition && i - candidate <= WindowSize && chain < MaxChain; chain++) {
+				// Only a match longer than the best so far matters, so its last byte rejects most candidates.
+				if (data[candidate + bestLength] == data[i + bestLength]) {
+					size_t length = 0;
+					while (length < limit && data[candidate + length] == data[i + length]) length++;
+					if (length > bestLength) {
+						bestLength = length;
+						bestDistance = i - candidate;
+						if (length == limit) break;
+					}
+				}
+				// The window slot may already hold a newer position that reused it.
+				size_t next = previous[candidate % WindowSize];
+				if (next == NoPosition || next >= candidate) break;
+				candidate = next;
+			}
+		}
+		if (bestLength < DeflateMinMatch) {
+			putLiteral(data[i++]);
+			continue;
+		}
+		uint32_t lengthSymbol = codes.lengthSymbols[bestLength];
+		putLiteral(257 + lengthSymbol);
+		writer.Put((uint32_t)bestLength - LengthBase[lengthSymbol], LengthExtra[lengthSymbol]);
+		uint32_t distanceSymbol = DistanceSymbol((uint32_t)bestDistance);
+		writer.Put(codes.distances[distanceSymbol].bits, 5);
+		writer.Put((uint32_t)bestDistance - DistanceBase[distanceSymbol], distanceSymbol < 4 ? 0 : distanceSymbol / 2 - 1);
+		for (size_t j = 1; j < bestLength && i + j + DeflateMinMatch <= size; j++) insert(i + j);
+		i += bestLength;
+	}
+	putLiteral(256);
+	writer.Flush();
+	PutBigEndian(out, Adler32(data, size));
+	return out;
+}
+
+std::vector<uint8_t> EncodePng(const uint8_t* rgba, uint32_t width, uint32_t height)
+{
+	constexpr size_t PixelBytes = 3;
+	size_t rowBytes = (size_t)width * PixelBytes;
+	// Each row is prefixed with the filter that minimizes the sum of its residuals as signed bytes, the heuristic
+	// libpng uses; rendered frames are mostly flat or smooth, so this roughly halves what deflate has to encode.
+	std::vector<uint8_t> filtered((rowBytes + 1) * height);
+	std::vector<uint8_t> previous(rowBytes, 0);
+	std::vector<uint8_t> current(rowBytes);
+	std::array<std::vector<uint8_t>, 5> candidates;
+	for (auto& candidate : candidates) candidate.resize(rowBytes);
+	for (uint32_t y = 0; y < height; y++) {
+		auto source = rgba + (size_t)y * width * 4;
+		for (uint32_t x = 0; x < width; x++) memcpy(&current[x * PixelBytes], source + x * 4, PixelBytes);
+		uint64_t bestScore = UINT64_MAX;
+		size_t best = 0;
+		for (size_t filter = 0; filter < candidates.size(); filter++) {
+			auto& residual = candidates[filter];
+			uint64_t score = 0;
+			for (size_t i = 0; i < rowBytes; i++) {
+				int left = i >= PixelBytes ? current[i - PixelBytes] : 0;
+				int up = previous[i];
+				int upLeft = i >= PixelBytes ? previous[i - PixelBytes] : 0;
+				int predicted = 0;
+				switch (filter)
+				{
+				case 1: predicted = left; break;
+				case 2: predicted = up; break;
+				case 3: predicted = (left + up) / 2; break;
+				case 4: {
+					int estimate = left + up - upLeft;
+					int distanceLeft = std::abs(estimate - left);
+					int distanceUp = std::abs(estimate - up);
+					int distanceUpLeft = std::abs(estimate - upLeft);
+					predicted = distanceLeft <= distanceUp && distanceLeft <= distanceUpLeft ? left : distanceUp <= distanceUpLeft ? up : upLeft;
+					break;
+				}
+				default: break;
+				}
+				residual[i] = (uint8_t)(current[i] - predicted);
+				score += std::abs((int)(int8_t)residual[i]);
+			}
+			if (score < bestScore) {
+				bestScore = score;
+				best = filter;
+			}
+		}
+		auto row = filtered.data() + (size_t)y * (rowBytes + 1);
+		row[0] = (uint8_t)best;
+		memcpy(row + 1, candidates[best].data(), rowBytes);
+		std::swap(previous, current);
+	}
+	std::vector<uint8_t> out = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	std::vector<uint8_t> header;
+	PutBigEndian(header, width);
+	PutBigEndian(header, height);
+	// 8 bits per channel, RGB, deflate, adaptive filtering, no interlace.
+	header.insert(header.end(), { 8, 2, 0, 0, 0 });
+	PutChunk(out, "IHDR", header.data(), header.size());
+	auto compressed = Deflate(filtered.data(), filtered.size());
+	PutChunk(out, "IDAT", compressed.data(), compressed.size());
+	PutChunk(out, "IEND", nullptr, 0);
+	return out;
+}
+
+std::vector<uint8_t> CompressLz(const uint8_t* data, size_t size)
+{
+	std::vector<uint8_t> out;
+	out.reserve(size + size / 255 + 16);
+	std::vector<size_t> table((size_t)1 << LzHashBits, NoPosition);
+	size_t anchor = 0;
+	if (size >= LzMatchFindLimit) {
+		size_t matchLimit = size - LzLastLiterals;
+		size_t i = 0;
+		while (i <= size - LzMatchFindLimit) {
+			uint32_t sequence = Load32(data + i);
+			auto& slot = table[(sequence * 2654435761u) >> (32 - LzHashBits)];
+			size_t candidate = slot;
+			slot = i;
+			if (candidate == NoPosition || i - candidate > LzMaxOffset || Load32(data + candidate) != sequence) {
+				// Steps grow the longer nothing matches, so incompressible data passes through at memory speed.
+				i += 1 + ((i - anchor) >> 6);
+				continue;
+			}
+			size_t length = LzMinMatch;
+			while (i + length < matchLimit && data[candidate + length] == data[i + length]) length++;
+			PutLzSequence(out, data + anchor, i - anchor, i - candidate, length);
+			i += length;
+			anchor = i;
+		}
+	}
+	size_t literalCount = size - anchor;
+	out.push_back((uint8_t)(std::min<size_t>(literalCount, 15) << 4));
+	if (literalCount >= 15) PutLzLength(out, literalCount - 15);
+	out.insert(out.end(), data + anchor, data + size);
+	return out;
+}
+
+bool DecompressLz(const uint8_t* data, size_t size, std::vector<uint8_t>& output, size_t outputSize)
+{
+	output.resize(outputSize);
+	size_t in = 0;
+	size_t out = 0;
+	while (in < size) {
+		uint8_t token = data[in++];
+		size_t literalCount = token >> 4;
+		if (literalCount == 15 && !ReadLzLength(data, size, in, literalCount)) return false;
+		if (literalCount > size - in || literalCount > outputSize - out) return false;
+		memcpy(output.data() + out, data + in, literalCount);
+		in += literalCount;
+		out += literalCount;
+		// The last sequence is literals only.
+		if (in == size) break;
+		if (size - in < 2) return false;
+		size_t offset = data[in] | (size_t)data[in + 1] << 8;
+		in += 2;
+		if (offset == 0 || offset > out) return false;
+		size_t length = token & 15;
+		if (length == 15 && !ReadLzLength(data, size, in, length)) return false;
+		length += LzMinMatch;
+		if (length > outputSize - out) return false;
+		// Byte by byte, since a match may overlap the bytes it produces.
+		for (size_t i = 0; i < length; i++, out++) output[out] = output[out - offset];
+	}
+	return out == outputSize;
+}
+
+std::vector<uint8_t> EncodeRaw(const uint8_t* rgba, uint32_t width, uint32_t height, uint64_t frame, bool compress)
+{
+	RawCaptureHeader header{};
+	header.magic = RawMagic;
+	header.version = RawVersion;
+	header.width = width;
+	header.height = height;
+	header.compression = compress ? 1 : 0;
+	header.frame = frame;
+	header.pixelSize = (uint64_t)width * height * 4;
+	std::vector<uint8_t> out(sizeof(header));
+	if (compress) {
+		auto payload = CompressLz(rgba, (size_t)header.pixelSize);
+		out.insert(out.end(), payload.begin(), payload.end());
+	}
+	else {
+		out.insert(out.end(), rgba, rgba + header.pixelSize);
+	}
+	header.payloadSize = out.size() - sizeof(header);
+	memcpy(out.data(), &header, sizeof(header));
+	return out;
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Encoders for captured frames. Everything here is pure and thread-safe, so frames are encoded off the render thread.
+enum class CaptureFormat {
+	// RGB PNG, deflated with fixed Huffman codes: readable by any image tool, slowest to write.
+	Png,
+	// RawCaptureHeader followed by the RGBA8 pixels as they were read back.
+	Raw,
+	// Raw with the pixels compressed by CompressLz; several times cheaper than PNG and still lossless.
+	RawLz
+};
+
+const char* CaptureFormatName(CaptureFormat format);
+bool ParseCaptureFormat(const std::string& name, CaptureFormat& format);
+// File extension without the dot.
+const char* CaptureFormatExtension(CaptureFormat format);
+
+// Header of raw captures; the file is read back as this struct followed by payloadSize bytes.
+struct RawCaptureHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t width;
+	uint32_t height;
+	// 0: pixels stored as is, 1: CompressLz block.
+	uint32_t compression;
+	uint32_t reserved;
+	// Timeline value of the frame the capture was taken from.
+	uint64_t frame;
+	// Tightly packed RGBA8 bytes, and the bytes that follow the header.
+	uint64_t pixelSize;
+	uint64_t payloadSize;
+};
+
+// CRC-32 as used by PNG and zlib's crc32(); pass the previous result to continue a running checksum.
+uint32_t Crc32(const uint8_t* data, size_t size, uint32_t crc = 0);
+uint32_t Adler32(const uint8_t* data, size_t size, uint32_t adler = 1);
+// A zlib stream (RFC 1950) of one fixed-Huffman deflate block over greedy LZ77 matches. Trades ratio for speed;
+// any inflater reads it.
+std::vector<uint8_t> Deflate(const uint8_t* data, size_t size);
+// Tightly packed RGBA8 pixels as an RGB PNG; alpha is dropped like the PPM dump does.
+std::vector<uint8_t> EncodePng(const uint8_t* rgba, uint32_t width, uint32_t height);
+// A byte-oriented LZ block in the LZ4 block layout: tokens of literal and match lengths, 16-bit offsets, no entropy
+// coding. Compresses at memory speed, where a real zstd would need a dependency this tree does not take.
+std::vector<uint8_t> CompressLz(const uint8_t* data, size_t size);
+// Inverse of CompressLz; false on a malformed block or when it does not expand to exactly outputSize bytes.
+bool DecompressLz(const uint8_t* data, size_t size, std::vector<uint8_t>& output, size_t outputSize);
+// The raw capture file for tightly packed RGBA8 pixels, with them run through CompressLz when compress is set.
+std::vector<uint8_t> EncodeRaw(const uint8_t* rgba, uint32_t width, uint32_t height, uint64_t frame, bool compress);
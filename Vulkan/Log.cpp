@@ -0,0 +1,21 @@
+#include "Log.h"
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+#include <cstdarg>
+#include <cstdio>
+
+void Log(const char* format, ...)
+{
+	char buffer[1024];
+	va_list args;
+	va_start(args, format);
+	vsnprintf(buffer, sizeof(buffer), format, args);
+	va_end(args);
+#ifdef _WIN32
+	OutputDebugStringA(buffer);
+	OutputDebugStringA("\n");
+#else
+	fprintf(stderr, "%s\n", buffer);
+#endif
+}
@@ -0,0 +1,4 @@
+#pragma once
+
+// printf-style diagnostics: the debugger output window on Windows, stderr elsewhere.
+void Log(const char* format, ...);
@@ -0,0 +1,264 @@
+#include "MemoryAllocator.h"
+#include "Log.h"
+#include <algorithm>
+#include <stdexcept>
+
+using namespace vk;
+
+static DeviceSize AlignUp(DeviceSize value, DeviceSize alignment)
+{
+	return alignment > 1 ? (value + alignment - 1) / alignment * alignment : value;
+}
+
+void MemoryAllocator::Create(PhysicalDevice physicalDevice, Device device, DeviceSize blockSize)
+{
+	this->device = device;
+	this->blockSize = blockSize;
+	physicalDevice.getMemoryProperties(&memoryProperties);
+	PhysicalDeviceProperties properties;
+	physicalDevice.getProperties(&properties);
+	granularity = std::max<DeviceSize>(properties.limits.bufferImageGranularity, 1);
+	maxAllocationCount = properties.limits.maxMemoryAllocationCount;
+}
+
+void MemoryAllocator::Destroy()
+{
+	for (auto& block : blocks) {
+		if (block->allocations > 0) Log("memory block of type %u destroyed with %u live allocations", block->memoryType, block->allocations);
+		if (block->mapped != nullptr) device.unmapMemory(block->memory);
+		device.freeMemory(block->memory, nullptr);
+	}
+	blocks.clear();
+	deviceAllocations = 0;
+}
+
+uint32_t MemoryAllocator::FindMemoryType(uint32_t typeFilter, MemoryPropertyFlags properties) const
+{
+	for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+		if (typeFilter & 1 << i && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+			return i;
+		}
+	}
+	throw std::runtime_error("failed to find suitable memory type!");
+}
+
+bool MemoryAllocator::HasMemoryType(MemoryPropertyFlags properties) const
+{
+	for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+		if ((memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) return true;
+	}
+	return false;
+}
+
+bool MemoryAllocator::Conflicts(DeviceSize endOfPrevious, ResourceKind previous, DeviceSize startOfNext, ResourceKind next) const
+{
+	if (granularity <= 1 || previous == next || endOfPrevious == 0) return false;
+	return (endOfPrevious - 1) / granularity == startOfNext / granularity;
+}
+
+MemoryBlock* MemoryAllocator::CreateBlock(uint32_t memoryType, DeviceSize size, AllocationStrategy strategy)
+{
+	if (maxAllocationCount != 0 && deviceAllocations + 1 >= maxAllocationCount) {
+		Log("device memory allocation count %u is at maxMemoryAllocationCount %u", deviceAllocations + 1, maxAllocationCount);
+	}
+	auto block = std::make_unique<MemoryBlock>();
+	block->size = size;
+	block->memoryType = memoryType;
+	block->strategy = strategy;
+	MemoryAllocateInfo allocInfo{};
+	allocInfo.sType = StructureType::eMemoryAllocateInfo;
+	allocInfo.allocationSize = size;
+	allocInfo.memoryTypeIndex = memoryType;
+	if (device.allocateMemory(&allocInfo, nullptr, &block->memory) != Result::eSuccess) throw std::runtime_error("failed to allocate device memory!");
+	deviceAllocations++;
+	if (memoryProperties.memoryTypes[memoryType].propertyFlags & MemoryPropertyFlagBits::eHostVisible) {
+		block->mapped = static_cast<uint8_t*>(device.mapMemory(block->memory, 0, size));
+	}
+	if (strategy == AllocationStrategy::FreeList) {
+		block->chunks.emplace(0, MemoryBlock::Chunk{ size, false, ResourceKind::Linear });
+	}
+	blocks.push_back(std::move(block));
+	return blocks.back().get();
+}
+
+void MemoryAllocator::DestroyBlock(MemoryBlock* block)
+{
+	if (block->mapped != nullptr) device.unmapMemory(block->memory);
+	device.freeMemory(block->memory, nullptr);
+	deviceAllocations--;
+	blocks.erase(std::find_if(blocks.begin(), blocks.end(), [&](const std::unique_ptr<MemoryBlock>& b) { return b.get() == block; }));
+}
+
+bool MemoryAllocator::AllocateFromFreeList(MemoryBlock& block, const MemoryRequirements& requirements, ResourceKind kind, Allocation& allocation)
+{
+	auto best = block.chunks.end();
+	DeviceSize bestOffset = 0, bestEnd = 0, bestWaste = ~0ull;
+	for (auto it = block.chunks.begin(); it != block.chunks.end(); ++it) {
+		if (it->second.used) continue;
+		auto chunkEnd = it->first + it->second.size;
+		auto offset = AlignUp(it->first, requirements.alignment);
+		if (it != block.chunks.begin()) {
+			auto& previous = std::prev(it)->second;
+			if (Conflicts(it->first, previous.kind, offset, kind)) offset = AlignUp(offset, granularity);
+		}
+		auto end = offset + requirements.size;
+		if (end > chunkEnd) continue;
+		auto next = std::next(it);
+		if (next != block.chunks.end() && Conflicts(end, kind, next->first, next->second.kind)) continue;
+		if (chunkEnd - end < bestWaste) {
+			best = it;
+			bestOffset = offset;
+			bestEnd = end;
+			bestWaste = chunkEnd - end;
+		}
+	}
+	if (best == block.chunks.end()) return false;
+	// Alignment padding stays inside the used chunk so neighbouring free ranges are always coalescible.
+	auto chunkEnd = best->first + best->second.size;
+	best->second.size = bestEnd - best->first;
+	best->second.used = true;
+	best->second.kind = kind;
+	if (bestEnd < chunkEnd) block.chunks.emplace(bestEnd, MemoryBlock::Chunk{ chunkEnd - bestEnd, false, ResourceKind::Linear });
+	allocation.offset = bestOffset;
+	return true;
+}
+
+bool MemoryAllocator::AllocateFromLinear(MemoryBlock& block, const MemoryRequirements& requirements, ResourceKind kind, Allocation& allocation)
+{
+	auto offset = AlignUp(block.head, requirements.alignment);
+	if (block.allocations > 0 && Conflicts(block.head, block.lastKind, offset, kind)) offset = AlignUp(offset, granularity);
+	if (offset + requirements.size > block.size) return false;
+	block.head = offset + requirements.size;
+	block.lastKind = kind;
+	allocation.offset = offset;
+	return true;
+}
+
+Allocation MemoryAllocator::Allocate(const MemoryRequirements& requirements, MemoryPropertyFlags properties, ResourceKind kind, AllocationStrategy strategy)
+{
+	Allocation allocation{};
+	auto memoryType = FindMemoryType(requirements.memoryTypeBits, properties);
+	auto tryBlock = [&](MemoryBlock& block) {
+		return block.strategy == AllocationStrategy::Linear ? AllocateFromLinear(block, requirements, kind, allocation) : AllocateFromFreeList(block, requirements, kind, allocation);
+	};
+	MemoryBlock* target = nullptr;
+	if (requirements.size > blockSize / 2) {
+		target = CreateBlock(memoryType, requirements.size, AllocationStrategy::FreeList);
+		target->dedicated = true;
+		tryBlock(*target);
+	}
+	else {
+		for (auto& block : blocks) {
+			if (block->memoryType == memoryType && block->strategy == strategy && !block->dedicated && tryBlock(*block)) {
+				target = block.get();
+				break;
+			}
+		}
+		if (target == nullptr) {
+			target = CreateBlock(memoryType, blockSize, strategy);
+			if (!tryBlock(*target)) throw std::runtime_error("allocation does not fit in a fresh block!");
+		}
+	}
+	target->allocations++;
+	target->usedBytes += requirements.size;
+	allocation.memory = target->memory;
+	allocation.size = requirements.size;
+	allocation.memoryType = memoryType;
+	allocation.block = target;
+	allocation.mapped = target->mapped != nullptr ? target->mapped + allocation.offset : nullptr;
+	return allocation;
+}
+
+Allocation MemoryAllocator::AllocateBuffer(Buffer buffer, MemoryPropertyFlags properties, AllocationStrategy strategy)
+{
+	MemoryRequirements requirements;
+	device.getBufferMemoryRequirements(buffer, &requirements);
+	auto allocation = Allocate(requirements, properties, ResourceKind::Linear, strategy);
+	device.bindBufferMemory(buffer, allocation.memory, allocation.offset);
+	return allocation;
+}
+
+Allocation MemoryAllocator::AllocateImage(Image image, MemoryPropertyFlags properties, ImageTiling tiling, AllocationStrategy strategy)
+{
+	MemoryRequirements requirements;
+	device.getImageMemoryRequirements(image, &requirements);
+	auto allocation = Allocate(requirements, properties, tiling == ImageTiling::eOptimal ? ResourceKind::Optimal : ResourceKind::Linear, strategy);
+	device.bindImageMemory(image, allocation.memory, allocation.offset);
+	return allocation;
+}
+
+void MemoryAllocator::Free(Allocation& allocation)
+{
+	auto block = allocation.block;
+	if (block == nullptr) return;
+	block->allocations--;
+	block->usedBytes -= allocation.size;
+	if (block->strategy == AllocationStrategy::Linear) {
+		if (block->allocations == 0) block->head = 0;
+	}
+	else {
+		auto it = std::prev(block->chunks.upper_bound(allocation.offset));
+		it->second.used = false;
+		auto next = std::next(it);
+		if (next != block->chunks.end() && !next->second.used) {
+			it->second.size += next->second.size;
+			block->chunks.erase(next);
+		}
+		if (it != block->chunks.begin()) {
+			auto previous = std::prev(it);
+			if (!previous->second.used) {
+				previous->second.size += it->second.size;
+				block->chunks.erase(it);
+			}
+		}
+	}
+	allocation = {};
+	if (block->allocations > 0) return;
+	// Keep one empty block per type and strategy around so a free/allocate cycle does not hit vkAllocateMemory.
+	bool spare = std::any_of(blocks.begin(), blocks.end(), [&](const std::unique_ptr<MemoryBlock>& b) {
+		return b.get() != block && !b->dedicated && b->allocations == 0 && b->memoryType == block->memoryType && b->strategy == block->strategy;
+	});
+	if (block->dedicated || spare) DestroyBlock(block);
+}
+
+MemoryStats MemoryAllocator::Stats() const
+{
+	MemoryStats stats;
+	stats.heaps.resize(memoryProperties.memoryHeapCount);
+	stats.deviceAllocations = deviceAllocations;
+	DeviceSize totalFree = 0, largestFree = 0;
+	for (auto& block : blocks) {
+		auto& heap = stats.heaps[memoryProperties.memoryTypes[block->memoryType].heapIndex];
+		heap.blocks++;
+		heap.allocations += block->allocations;
+		heap.reservedBytes += block->size;
+		heap.usedBytes += block->usedBytes;
+		if (block->strategy == AllocationStrategy::FreeList) {
+			for (auto& chunk : block->chunks) {
+				if (chunk.second.used) continue;
+				totalFree += chunk.second.size;
+				largestFree = std::max(largestFree, chunk.second.size);
+			}
+		}
+	}
+	for (auto& heap : stats.heaps) {
+		stats.allocations += heap.allocations;
+		stats.reservedBytes += heap.reservedBytes;
+		stats.usedBytes += heap.usedBytes;
+	}
+	stats.fragmentation = totalFree > 0 ? 1.0 - (double)largestFree / totalFree : 0.0;
+	return stats;
+}
+
+void MemoryAllocator::LogStats() const
+{
+	auto stats = Stats();
+	Log("device memory: %u allocations in %u device allocations, %llu/%llu bytes used, fragmentation %.3f", stats.allocations, stats.deviceAllocations,
+		(unsigned long long)stats.usedBytes, (unsigned long long)stats.reservedBytes, stats.fragmentation);
+	for (size_t i = 0; i < stats.heaps.size(); i++) {
+		auto& heap = stats.heaps[i];
+		if (heap.blocks == 0) continue;
+		Log("  heap %zu: %u blocks, %u allocations, %llu/%llu bytes used", i, heap.blocks, heap.allocations,
+			(unsigned long long)heap.usedBytes, (unsigned long long)heap.reservedBytes);
+	}
+}
@@ -0,0 +1,101 @@
+#pragma once
+#include "Dispatch.h"
+#include <map>
+#include <memory>
+#include <vector>
+
+enum class AllocationStrategy {
+	// Best-fit over a free list; allocations can be released in any order.
+	FreeList,
+	// Bump allocation; a block's space is only reclaimed once every allocation in it is freed.
+	Linear
+};
+
+// Which side of bufferImageGranularity a sub-allocation falls on.
+enum class ResourceKind : uint8_t {
+	Linear,
+	Optimal
+};
+
+struct MemoryBlock;
+
+struct Allocation {
+	vk::DeviceMemory memory;
+	vk::DeviceSize offset = 0;
+	vk::DeviceSize size = 0;
+	// Host pointer to offset when the memory type is host visible; blocks stay mapped for their whole lifetime.
+	void* mapped = nullptr;
+	uint32_t memoryType = UINT32_MAX;
+	MemoryBlock* block = nullptr;
+	explicit operator bool() const { return block != nullptr; }
+};
+
+struct MemoryHeapStats {
+	uint32_t blocks = 0;
+	uint32_t allocations = 0;
+	vk::DeviceSize reservedBytes = 0;
+	vk::DeviceSize usedBytes = 0;
+};
+
+struct MemoryStats {
+	std::vector<MemoryHeapStats> heaps;
+	uint32_t deviceAllocations = 0;
+	uint32_t allocations = 0;
+	vk::DeviceSize reservedBytes = 0;
+	vk::DeviceSize usedBytes = 0;
+	// 1 - largest free range / total free bytes across free-list blocks; 0 means all free space is contiguous.
+	double fragmentation = 0;
+};
+
+struct MemoryBlock {
+	struct Chunk {
+		vk::DeviceSize size;
+		bool used;
+		ResourceKind kind;
+	};
+	vk::DeviceMemory memory;
+	vk::DeviceSize size = 0;
+	uint32_t memoryType = 0;
+	AllocationStrategy strategy = AllocationStrategy::FreeList;
+	// Sized for a single oversized resource and released as soon as it is freed.
+	bool dedicated = false;
+	uint8_t* mapped = nullptr;
+	uint32_t allocations = 0;
+	vk::DeviceSize usedBytes = 0;
+	// Free-list blocks: every byte of the block is covered by exactly one chunk, keyed by offset.
+	std::map<vk::DeviceSize, Chunk> chunks;
+	// Linear blocks: first unused byte and the kind of the last allocation placed.
+	vk::DeviceSize head = 0;
+	ResourceKind lastKind = ResourceKind::Linear;
+};
+
+// Carves buffers and images out of large per-memory-type blocks instead of one vkAllocateMemory per resource.
+class MemoryAllocator
+{
+	vk::Device device;
+	vk::PhysicalDeviceMemoryProperties memoryProperties;
+	vk::DeviceSize blockSize = 0;
+	vk::DeviceSize granularity = 1;
+	uint32_t maxAllocationCount = 0;
+	uint32_t deviceAllocations = 0;
+	std::vector<std::unique_ptr<MemoryBlock>> blocks;
+
+	MemoryBlock* CreateBlock(uint32_t memoryType, vk::DeviceSize size, AllocationStrategy strategy);
+	void DestroyBlock(MemoryBlock* block);
+	bool AllocateFromFreeList(MemoryBlock& block, const vk::MemoryRequirements& requirements, ResourceKind kind, Allocation& allocation);
+	bool AllocateFromLinear(MemoryBlock& block, const vk::MemoryRequirements& requirements, ResourceKind kind, Allocation& allocation);
+	bool Conflicts(vk::DeviceSize endOfPrevious, ResourceKind previous, vk::DeviceSize startOfNext, ResourceKind next) const;
+public:
+	void Create(vk::PhysicalDevice physicalDevice, vk::Device device, vk::DeviceSize blockSize = 64ull << 20);
+	void Destroy();
+	uint32_t FindMemoryType(uint32_t typeFilter, vk::MemoryPropertyFlags properties) const;
+	// Whether any memory type has all of properties, to pick between preferred and fallback properties.
+	bool HasMemoryType(vk::MemoryPropertyFlags properties) const;
+	Allocation Allocate(const vk::MemoryRequirements& requirements, vk::MemoryPropertyFlags properties, ResourceKind kind, AllocationStrategy strategy = AllocationStrategy::FreeList);
+	// Allocates memory for the resource and binds it.
+	Allocation AllocateBuffer(vk::Buffer buffer, vk::MemoryPropertyFlags properties, AllocationStrategy strategy = AllocationStrategy::FreeList);
+	Allocation AllocateImage(vk::Image image, vk::MemoryPropertyFlags properties, vk::ImageTiling tiling = vk::ImageTiling::eOptimal, AllocationStrategy strategy = AllocationStrategy::FreeList);
+	void Free(Allocation& allocation);
+	MemoryStats Stats() const;
+	void LogStats() const;
+};
@@ -0,0 +1,72 @@
+#include "MeshConverter.h"
+#include "VulkanApp.h"
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+MeshSource LoadObj(const std::string& path)
+{
+	std::ifstream file(path);
+	if (!file.is_open()) throw std::runtime_error("failed to open obj file!");
+	MeshSource mesh;
+	bool anyColor = false;
+	std::string line;
+	std::vector<uint32_t> face;
+	while (std::getline(file, line)) {
+		std::istringstream in(line);
+		std::string keyword;
+		in >> keyword;
+		if (keyword == "v") {
+			float p[3] = {};
+			float c[4] = { 1, 1, 1, 1 };
+			in >> p[0] >> p[1] >> p[2];
+			if (in >> c[0] >> c[1] >> c[2]) anyColor = true;
+			mesh.positions.insert(mesh.positions.end(), p, p + 3);
+			mesh.colors.insert(mesh.colors.end(), c, c + 4);
+		}
+		else if (keyword == "f") {
+			face.clear();
+			std::string corner;
+			while (in >> corner) {
+				// "v", "v/vt", "v//vn" or "v/vt/vn"; only the position index matters. Negative indices count from the end.
+				long index = std::stol(corner.substr(0, corner.find('/')));
+				long count = (long)(mesh.positions.size() / 3);
+				index = index < 0 ? count + index : index - 1;
+				if (index < 0 || index >= count) throw std::runtime_error("obj face references a missing vertex");
+				face.push_back((uint32_t)index);
+			}
+			for (size_t i = 2; i < face.size(); i++) mesh.indices.insert(mesh.indices.end(), { face[0], face[i - 1], face[i] });
+		}
+	}
+	if (!anyColor) mesh.colors.clear();
+	return mesh;
+}
+
+int RunMeshConverter(int argc, char** argv)
+{
+	std::vector<std::string> paths;
+	uint32_t trianglesPerChunk = 16384;
+	auto format = MeshVertexFormat::PositionColorPacked;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--convert-mesh") continue;
+		if (arg == "--chunk-triangles" && i + 1 < argc) trianglesPerChunk = (uint32_t)std::stoul(argv[++i]);
+		else if (arg == "--float") format = MeshVertexFormat::PositionColorF32;
+		else if (arg.compare(0, 2, "--") != 0) paths.push_back(arg);
+	}
+	if (paths.size() != 2) {
+		fprintf(stderr, "usage: --convert-mesh <input.obj|grid:N> <output.mesh> [--chunk-triangles N] [--float]\n");
+		return 1;
+	}
+	auto start = std::chrono::steady_clock::now();
+	MeshSource source = paths[0].compare(0, 5, "grid:") == 0 ? VulkanApp::GenerateTriangles((uint32_t)std::stoul(paths[0].substr(5))) : LoadObj(paths[0]);
+	WriteMeshFile(paths[1], source, trianglesPerChunk, format);
+	MeshFile mesh;
+	mesh.Open(paths[1]);
+	auto& header = mesh.Header();
+	printf("%s: %u vertices, %u triangles in %u chunks, %zu bytes (%.1fms)\n", paths[1].c_str(), header.vertexCount, header.indexCount / 3, header.chunkCount,
+		mesh.SizeBytes(), std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+	return 0;
+}
@@ -0,0 +1,8 @@
+#pragma once
+#include "MeshFile.h"
+
+// Reads positions, optional per-vertex colors ("v x y z r g b") and faces from a Wavefront OBJ; polygons are fanned
+// into triangles and every other statement is ignored.
+MeshSource LoadObj(const std::string& path);
+// --convert-mesh <input.obj|grid:N> <output.mesh> [--chunk-triangles N] [--float]
+int RunMeshConverter(int argc, char** argv);
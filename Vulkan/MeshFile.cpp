@@ -0,0 +1,301 @@
+#include "MeshFile.h"
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+	constexpr uint32_t MeshMagic = 0x4853454D; // "MESH"
+	constexpr uint32_t MeshVersion = 1;
+	constexpr uint64_t StreamAlignment = 16;
+
+	uint64_t Align(uint64_t offset)
+	{
+		return (offset + StreamAlignment - 1) / StreamAlignment * StreamAlignment;
+	}
+}
+
+static_assert(sizeof(MeshFileHeader) == 80, "mesh header layout is part of the file format");
+static_assert(sizeof(MeshChunk) == 40, "mesh chunk layout is part of the file format");
+
+static_assert(sizeof(VertexF32) == 28 && sizeof(Vertex) == 12, "vertex layouts are part of the file format");
+
+namespace {
+	Vertex PackVertex(const MeshSource& source, uint32_t index, const PositionQuantization& quantization)
+	{
+		Vertex vertex{};
+		for (int axis = 0; axis < 3; axis++) {
+			vertex.pos.v[axis] = ToSnorm16((source.positions[(size_t)index * 3 + axis] - quantization.center[axis]) / quantization.scale);
+		}
+		for (int channel = 0; channel < 4; channel++) {
+			vertex.color.v[channel] = source.colors.empty() ? 255 : ToUnorm8(source.colors[(size_t)index * 4 + channel]);
+		}
+		return vertex;
+	}
+
+	VertexF32 CopyVertex(const MeshSource& source, uint32_t index)
+	{
+		VertexF32 vertex{ {}, { 1, 1, 1, 1 } };
+		std::copy_n(&source.positions[(size_t)index * 3], 3, vertex.pos);
+		if (!source.colors.empty()) std::copy_n(&source.colors[(size_t)index * 4], 4, vertex.color);
+		return vertex;
+	}
+}
+
+void MeshBounds(const MeshSource& source, float boundsMin[3], float boundsMax[3])
+{
+	for (int axis = 0; axis < 3; axis++) {
+		boundsMin[axis] = source.positions.empty() ? 0 : source.positions[axis];
+		boundsMax[axis] = boundsMin[axis];
+	}
+	for (size_t i = 0; i < source.positions.size(); i += 3) {
+		for (int axis = 0; axis < 3; axis++) {
+			boundsMin[axis] = std::min(boundsMin[axis], source.positions[i + axis]);
+			boundsMax[axis] = std::max(boundsMax[axis], source.positions[i + axis]);
+		}
+	}
+}
+
+PositionQuantization PositionQuantization::FromBounds(const float boundsMin[3], const float boundsMax[3])
+{
+	PositionQuantization result;
+	result.scale = 0;
+	for (int axis = 0; axis < 3; axis++) {
+		result.center[axis] = (boundsMin[axis] + boundsMax[axis]) * 0.5f;
+		result.scale = std::max(result.scale, (boundsMax[axis] - boundsMin[axis]) * 0.5f);
+	}
+	if (result.scale == 0) result.scale = 1;
+	return result;
+}
+
+std::vector<Vertex> PackVertices(const MeshSource& source, const PositionQuantization& quantization)
+{
+	std::vector<Vertex> result(source.positions.size() / 3);
+	for (uint32_t i = 0; i < result.size(); i++) result[i] = PackVertex(source, i, quantization);
+	return result;
+}
+
+bool MappedFile::Open(const std::string& path)
+{
+	Close();
+#ifdef _WIN32
+	HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (handle == INVALID_HANDLE_VALUE) return false;
+	file = handle;
+	LARGE_INTEGER fileSize{};
+	if (!GetFileSizeEx(handle, &fileSize) || fileSize.QuadPart == 0) {
+		Close();
+		return false;
+	}
+	mapping = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping == nullptr) {
+		Close();
+		return false;
+	}
+	data = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+	if (data == nullptr) {
+		Close();
+		return false;
+	}
+	size = (size_t)fileSize.QuadPart;
+#else
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) return false;
+	struct stat info {};
+	if (fstat(fd, &info) != 0 || info.st_size == 0) {
+		close(fd);
+		return false;
+	}
+	void* view = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	// The mapping keeps the file referenced on its own.
+	close(fd);
+	if (view == MAP_FAILED) return false;
+	madvise(view, (size_t)info.st_size, MADV_SEQUENTIAL);
+	data = static_cast<const uint8_t*>(view);
+	size = (size_t)info.st_size;
+#endif
+	return true;
+}
+
+void MappedFile::Close()
+{
+#ifdef _WIN32
+	if (data) UnmapViewOfFile(data);
+	if (mapping) CloseHandle(mapping);
+	if (file) CloseHandle(file);
+	mapping = nullptr;
+	file = nullptr;
+#else
+	if (data) munmap(const_cast<uint8_t*>(data), size);
+#endif
+	data = nullptr;
+	size = 0;
+}
+
+void MappedFile::Prefetch(size_t offset, size_t length) const
+{
+	if (offset >= size) return;
+	length = std::min(length, size - offset);
+#ifdef _WIN32
+	WIN32_MEMORY_RANGE_ENTRY range{};
+	range.VirtualAddress = const_cast<uint8_t*>(data + offset);
+	range.NumberOfBytes = length;
+	PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#else
+	// madvise wants a page-aligned start.
+	size_t page = (size_t)sysconf(_SC_PAGESIZE);
+	size_t start = offset / page * page;
+	madvise(const_cast<uint8_t*>(data + start), length + offset - start, MADV_WILLNEED);
+#endif
+}
+
+void MeshFile::Open(const std::string& path)
+{
+	Close();
+	if (!file.Open(path)) throw std::runtime_error("failed to open mesh file!");
+	auto size = (uint64_t)file.Size();
+	auto candidate = reinterpret_cast<const MeshFileHeader*>(file.Data());
+	const char* reason = nullptr;
+	if (size < sizeof(MeshFileHeader)) reason = "truncated header";
+	else if (candidate->magic != MeshMagic || candidate->version != MeshVersion) reason = "unknown format";
+	else if (MeshVertexStride(candidate->vertexFormat) == 0 || candidate->vertexStride != MeshVertexStride(candidate->vertexFormat)) reason = "unknown vertex format";
+	// WriteMeshFile starts every stream at StreamAlignment; anything else was not written by it.
+	else if (candidate->chunkOffset % StreamAlignment != 0 || candidate->vertexOffset % StreamAlignment != 0 || candidate->indexOffset % StreamAlignment != 0) reason = "misaligned stream";
+	// Offsets are compared before they are added to, so a huge one cannot wrap past the size check.
+	else if (candidate->chunkOffset > size || (uint64_t)candidate->chunkCount * sizeof(MeshChunk) > size - candidate->chunkOffset) reason = "truncated chunk table";
+	else if (candidate->vertexOffset > size || (uint64_t)candidate->vertexCount * candidate->vertexStride > size - candidate->vertexOffset) reason = "truncated vertex stream";
+	else if (candidate->indexOffset > size || (uint64_t)candidate->indexCount * sizeof(uint32_t) > size - candidate->indexOffset) reason = "truncated index stream";
+	if (reason == nullptr) {
+		// Streaming draws the loaded prefix of the index stream, so chunks must tile both streams in order.
+		auto table = reinterpret_cast<const MeshChunk*>(file.Data() + candidate->chunkOffset);
+		// 64-bit, so counts summing past 2^32 are caught instead of wrapping around to the header's totals.
+		uint64_t nextIndex = 0;
+		uint64_t nextVertex = 0;
+		for (uint32_t i = 0; i < candidate->chunkCount && reason == nullptr; i++) {
+			if (table[i].firstIndex != nextIndex || table[i].firstVertex != nextVertex || table[i].indexCount % 3 != 0) reason = "chunks out of order";
+			nextIndex += table[i].indexCount;
+			nextVertex += table[i].vertexCount;
+		}
+		if (reason == nullptr && (nextIndex != candidate->indexCount || nextVertex != candidate->vertexCount)) reason = "chunks do not cover the mesh";
+	}
+	if (reason != nullptr) {
+		file.Close();
+		throw std::runtime_error(std::string("invalid mesh file: ") + reason);
+	}
+	header = candidate;
+	chunks = reinterpret_cast<const MeshChunk*>(file.Data() + header->chunkOffset);
+}
+
+void MeshFile::Close()
+{
+	file.Close();
+	header = nullptr;
+	chunks = nullptr;
+}
+
+bool MeshFile::ValidateChunk(uint32_t index) const
+{
+	auto& chunk = chunks[index];
+	uint64_t limit = (uint64_t)chunk.firstVertex + chunk.vertexCount;
+	auto indices = Indices() + chunk.firstIndex;
+	return std::all_of(indices, indices + chunk.indexCount, [&](uint32_t i) { return i < limit; });
+}
+
+void MeshFile::Prefetch(uint32_t index) const
+{
+	auto& chunk = chunks[index];
+	file.Prefetch((size_t)(header->vertexOffset + (uint64_t)chunk.firstVertex * header->vertexStride), (size_t)chunk.vertexCount * header->vertexStride);
+	file.Prefetch((size_t)(header->indexOffset + (uint64_t)chunk.firstIndex * sizeof(uint32_t)), (size_t)chunk.indexCount * sizeof(uint32_t));
+}
+
+void WriteMeshFile(const std::string& path, const MeshSource& source, uint32_t trianglesPerChunk, MeshVertexFormat format)
+{
+	uint32_t sourceVertices = (uint32_t)(source.positions.size() / 3);
+	if (MeshVertexStride(format) == 0) throw std::runtime_error("unknown mesh vertex format");
+	if (source.indices.size() % 3 != 0) throw std::runtime_error("mesh index count is not a multiple of 3");
+	if (!source.colors.empty() && source.colors.size() != (size_t)sourceVertices * 4) throw std::runtime_error("mesh colors do not match positions");
+	for (auto index : source.indices) {
+		if (index >= sourceVertices) throw std::runtime_error("mesh index out of range");
+	}
+	trianglesPerChunk = std::max(1u, trianglesPerChunk);
+	// Renumber vertices in order of first use so each chunk only adds vertices after those of earlier chunks;
+	// vertices no triangle uses are dropped.
+	std::vector<uint32_t> remap(sourceVertices, UINT32_MAX);
+	std::vector<uint32_t> order;
+	order.reserve(sourceVertices);
+	std::vector<uint32_t> indices(source.indices.size());
+	std::vector<MeshChunk> chunks;
+	MeshFileHeader header{};
+	uint32_t chunkIndices = trianglesPerChunk * 3;
+	for (size_t first = 0; first < source.indices.size(); first += chunkIndices) {
+		MeshChunk chunk{};
+		chunk.firstIndex = (uint32_t)first;
+		chunk.indexCount = (uint32_t)std::min<size_t>(chunkIndices, source.indices.size() - first);
+		chunk.firstVertex = (uint32_t)order.size();
+		for (int axis = 0; axis < 3; axis++) {
+			chunk.boundsMin[axis] = source.positions[source.indices[first] * 3 + axis];
+			chunk.boundsMax[axis] = chunk.boundsMin[axis];
+		}
+		for (size_t i = first; i < first + chunk.indexCount; i++) {
+			auto vertex = source.indices[i];
+			if (remap[vertex] == UINT32_MAX) {
+				remap[vertex] = (uint32_t)order.size();
+				order.push_back(vertex);
+			}
+			indices[i] = remap[vertex];
+			for (int axis = 0; axis < 3; axis++) {
+				chunk.boundsMin[axis] = std::min(chunk.boundsMin[axis], source.positions[vertex * 3 + axis]);
+				chunk.boundsMax[axis] = std::max(chunk.boundsMax[axis], source.positions[vertex * 3 + axis]);
+			}
+		}
+		chunk.vertexCount = (uint32_t)order.size() - chunk.firstVertex;
+		for (int axis = 0; axis < 3; axis++) {
+			header.boundsMin[axis] = chunks.empty() ? chunk.boundsMin[axis] : std::min(header.boundsMin[axis], chunk.boundsMin[axis]);
+			header.boundsMax[axis] = chunks.empty() ? chunk.boundsMax[axis] : std::max(header.boundsMax[axis], chunk.boundsMax[axis]);
+		}
+		chunks.push_back(chunk);
+	}
+	header.magic = MeshMagic;
+	header.version = MeshVersion;
+	header.vertexFormat = format;
+	header.vertexStride = MeshVertexStride(header.vertexFormat);
+	header.vertexCount = (uint32_t)order.size();
+	header.indexCount = (uint32_t)indices.size();
+	header.chunkCount = (uint32_t)chunks.size();
+	header.chunkOffset = Align(sizeof(MeshFileHeader));
+	header.vertexOffset = Align(header.chunkOffset + sizeof(MeshChunk) * chunks.size());
+	header.indexOffset = Align(header.vertexOffset + (uint64_t)header.vertexStride * order.size());
+
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	if (!out.is_open()) throw std::runtime_error("failed to create mesh file!");
+	auto pad = [&](uint64_t offset) {
+		static const char zeros[StreamAlignment] = {};
+		out.write(zeros, (std::streamsize)(offset - (uint64_t)out.tellp()));
+	};
+	out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	pad(header.chunkOffset);
+	out.write(reinterpret_cast<const char*>(chunks.data()), (std::streamsize)(sizeof(MeshChunk) * chunks.size()));
+	pad(header.vertexOffset);
+	if (format == MeshVertexFormat::PositionColorPacked) {
+		auto quantization = PositionQuantization::FromBounds(header.boundsMin, header.boundsMax);
+		std::vector<Vertex> vertices(order.size());
+		for (size_t i = 0; i < order.size(); i++) vertices[i] = PackVertex(source, order[i], quantization);
+		out.write(reinterpret_cast<const char*>(vertices.data()), (std::streamsize)(sizeof(Vertex) * vertices.size()));
+	}
+	else {
+		std::vector<VertexF32> vertices(order.size());
+		for (size_t i = 0; i < order.size(); i++) vertices[i] = CopyVertex(source, order[i]);
+		out.write(reinterpret_cast<const char*>(vertices.data()), (std::streamsize)(sizeof(VertexF32) * vertices.size()));
+	}
+	pad(header.indexOffset);
+	out.write(reinterpret_cast<const char*>(indices.data()), (std::streamsize)(sizeof(uint32_t) * indices.size()));
+	if (!out.good()) throw std::runtime_error("failed to write mesh file!");
+}
@@ -0,0 +1,152 @@
+#pragma once
+#include "VertexFormat.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Full-precision vertex, 28 bytes.
+struct VertexF32 {
+	float pos[3];
+	float color[4];
+};
+
+// The default vertex, 12 bytes: the position quantized against the mesh bounds (see PositionQuantization)
+// and an 8-bit color.
+struct Vertex {
+	Snorm16x4 pos;
+	Unorm8x4 color;
+};
+
+template <> struct VertexAttributes<VertexF32> {
+	static constexpr std::array<VertexAttribute, 2> value = { VERTEX_ATTRIBUTE(VertexF32, pos, 0), VERTEX_ATTRIBUTE(VertexF32, color, 1) };
+};
+template <> struct VertexAttributes<Vertex> {
+	static constexpr std::array<VertexAttribute, 2> value = { VERTEX_ATTRIBUTE(Vertex, pos, 0), VERTEX_ATTRIBUTE(Vertex, color, 1) };
+};
+
+// Binary mesh container: a header, a chunk table, then the vertex and index streams, each 16-byte aligned.
+// Chunks partition the index stream in order, and vertices are stored in order of first use, so every chunk only
+// references vertices of itself and the chunks before it. Any prefix of chunks is therefore a drawable mesh.
+enum class MeshVertexFormat : uint32_t {
+	// VertexF32.
+	PositionColorF32 = 0,
+	// Vertex.
+	PositionColorPacked = 1
+};
+
+constexpr uint32_t MeshVertexStride(MeshVertexFormat format)
+{
+	switch (format)
+	{
+	case MeshVertexFormat::PositionColorF32: return sizeof(VertexF32);
+	case MeshVertexFormat::PositionColorPacked: return sizeof(Vertex);
+	default: return 0;
+	}
+}
+
+struct MeshFileHeader {
+	uint32_t magic;
+	uint32_t version;
+	MeshVertexFormat vertexFormat;
+	uint32_t vertexStride;
+	uint32_t vertexCount;
+	uint32_t indexCount;
+	uint32_t chunkCount;
+	uint32_t reserved;
+	// Byte offsets from the start of the file.
+	uint64_t chunkOffset;
+	uint64_t vertexOffset;
+	uint64_t indexOffset;
+	float boundsMin[3];
+	float boundsMax[3];
+};
+
+struct MeshChunk {
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	// Vertices introduced by this chunk; its indices are all below firstVertex + vertexCount.
+	uint32_t firstVertex;
+	uint32_t vertexCount;
+	float boundsMin[3];
+	float boundsMax[3];
+};
+
+// Read-only view of a whole file through the OS page cache; pages are faulted in as they are touched.
+class MappedFile
+{
+	const uint8_t* data = nullptr;
+	size_t size = 0;
+#ifdef _WIN32
+	void* file = nullptr;
+	void* mapping = nullptr;
+#endif
+public:
+	MappedFile() = default;
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	~MappedFile() { Close(); }
+	bool Open(const std::string& path);
+	void Close();
+	const uint8_t* Data() const { return data; }
+	size_t Size() const { return size; }
+	// Asks the OS to start reading a range ahead of its use.
+	void Prefetch(size_t offset, size_t length) const;
+};
+
+class MeshFile
+{
+	MappedFile file;
+	const MeshFileHeader* header = nullptr;
+	const MeshChunk* chunks = nullptr;
+public:
+	// Maps path and validates the header and chunk table; throws when the file is missing or malformed.
+	void Open(const std::string& path);
+	void Close();
+	bool IsOpen() const { return header != nullptr; }
+	size_t SizeBytes() const { return file.Size(); }
+	const MeshFileHeader& Header() const { return *header; }
+	const MeshChunk& Chunk(uint32_t index) const { return chunks[index]; }
+	const uint8_t* Vertices() const { return file.Data() + header->vertexOffset; }
+	const uint32_t* Indices() const { return reinterpret_cast<const uint32_t*>(file.Data() + header->indexOffset); }
+	// Scans the chunk's indices; Open only checks the tables so that loading never walks the whole file up front.
+	bool ValidateChunk(uint32_t index) const;
+	void Prefetch(uint32_t index) const;
+};
+
+// Uncompressed geometry as it comes out of an importer or generator.
+struct MeshSource {
+	// xyz per vertex.
+	std::vector<float> positions;
+	// rgba per vertex.
+	std::vector<float> colors;
+	std::vector<uint32_t> indices;
+};
+
+// Axis-aligned bounds of the source positions; all zero for an empty source.
+void MeshBounds(const MeshSource& source, float boundsMin[3], float boundsMax[3]);
+
+// Maps positions inside a bounding box onto [-1, 1] with one uniform scale: position = center + scale * quantized.
+// The inverse is folded into the instance transform, so shaders read quantized positions as they are.
+struct PositionQuantization {
+	float center[3] = { 0, 0, 0 };
+	float scale = 1;
+
+	static PositionQuantization FromBounds(const float boundsMin[3], const float boundsMax[3]);
+};
+
+std::vector<Vertex> PackVertices(const MeshSource& source, const PositionQuantization& quantization);
+
+// Writes source as a mesh file split into chunks of trianglesPerChunk triangles; throws on I/O errors.
+// Packed files quantize positions against the bounds stored in the header.
+void WriteMeshFile(const std::string& path, const MeshSource& source, uint32_t trianglesPerChunk = 16384, MeshVertexFormat format = MeshVertexFormat::PositionColorPacked);
+
+// Load-time milestones in milliseconds since the mesh file was opened.
+struct MeshLoadStats {
+	uint64_t bytes = 0;
+	double open = 0;
+	double firstChunk = 0;
+	double resident = 0;
+	// Frames drawn before every chunk was submitted.
+	uint32_t residentFrames = 0;
+};
@@ -0,0 +1,125 @@
+#include "Particles.h"
+#include "Trace.h"
+#ifdef _DEBUG
+#include <cassert>
+#else
+#define assert(X) (void)(X)
+#endif
+
+#include <algorithm>
+
+using namespace vk;
+
+// Workgroup size of particles.hlsl.
+static constexpr uint32_t GroupSize = 256;
+// Bytes per particle of the state buffer: position and velocity.
+static constexpr DeviceSize StateStride = 32;
+// InstanceData in VulkanApp.h.
+static constexpr DeviceSize InstanceStride = 32;
+
+void ParticleSystem::Create(Device device, vk::PipelineCache cache, DeletionQueue& deletions, BindlessTable& bindless, ComputeQueue& queue, uint32_t count,
+	bool overlap, const PositionQuantization& quantization, float size)
+{
+	this->queue = &queue;
+	this->bindless = &bindless;
+	// The smallest maxComputeWorkGroupCount every device supports bounds a one-dimensional dispatch.
+	this->count = std::min(count, 65535u * GroupSize);
+	this->overlap = overlap;
+	this->size = size;
+	fold[0] = quantization.center[0];
+	fold[1] = quantization.center[1];
+	fold[2] = quantization.center[2];
+	fold[3] = quantization.scale;
+	pipeline.Create(device, cache, bindless.Layout(), sizeof(ParticleConstants), EmbeddedParticleShader());
+	// Exclusive to one family at a time: the state never leaves the compute queue, and the outputs are handed to
+	// graphics explicitly.
+	BufferCreateInfo bufferInfo{};
+	bufferInfo.sType = StructureType::eBufferCreateInfo;
+	bufferInfo.size = StateStride * this->count;
+	bufferInfo.usage = BufferUsageFlagBits::eStorageBuffer;
+	bufferInfo.sharingMode = SharingMode::eExclusive;
+	state = deletions.CreateBuffer(bufferInfo, MemoryPropertyFlagBits::eDeviceLocal);
+	stateSlot = bindless.AddBuffer(state.Get());
+	bufferInfo.size = InstanceStride * this->count;
+	for (uint32_t i = 0; i < OutputCount; i++) {
+		outputs[i] = deletions.CreateBuffer(bufferInfo, MemoryPropertyFlagBits::eDeviceLocal);
+		outputSlots[i] = bindless.AddBuffer(outputs[i].Get());
+	}
+}
+
+void ParticleSystem::Destroy()
+{
+	if (!state) return;
+	pipeline.Destroy();
+	bindless->RemoveBuffer(stateSlot);
+	for (auto slot : outputSlots) bindless->RemoveBuffer(slot);
+	state.Reset();
+	for (auto& output : outputs) output.Reset();
+}
+
+void ParticleSystem::Simulate(uint32_t slot, uint64_t value, Semaphore graphicsTimeline)
+{
+	TraceScope trace("simulateParticles");
+	bool reset = firstValue == 0;
+	if (reset) firstValue = value;
+	auto now = std::chrono::steady_clock::now();
+	// Clamped so a stall does not fling the particles out of their orbits.
+	float dt = reset ? 0.0f : std::min(std::chrono::duration<float>(now - lastStep).count(), 1.0f / 30);
+	lastStep = now;
+	auto output = outputs[value % OutputCount].Get();
+	auto commandBuffer = queue->Begin(slot);
+	// Steps are separate submissions to the same queue, so the previous step's state writes need a barrier.
+	BufferMemoryBarrier stateBarrier{};
+	stateBarrier.sType = StructureType::eBufferMemoryBarrier;
+	stateBarrier.srcAccessMask = AccessFlagBits::eShaderWrite;
+	stateBarrier.dstAccessMask = AccessFlagBits::eShaderRead | AccessFlagBits::eShaderWrite;
+	stateBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	stateBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	stateBarrier.buffer = state.Get();
+	stateBarrier.size = VK_WHOLE_SIZE;
+	commandBuffer.pipelineBarrier(PipelineStageFlagBits::eComputeShader, PipelineStageFlagBits::eComputeShader, {}, 0, nullptr, 1, &stateBarrier, 0, nullptr);
+	ParticleConstants constants{};
+	constants.stateBuffer = stateSlot;
+	constants.instanceBuffer = outputSlots[value % OutputCount];
+	constants.count = count;
+	constants.reset = reset ? 1 : 0;
+	std::copy_n(fold, 4, constants.fold);
+	constants.size = size;
+	constants.dt = dt;
+	auto set = bindless->Set();
+	commandBuffer.bindPipeline(PipelineBindPoint::eCompute, pipeline.Handle());
+	commandBuffer.bindDescriptorSets(PipelineBindPoint::eCompute, pipeline.Layout(), 0, 1, &set, 0, nullptr);
+	commandBuffer.pushConstants(pipeline.Layout(), ShaderStageFlagBits::eCompute, 0, sizeof(constants), &constants);
+	commandBuffer.dispatch((count + GroupSize - 1) / GroupSize, 1, 1);
+	if (queue->Async()) {
+		// Released to the graphics family, which acquires it in Acquire() after waiting for this step.
+		BufferMemoryBarrier release{};
+		release.sType = StructureType::eBufferMemoryBarrier;
+		release.srcAccessMask = AccessFlagBits::eShaderWrite;
+		release.srcQueueFamilyIndex = queue->Family();
+		release.dstQueueFamilyIndex = queue->GraphicsFamily();
+		release.buffer = output;
+		release.size = VK_WHOLE_SIZE;
+		commandBuffer.pipelineBarrier(PipelineStageFlagBits::eComputeShader, PipelineStageFlagBits::eBottomOfPipe, {}, 0, nullptr, 1, &release, 0, nullptr);
+	}
+	// The output is overwritten whole, so it comes back from the graphics family without an ownership transfer;
+	// waiting for the last frame that drew its previous contents is enough.
+	uint64_t lastReader = value + (overlap ? 1 : 0) > OutputCount ? value + (overlap ? 1 : 0) - OutputCount : 0;
+	queue->Submit(slot, value, lastReader > 0 ? graphicsTimeline : Semaphore(), lastReader);
+}
+
+void ParticleSystem::Acquire(CommandBuffer commandBuffer, uint64_t value)
+{
+	auto drawn = DrawnValue(value);
+	if (!queue->Async() || drawn == acquired) return;
+	acquired = drawn;
+	BufferMemoryBarrier barrier{};
+	barrier.sType = StructureType::eBufferMemoryBarrier;
+	barrier.dstAccessMask = AccessFlagBits::eShaderRead;
+	barrier.srcQueueFamilyIndex = queue->Family();
+	barrier.dstQueueFamilyIndex = queue->GraphicsFamily();
+	barrier.buffer = outputs[drawn % OutputCount].Get();
+	barrier.size = VK_WHOLE_SIZE;
+	// Source stages match the semaphore wait stage so the acquire chains after the compute queue's release.
+	commandBuffer.pipelineBarrier(PipelineStageFlagBits::eVertexShader, PipelineStageFlagBits::eVertexShader, {}, 0, nullptr, 1, &barrier, 0, nullptr);
+}
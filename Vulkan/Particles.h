@@ -0,0 +1,63 @@
+#pragma once
+#include "ComputeQueue.h"
+#include "DeletionQueue.h"
+#include "Descriptors.h"
+#include "MeshFile.h"
+#include <array>
+#include <chrono>
+
+// Push constants of particles.hlsl.
+struct ParticleConstants {
+	uint32_t stateBuffer;
+	uint32_t instanceBuffer;
+	uint32_t count;
+	uint32_t reset;
+	// xyz: quantization center, w: quantization scale of the sprite the particles are drawn with.
+	float fold[4];
+	float size;
+	float dt;
+	float padding[2];
+};
+
+// A GPU particle simulation stepped once per frame on the compute queue, whose output is drawn as instances by the
+// scene pipeline. Each step writes one of OutputCount instance buffers; when overlapped, the frame signaling value
+// draws the step submitted with value - 1, so that step runs while the previous frame's graphics work does.
+// Serialized, every frame draws its own step and the graphics queue waits for the simulation to finish first.
+class ParticleSystem
+{
+	// A step's output is read by at most two frames, and the buffer it replaces must no longer be read by either.
+	static constexpr uint32_t OutputCount = 3;
+
+	ComputeQueue* queue = nullptr;
+	BindlessTable* bindless = nullptr;
+	ComputePipeline pipeline;
+	Owned<vk::Buffer> state;
+	std::array<Owned<vk::Buffer>, OutputCount> outputs;
+	uint32_t stateSlot = 0;
+	std::array<uint32_t, OutputCount> outputSlots{};
+	uint32_t count = 0;
+	bool overlap = true;
+	float fold[4] = {};
+	float size = 0;
+	// Value of the first step, which scatters the particles; every later frame may draw a step behind.
+	uint64_t firstValue = 0;
+	// Newest step whose output the graphics queue took ownership of.
+	uint64_t acquired = 0;
+	std::chrono::steady_clock::time_point lastStep;
+public:
+	void Create(vk::Device device, vk::PipelineCache cache, DeletionQueue& deletions, BindlessTable& bindless, ComputeQueue& queue, uint32_t count,
+		bool overlap, const PositionQuantization& quantization, float size);
+	void Destroy();
+	uint32_t Count() const { return count; }
+	bool Overlapped() const { return overlap; }
+	// The step the frame signaling value draws; the graphics queue waits for the compute timeline to reach it at the
+	// vertex shader stage.
+	uint64_t DrawnValue(uint64_t value) const { return overlap && value > firstValue ? value - 1 : value; }
+	// Bindless slot of the instances the frame signaling value draws.
+	uint32_t InstanceSlot(uint64_t value) const { return outputSlots[DrawnValue(value) % OutputCount]; }
+	// Records and submits the step for the frame signaling value on graphicsTimeline, on the queue's slot.
+	void Simulate(uint32_t slot, uint64_t value, vk::Semaphore graphicsTimeline);
+	// Records, into the frame's graphics command buffer, taking ownership of the instances it draws from the
+	// compute family. Does nothing when both are the same family, or the step was already acquired.
+	void Acquire(vk::CommandBuffer commandBuffer, uint64_t value);
+};
@@ -0,0 +1,131 @@
+#include "PipelineCache.h"
+#include "Log.h"
+#ifdef _DEBUG
+#include <cassert>
+#else
+#define assert(X) (void)(X)
+#endif
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+using namespace vk;
+
+namespace {
+	constexpr uint32_t CacheMagic = 0x43504B56; // "VKPC"
+	constexpr uint32_t CacheVersion = 1;
+
+	struct CacheFileHeader {
+		uint32_t magic;
+		uint32_t version;
+		uint32_t vendorID;
+		uint32_t deviceID;
+		uint32_t driverVersion;
+		uint8_t uuid[VK_UUID_SIZE];
+		uint64_t dataSize;
+		uint64_t checksum;
+	};
+
+	uint64_t Fnv1a(const uint8_t* data, size_t size)
+	{
+		uint64_t hash = 14695981039346656037ull;
+		for (size_t i = 0; i < size; i++) {
+			hash ^= data[i];
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+}
+
+void PipelineCache::Create(PhysicalDevice physicalDevice, Device device, const std::string& path)
+{
+	this->device = device;
+	this->path = path;
+	physicalDevice.getProperties(&properties);
+	std::vector<uint8_t> data;
+	if (!path.empty()) {
+		std::ifstream file(path, std::ios::ate | std::ios::binary);
+		if (file.is_open()) {
+			size_t fileSize = (size_t)file.tellg();
+			CacheFileHeader header{};
+			file.seekg(0);
+			const char* reason = nullptr;
+			if (fileSize < sizeof(header) || !file.read(reinterpret_cast<char*>(&header), sizeof(header))) reason = "truncated header";
+			else if (header.magic != CacheMagic || header.version != CacheVersion) reason = "unknown format";
+			else if (header.vendorID != properties.vendorID || header.deviceID != properties.deviceID) reason = "different device";
+			else if (header.driverVersion != properties.driverVersion) reason = "different driver version";
+			else if (memcmp(header.uuid, properties.pipelineCacheUUID.data(), VK_UUID_SIZE) != 0) reason = "different cache UUID";
+			else if (header.dataSize != fileSize - sizeof(header)) reason = "size mismatch";
+			else {
+				data.resize((size_t)header.dataSize);
+				if (!file.read(reinterpret_cast<char*>(data.data()), data.size())) reason = "short read";
+				else if (Fnv1a(data.data(), data.size()) != header.checksum) reason = "checksum mismatch";
+			}
+			// The driver's own header must agree too; some drivers crash on foreign blobs instead of rejecting them.
+			if (reason == nullptr) {
+				VkPipelineCacheHeaderVersionOne vkHeader{};
+				if (data.size() < sizeof(vkHeader)) reason = "truncated driver header";
+				else {
+					memcpy(&vkHeader, data.data(), sizeof(vkHeader));
+					if (vkHeader.headerSize < sizeof(vkHeader) || vkHeader.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE ||
+						vkHeader.vendorID != properties.vendorID || vkHeader.deviceID != properties.deviceID ||
+						memcmp(vkHeader.pipelineCacheUUID, properties.pipelineCacheUUID.data(), VK_UUID_SIZE) != 0) reason = "driver header mismatch";
+				}
+			}
+			if (reason != nullptr) {
+				Log("pipeline cache %s ignored: %s", path.c_str(), reason);
+				data.clear();
+			}
+		}
+	}
+	PipelineCacheCreateInfo createInfo{};
+	createInfo.sType = StructureType::ePipelineCacheCreateInfo;
+	createInfo.initialDataSize = data.size();
+	createInfo.pInitialData = data.empty() ? nullptr : data.data();
+	if (device.createPipelineCache(&createInfo, nullptr, &cache) != Result::eSuccess) {
+		Log("pipeline cache %s rejected by driver", path.c_str());
+		createInfo.initialDataSize = 0;
+		createInfo.pInitialData = nullptr;
+		data.clear();
+		assert(device.createPipelineCache(&createInfo, nullptr, &cache) == Result::eSuccess);
+	}
+	warm = !data.empty();
+}
+
+bool PipelineCache::Save()
+{
+	if (path.empty() || !cache) return false;
+	size_t size = 0;
+	if (device.getPipelineCacheData(cache, &size, nullptr) != Result::eSuccess) return false;
+	std::vector<uint8_t> data(size);
+	if (device.getPipelineCacheData(cache, &size, data.data()) != Result::eSuccess) return false;
+	data.resize(size);
+	CacheFileHeader header{};
+	header.magic = CacheMagic;
+	header.version = CacheVersion;
+	header.vendorID = properties.vendorID;
+	header.deviceID = properties.deviceID;
+	header.driverVersion = properties.driverVersion;
+	memcpy(header.uuid, properties.pipelineCacheUUID.data(), VK_UUID_SIZE);
+	header.dataSize = data.size();
+	header.checksum = Fnv1a(data.data(), data.size());
+	// Write beside the target and rename so a crash mid-write never leaves a half-written cache behind.
+	auto temp = path + ".tmp";
+	{
+		std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+		if (!file.is_open()) return false;
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(data.data()), data.size());
+		if (!file.good()) return false;
+	}
+	std::remove(path.c_str());
+	return std::rename(temp.c_str(), path.c_str()) == 0;
+}
+
+void PipelineCache::Destroy()
+{
+	if (cache) device.destroyPipelineCache(cache, nullptr);
+	cache = nullptr;
+}
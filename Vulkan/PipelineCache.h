@@ -0,0 +1,23 @@
+#pragma once
+#include "Dispatch.h"
+#include <string>
+
+// A VkPipelineCache persisted to disk between runs. The file carries its own header so a cache
+// written by another GPU, driver version or a truncated write is rejected instead of handed to the driver.
+class PipelineCache
+{
+	vk::Device device;
+	vk::PhysicalDeviceProperties properties;
+	vk::PipelineCache cache;
+	std::string path;
+	bool warm = false;
+public:
+	// Loads the cache from path, falling back to an empty cache when the file is missing or invalid.
+	void Create(vk::PhysicalDevice physicalDevice, vk::Device device, const std::string& path);
+	// Writes the current cache contents back to disk; does nothing when no path was given.
+	bool Save();
+	void Destroy();
+	vk::PipelineCache Handle() const { return cache; }
+	// True when the cache was seeded from a valid file on disk.
+	bool IsWarm() const { return warm; }
+};
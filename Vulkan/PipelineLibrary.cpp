@@ -0,0 +1,360 @@
+#include "PipelineLibrary.h"
+#include "Log.h"
+#include "Trace.h"
+#ifdef _DEBUG
+#include <cassert>
+#else
+#define assert(X) (void)(X)
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <stdexcept>
+
+using namespace vk;
+
+bool PipelineKey::operator==(const PipelineKey& other) const
+{
+	return vertexFormat == other.vertexFormat && topology == other.topology && cullMode == other.cullMode && blend == other.blend && constants == other.constants;
+}
+
+uint64_t PipelineKey::Hash() const
+{
+	// FNV-1a over the fields rather than the bytes, so padding never leaks into the hash.
+	uint64_t hash = 0xCBF29CE484222325ull;
+	auto mix = [&](uint32_t value) {
+		for (int i = 0; i < 4; i++) {
+			hash ^= (value >> (i * 8)) & 0xFF;
+			hash *= 0x100000001B3ull;
+		}
+	};
+	mix((uint32_t)vertexFormat);
+	mix((uint32_t)topology);
+	mix((uint32_t)cullMode);
+	mix((uint32_t)blend);
+	for (auto constant : constants) mix(constant);
+	return hash;
+}
+
+std::string PipelineKey::Name() const
+{
+	static const char* blendNames[] = { "opaque", "alpha", "additive" };
+	std::string name = vertexFormat == MeshVertexFormat::PositionColorF32 ? "f32" : "packed";
+	name += "/" + to_string(topology) + "/" + to_string(cullMode) + "/" + blendNames[(uint32_t)blend] + "/";
+	for (size_t i = 0; i < constants.size(); i++) name += (i ? "," : "") + std::to_string(constants[i]);
+	return name;
+}
+
+ShaderModule PipelineLibrary::CreateModule(SpirvCode code) const
+{
+	ShaderModuleCreateInfo moduleInfo{};
+	moduleInfo.sType = StructureType::eShaderModuleCreateInfo;
+	moduleInfo.codeSize = code.size;
+	moduleInfo.pCode = code.words;
+	ShaderModule module;
+	assert(device.createShaderModule(&moduleInfo, nullptr, &module) == Result::eSuccess);
+	return module;
+}
+
+void PipelineLibrary::Create(Device device, DeletionQueue& deletions, vk::PipelineCache cache, PipelineLayout layout, RenderPass renderPass, const std::vector<Format>& colorFormats,
+	SpirvCode vertexCode, SpirvCode pixelCode, ThreadPool& pool)
+{
+	this->device = device;
+	this->pool = &pool;
+	this->deletions = &deletions;
+	this->cache = cache;
+	this->layout = layout;
+	this->renderPass = renderPass;
+	this->colorFormats = colorFormats;
+	shaders.vertex = CreateModule(vertexCode);
+	shaders.pixel = CreateModule(pixelCode);
+	shaders.generation = 0;
+	stopping = false;
+}
+
+void PipelineLibrary::Destroy()
+{
+	{
+		// Jobs still on the pool find the queue empty and return without touching a variant.
+		std::unique_lock<std::mutex> lock(mutex);
+		stopping = true;
+		queue.clear();
+		idle.wait(lock, [&] { return compiling == 0; });
+	}
+	for (auto& entry : variants) {
+		if (entry.second.pipeline) deletions->Retire(entry.second.pipeline);
+	}
+	variants.clear();
+	for (auto module : retiredModules) device.destroyShaderModule(module, nullptr);
+	retiredModules.clear();
+	device.destroyShaderModule(shaders.pixel, nullptr);
+	device.destroyShaderModule(shaders.vertex, nullptr);
+}
+
+Pipeline PipelineLibrary::Build(const PipelineKey& key, const Shaders& shaders) const
+{
+	SpecializationMapEntry entries[PipelineKey::ConstantCount];
+	for (uint32_t i = 0; i < PipelineKey::ConstantCount; i++) entries[i] = { i, i * (uint32_t)sizeof(uint32_t), sizeof(uint32_t) };
+	SpecializationInfo specialization{};
+	specialization.mapEntryCount = PipelineKey::ConstantCount;
+	specialization.pMapEntries = entries;
+	specialization.dataSize = sizeof(key.constants);
+	specialization.pData = key.constants.data();
+	PipelineShaderStageCreateInfo shaderStages[2]{};
+	shaderStages[0].sType = StructureType::ePipelineShaderStageCreateInfo;
+	shaderStages[0].stage = ShaderStageFlagBits::eVertex;
+	shaderStages[0].module = shaders.vertex;
+	shaderStages[0].pName = "main";
+	shaderStages[0].pSpecializationInfo = &specialization;
+	shaderStages[1] = shaderStages[0];
+	shaderStages[1].stage = ShaderStageFlagBits::eFragment;
+	shaderStages[1].module = shaders.pixel;
+	VertexInputBindingDescription bindingDescription;
+	std::vector<VertexInputAttributeDescription> attributeDescriptions;
+	if (key.vertexFormat == MeshVertexFormat::PositionColorF32) {
+		bindingDescription = VertexLayout<VertexF32>::Binding();
+		auto attributes = VertexLayout<VertexF32>::Attributes();
+		attributeDescriptions.assign(attributes.begin(), attributes.end());
+	}
+	else {
+		bindingDescription = VertexLayout<Vertex>::Binding();
+		auto attributes = VertexLayout<Vertex>::Attributes();
+		attributeDescriptions.assign(attributes.begin(), attributes.end());
+	}
+	PipelineVertexInputStateCreateInfo vertexInputInfo{};
+	vertexInputInfo.sType = StructureType::ePipelineVertexInputStateCreateInfo;
+	vertexInputInfo.vertexBindingDescriptionCount = 1;
+	vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
+	vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+	vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
+	PipelineInputAssemblyStateCreateInfo inputAssembly{};
+	inputAssembly.sType = StructureType::ePipelineInputAssemblyStateCreateInfo;
+	inputAssembly.topology = key.topology;
+	inputAssembly.primitiveRestartEnable = VK_FALSE;
+	// Set by whoever records the draws, so a resize never invalidates a pipeline.
+	PipelineViewportStateCreateInfo viewportState{};
+	viewportState.sType = StructureType::ePipelineViewportStateCreateInfo;
+	viewportState.viewportCount = 1;
+	viewportState.scissorCount = 1;
+	DynamicState dynamicStates[] = { DynamicState::eViewport, DynamicState::eScissor };
+	PipelineDynamicStateCreateInfo dynamicState{};
+	dynamicState.sType = StructureType::ePipelineDynamicStateCreateInfo;
+	dynamicState.dynamicStateCount = 2;
+	dynamicState.pDynamicStates = dynamicStates;
+	PipelineRasterizationStateCreateInfo rasterizer{};
+	rasterizer.sType = StructureType::ePipelineRasterizationStateCreateInfo;
+	rasterizer.depthClampEnable = VK_FALSE;
+	rasterizer.rasterizerDiscardEnable = VK_FALSE;
+	rasterizer.polygonMode = PolygonMode::eFill;
+	rasterizer.lineWidth = 1.0f;
+	rasterizer.cullMode = key.cullMode;
+	rasterizer.frontFace = FrontFace::eClockwise;
+	rasterizer.depthBiasEnable = VK_FALSE;
+	PipelineMultisampleStateCreateInfo multisampling{};
+	multisampling.sType = StructureType::ePipelineMultisampleStateCreateInfo;
+	multisampling.sampleShadingEnable = VK_FALSE;
+	multisampling.rasterizationSamples = SampleCountFlagBits::e1;
+	PipelineColorBlendAttachmentState colorBlendAttachment{};
+	colorBlendAttachment.colorWriteMask = ColorComponentFlagBits::eR | ColorComponentFlagBits::eG | ColorComponentFlagBits::eB | ColorComponentFlagBits::eA;
+	colorBlendAttachment.blendEnable = key.blend != BlendMode::Opaque;
+	colorBlendAttachment.srcColorBlendFactor = key.blend == BlendMode::Alpha ? BlendFactor::eSrcAlpha : BlendFactor::eOne;
+	colorBlendAttachment.dstColorBlendFactor = key.blend == BlendMode::Alpha ? BlendFactor::eOneMinusSrcAlpha : BlendFactor::eOne;
+	colorBlendAttachment.colorBlendOp = BlendOp::eAdd;
+	colorBlendAttachment.srcAlphaBlendFactor = BlendFactor::eOne;
+	colorBlendAttachment.dstAlphaBlendFactor = key.blend == BlendMode::Alpha ? BlendFactor::eOneMinusSrcAlpha : BlendFactor::eOne;
+	colorBlendAttachment.alphaBlendOp = BlendOp::eAdd;
+	PipelineColorBlendStateCreateInfo colorBlending{};
+	colorBlending.sType = StructureType::ePipelineColorBlendStateCreateInfo;
+	colorBlending.logicOpEnable = VK_FALSE;
+	colorBlending.logicOp = LogicOp::eCopy;
+	colorBlending.attachmentCount = 1;
+	colorBlending.pAttachments = &colorBlendAttachment;
+	PipelineRenderingCreateInfoKHR renderingInfo{};
+	renderingInfo.sType = StructureType::ePipelineRenderingCreateInfoKHR;
+	renderingInfo.colorAttachmentCount = (uint32_t)colorFormats.size();
+	renderingInfo.pColorAttachmentFormats = colorFormats.data();
+	GraphicsPipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = StructureType::eGraphicsPipelineCreateInfo;
+	if (!renderPass) pipelineInfo.pNext = &renderingInfo;
+	pipelineInfo.stageCount = 2;
+	pipelineInfo.pStages = shaderStages;
+	pipelineInfo.pVertexInputState = &vertexInputInfo;
+	pipelineInfo.pInputAssemblyState = &inputAssembly;
+	pipelineInfo.pViewportState = &viewportState;
+	pipelineInfo.pRasterizationState = &rasterizer;
+	pipelineInfo.pMultisampleState = &multisampling;
+	pipelineInfo.pColorBlendState = &colorBlending;
+	pipelineInfo.pDynamicState = &dynamicState;
+	pipelineInfo.layout = layout;
+	pipelineInfo.renderPass = renderPass;
+	pipelineInfo.subpass = 0;
+	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+	// The cache is internally synchronized, so workers share it.
+	Pipeline pipeline;
+	if (device.createGraphicsPipelines(cache, 1, &pipelineInfo, nullptr, &pipeline) != Result::eSuccess) return nullptr;
+	deletions->Track(HandleType::Pipeline);
+	return pipeline;
+}
+
+void PipelineLibrary::CompileNext()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	// Compile() and Reload() rewrite the queue, so there may be fewer keys than jobs.
+	if (stopping || queue.empty()) return;
+	auto key = queue.front();
+	queue.pop_front();
+	// Reload() only retires modules, and frees them once nothing is compiling, so this copy stays valid.
+	auto current = shaders;
+	compiling++;
+	lock.unlock();
+	auto start = std::chrono::steady_clock::now();
+	Pipeline pipeline;
+	try {
+		TraceScope trace("compilePipeline");
+		pipeline = Build(key, current);
+	}
+	catch (...) {
+		// Logged and marked failed below like any other failed build; a pool job has nobody to throw to.
+	}
+	double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	if (pipeline) Log("pipeline %s: %.1fms", key.Name().c_str(), elapsed);
+	else Log("pipeline %s: compilation failed", key.Name().c_str());
+	lock.lock();
+	Install(key, pipeline, current.generation);
+	compiling--;
+	if (queue.empty() && compiling == 0) idle.notify_all();
+}
+
+void PipelineLibrary::Install(const PipelineKey& key, Pipeline pipeline, uint64_t generation)
+{
+	auto& variant = variants[key];
+	// Compile() may have built the same key on its own thread meanwhile, or a reload may have overtaken this build.
+	if (variant.state == VariantState::Ready && variant.generation >= generation) {
+		if (pipeline) deletions->Retire(pipeline);
+		return;
+	}
+	if (!pipeline) {
+		if (variant.state != VariantState::Ready) variant.state = VariantState::Failed;
+		return;
+	}
+	// Frames already recorded may still draw with the pipeline being replaced.
+	if (variant.pipeline) deletions->Retire(variant.pipeline);
+	variant.pipeline = pipeline;
+	variant.generation = generation;
+	variant.state = VariantState::Ready;
+}
+
+bool PipelineLibrary::Enqueue(const PipelineKey& key)
+{
+	if (variants.count(key)) return false;
+	variants[key] = Variant{};
+	queue.push_back(key);
+	return true;
+}
+
+Pipeline PipelineLibrary::Compile(const PipelineKey& key)
+{
+	Shaders current;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto found = variants.find(key);
+		if (found != variants.end() && found->second.state == VariantState::Ready) return found->second.pipeline;
+		variants.emplace(key, Variant{});
+		queue.erase(std::remove(queue.begin(), queue.end(), key), queue.end());
+		current = shaders;
+		compiling++;
+	}
+	Pipeline pipeline;
+	std::exception_ptr failure;
+	try {
+		pipeline = Build(key, current);
+	}
+	catch (...) {
+		failure = std::current_exception();
+	}
+	std::lock_guard<std::mutex> lock(mutex);
+	compiling--;
+	if (queue.empty() && compiling == 0) idle.notify_all();
+	// Marks the variant failed rather than leaving it pending, so Get() neither waits on nor requeues it.
+	Install(key, pipeline, current.generation);
+	auto& variant = variants[key];
+	if (variant.state != VariantState::Ready) {
+		Log("pipeline %s: compilation failed", key.Name().c_str());
+		if (failure) std::rethrow_exception(failure);
+		throw std::runtime_error("failed to create graphics pipeline " + key.Name());
+	}
+	return variant.pipeline;
+}
+
+void PipelineLibrary::Request(const std::vector<PipelineKey>& keys)
+{
+	size_t queued = 0;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (auto& key : keys) queued += Enqueue(key);
+	}
+	for (size_t i = 0; i < queued; i++) pool->Submit([this] { CompileNext(); });
+}
+
+Pipeline PipelineLibrary::Get(const PipelineKey& key)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	auto found = variants.find(key);
+	if (found != variants.end() && found->second.state == VariantState::Ready) return found->second.pipeline;
+	bool queued = Enqueue(key);
+	// Vertex input and topology must match what is bound; among those, prefer the most shared state.
+	Pipeline best;
+	int bestScore = -1;
+	for (auto& entry : variants) {
+		auto& candidate = entry.first;
+		if (entry.second.state != VariantState::Ready || candidate.vertexFormat != key.vertexFormat || candidate.topology != key.topology) continue;
+		int score = (candidate.constants == key.constants) * 4 + (candidate.blend == key.blend) * 2 + (candidate.cullMode == key.cullMode);
+		if (score > bestScore) {
+			best = entry.second.pipeline;
+			bestScore = score;
+		}
+	}
+	lock.unlock();
+	if (queued) pool->Submit([this] { CompileNext(); });
+	return best;
+}
+
+void PipelineLibrary::Reload(SpirvCode vertexCode, SpirvCode pixelCode)
+{
+	auto vertex = CreateModule(vertexCode);
+	auto pixel = CreateModule(pixelCode);
+	std::unique_lock<std::mutex> lock(mutex);
+	retiredModules.push_back(shaders.vertex);
+	retiredModules.push_back(shaders.pixel);
+	shaders = { vertex, pixel, shaders.generation + 1 };
+	// Requeue everything, including failed variants, which the new shaders may fix.
+	queue.clear();
+	for (auto& entry : variants) queue.push_back(entry.first);
+	size_t queued = queue.size();
+	Log("pipelines: rebuilding %zu variants with shader generation %llu", queued, (unsigned long long)shaders.generation);
+	lock.unlock();
+	for (size_t i = 0; i < queued; i++) pool->Submit([this] { CompileNext(); });
+}
+
+void PipelineLibrary::Collect()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	// A pipeline no longer needs its modules once created, so only compiles in flight can still be reading them.
+	if (compiling == 0) {
+		for (auto module : retiredModules) device.destroyShaderModule(module, nullptr);
+		retiredModules.clear();
+	}
+}
+
+void PipelineLibrary::WaitIdle()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	idle.wait(lock, [&] { return queue.empty() && compiling == 0; });
+}
+
+size_t PipelineLibrary::ReadyCount() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return std::count_if(variants.begin(), variants.end(), [](const auto& entry) { return entry.second.state == VariantState::Ready; });
+}
@@ -0,0 +1,122 @@
+#pragma once
+#include "DeletionQueue.h"
+#include "Dispatch.h"
+#include "MeshFile.h"
+#include "Shaders.h"
+#include "ThreadPool.h"
+#include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+enum class BlendMode : uint32_t {
+	Opaque,
+	// Source over, by source alpha.
+	Alpha,
+	Additive
+};
+
+// Specialization constant 0 (ColorSource in header.hlsli): what the vertex shader outputs as color.
+enum class ColorSource : uint32_t {
+	VertexTimesInstance = 0,
+	Vertex = 1,
+	Instance = 2
+};
+
+// Everything that distinguishes one graphics pipeline variant from another. The layout, render target formats and
+// shaders are shared by the whole library; viewport and scissor are dynamic, so no variant depends on the target size.
+struct PipelineKey {
+	static constexpr size_t ConstantCount = 4;
+
+	MeshVertexFormat vertexFormat = MeshVertexFormat::PositionColorPacked;
+	vk::PrimitiveTopology topology = vk::PrimitiveTopology::eTriangleList;
+	vk::CullModeFlagBits cullMode = vk::CullModeFlagBits::eBack;
+	BlendMode blend = BlendMode::Opaque;
+	// Specialization constants by constant_id, visible to every stage.
+	std::array<uint32_t, ConstantCount> constants{};
+
+	bool operator==(const PipelineKey& other) const;
+	bool operator!=(const PipelineKey& other) const { return !(*this == other); }
+	uint64_t Hash() const;
+	std::string Name() const;
+};
+
+struct PipelineKeyHash {
+	size_t operator()(const PipelineKey& key) const { return (size_t)key.Hash(); }
+};
+
+// Graphics pipeline variants compiled as background jobs on the shared thread pool. Lookups never block on
+// compilation: a variant that is not ready yet is queued and the closest ready variant that can draw the same vertex
+// stream is returned in its place, so a new material costs a frame or two of approximate shading instead of a hitch.
+class PipelineLibrary
+{
+	enum class VariantState {
+		Pending,
+		Ready,
+		Failed
+	};
+	struct Variant {
+		VariantState state = VariantState::Pending;
+		vk::Pipeline pipeline;
+		// Shader generation pipeline was built from.
+		uint64_t generation = 0;
+	};
+	struct Shaders {
+		vk::ShaderModule vertex;
+		vk::ShaderModule pixel;
+		uint64_t generation = 0;
+	};
+	vk::Device device;
+	DeletionQueue* deletions = nullptr;
+	vk::PipelineCache cache;
+	vk::PipelineLayout layout;
+	vk::RenderPass renderPass;
+	std::vector<vk::Format> colorFormats;
+	Shaders shaders;
+	std::vector<vk::ShaderModule> retiredModules;
+	std::unordered_map<PipelineKey, Variant, PipelineKeyHash> variants;
+	ThreadPool* pool = nullptr;
+	std::deque<PipelineKey> queue;
+	mutable std::mutex mutex;
+	std::condition_variable idle;
+	size_t compiling = 0;
+	bool stopping = false;
+
+	vk::ShaderModule CreateModule(SpirvCode code) const;
+	// Only reads state fixed at Create and the shaders passed in, so any number of threads may build at once.
+	vk::Pipeline Build(const PipelineKey& key, const Shaders& shaders) const;
+	// Pool job: compiles the oldest queued key, if any is left.
+	void CompileNext();
+	// Installs pipeline for key unless a build from newer shaders got there first; the caller holds the mutex.
+	void Install(const PipelineKey& key, vk::Pipeline pipeline, uint64_t generation);
+	// Marks key pending and queues it when it is unknown; the caller holds the mutex and submits a CompileNext job for
+	// every true returned once it released it.
+	bool Enqueue(const PipelineKey& key);
+public:
+	// Pipelines target renderPass, or dynamic rendering into colorFormats when it is null; renderPass must outlive
+	// the library. Replaced pipelines are retired to deletions. Background compiles run on pool, which must outlive
+	// Destroy(); a pool without workers compiles on the thread that queued the variant.
+	void Create(vk::Device device, DeletionQueue& deletions, vk::PipelineCache cache, vk::PipelineLayout layout, vk::RenderPass renderPass, const std::vector<vk::Format>& colorFormats,
+		SpirvCode vertexCode, SpirvCode pixelCode, ThreadPool& pool);
+	// Waits for compiles in flight, then retires every variant.
+	void Destroy();
+	// Builds key on the calling thread if it is not ready yet; used for the variants a frame cannot do without. Throws
+	// when it fails to build, leaving the variant marked failed.
+	vk::Pipeline Compile(const PipelineKey& key);
+	// Queues keys for background compilation.
+	void Request(const std::vector<PipelineKey>& keys);
+	// The pipeline for key when ready. Otherwise key is queued and the best ready variant with the same vertex
+	// format and topology is returned; null if there is none.
+	vk::Pipeline Get(const PipelineKey& key);
+	// Swaps in new shaders and rebuilds every known variant from them in the background. Until its rebuild lands
+	// a variant keeps drawing with the old shaders, and a rebuild that fails leaves it that way.
+	void Reload(SpirvCode vertexCode, SpirvCode pixelCode);
+	// Frees the shader modules of earlier reloads once no compile still reads them. Call once per frame.
+	void Collect();
+	void WaitIdle();
+	size_t ReadyCount() const;
+};
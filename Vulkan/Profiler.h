@@ -0,0 +1,55 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include "Trace.h"
+
+enum class FrameStage {
+	WaitFence,
+	Cull,
+	Acquire,
+	Record,
+	Submit,
+	Present,
+	Frame,
+	Count
+};
+
+inline const char* FrameStageName(FrameStage stage)
+{
+	switch (stage)
+	{
+	case FrameStage::WaitFence: return "waitFence";
+	case FrameStage::Cull: return "cull";
+	case FrameStage::Acquire: return "acquire";
+	case FrameStage::Record: return "record";
+	case FrameStage::Submit: return "submit";
+	case FrameStage::Present: return "present";
+	case FrameStage::Frame: return "frame";
+	default: return "unknown";
+	}
+}
+
+struct FrameTiming {
+	// CPU milliseconds per stage of the last DrawFrame call.
+	double cpu[(size_t)FrameStage::Count]{};
+	// GPU milliseconds spent in the render pass, or a negative value when no result was available.
+	double gpu = -1;
+	// Milliseconds from the start of a frame, when it samples input, until its GPU work completed and the image was
+	// handed to presentation; negative when no frame finished since the previous call.
+	double latency = -1;
+};
+
+// Measures a scope into out and, when traceName is given, also records it as a trace scope.
+class ScopeTimer
+{
+	using Clock = std::chrono::steady_clock;
+	double& out;
+	TraceScope trace;
+	Clock::time_point start;
+public:
+	explicit ScopeTimer(double& out, const char* traceName = nullptr) : out(out), trace(traceName), start(Clock::now()) {}
+	ScopeTimer(FrameTiming& timing, FrameStage stage) : ScopeTimer(timing.cpu[(size_t)stage], FrameStageName(stage)) {}
+	~ScopeTimer() { out = std::chrono::duration<double, std::milli>(Clock::now() - start).count(); }
+	ScopeTimer(const ScopeTimer&) = delete;
+	ScopeTimer& operator=(const ScopeTimer&) = delete;
+};
@@ -0,0 +1,669 @@
+#include "RenderGraph.h"
+#include "Log.h"
+#ifdef _DEBUG
+#include <cassert>
+#else
+#define assert(X) (void)(X)
+#endif
+
+#include <algorithm>
+
+using namespace vk;
+
+namespace {
+	// Only writes need to be made available; read bits in a source access mask do nothing.
+	AccessFlags WriteAccess(AccessFlags access)
+	{
+		return access & (AccessFlagBits::eColorAttachmentWrite | AccessFlagBits::eDepthStencilAttachmentWrite | AccessFlagBits::eShaderWrite
+			| AccessFlagBits::eTransferWrite | AccessFlagBits::eHostWrite | AccessFlagBits::eMemoryWrite);
+	}
+
+	ImageUsageFlags AccessUsage(RenderGraph::Access access)
+	{
+		switch (access)
+		{
+		case RenderGraph::Access::ColorAttachment: return ImageUsageFlagBits::eColorAttachment;
+		case RenderGraph::Access::DepthAttachment: return ImageUsageFlagBits::eDepthStencilAttachment;
+		case RenderGraph::Access::Sampled: return ImageUsageFlagBits::eSampled;
+		case RenderGraph::Access::TransferSrc: return ImageUsageFlagBits::eTransferSrc;
+		case RenderGraph::Access::TransferDst: return ImageUsageFlagBits::eTransferDst;
+		default: return {};
+		}
+	}
+
+	const char* AccessName(RenderGraph::Access access)
+	{
+		switch (access)
+		{
+		case RenderGraph::Access::ColorAttachment: return "color";
+		case RenderGraph::Access::DepthAttachment: return "depth";
+		case RenderGraph::Access::Sampled: return "sampled";
+		case RenderGraph::Access::TransferSrc: return "transferSrc";
+		case RenderGraph::Access::TransferDst: return "transferDst";
+		default: return "?";
+		}
+	}
+}
+
+RenderGraph::State RenderGraph::AccessState(Access access, AttachmentLoadOp load)
+{
+	switch (access)
+	{
+	case Access::ColorAttachment:
+		return { PipelineStageFlagBits::eColorAttachmentOutput,
+			AccessFlagBits::eColorAttachmentWrite | (load == AttachmentLoadOp::eLoad ? AccessFlagBits::eColorAttachmentRead : AccessFlags{}),
+			ImageLayout::eColorAttachmentOptimal };
+	case Access::DepthAttachment:
+		return { PipelineStageFlagBits::eEarlyFragmentTests | PipelineStageFlagBits::eLateFragmentTests,
+			AccessFlagBits::eDepthStencilAttachmentWrite | AccessFlagBits::eDepthStencilAttachmentRead,
+			ImageLayout::eDepthStencilAttachmentOptimal };
+	case Access::Sampled:
+		return { PipelineStageFlagBits::eFragmentShader, AccessFlagBits::eShaderRead, ImageLayout::eShaderReadOnlyOptimal };
+	case Access::TransferSrc:
+		return { PipelineStageFlagBits::eTransfer, AccessFlagBits::eTransferRead, ImageLayout::eTransferSrcOptimal };
+	case Access::TransferDst:
+		return { PipelineStageFlagBits::eTransfer, AccessFlagBits::eTransferWrite, ImageLayout::eTransferDstOptimal };
+	default:
+		return {};
+	}
+}
+
+void RenderGraph::Create(Device device, MemoryAllocator& allocator, DeletionQueue& deletions, bool dynamicRendering)
+{
+	this->device = device;
+	this->allocator = &allocator;
+	this->deletions = &deletions;
+	this->dynamicRendering = dynamicRendering;
+}
+
+void RenderGraph::Destroy()
+{
+	Reset();
+	for (auto& entry : renderPasses) device.destroyRenderPass(entry.second, nullptr);
+	renderPasses.clear();
+}
+
+void RenderGraph::Reset()
+{
+	Release();
+	passes.clear();
+	resources.clear();
+}
+
+void RenderGraph::Release()
+{
+	// Frames in flight may still use all of these, so they go through the deletion queue.
+	for (auto& entry : framebuffers) deletions->Retire(entry.second);
+	framebuffers.clear();
+	for (auto& pass : passes) {
+		pass.renderPass = nullptr;
+		pass.raster = false;
+		pass.colorFormats.clear();
+		pass.depthFormat = Format::eUndefined;
+		pass.live = false;
+		pass.barriers.clear();
+	}
+	for (auto& resource : resources) {
+		if (resource.imported) continue;
+		if (resource.view) deletions->Retire(resource.view);
+		if (resource.image) deletions->Retire(resource.image, Allocation{});
+		resource.view = nullptr;
+		resource.image = nullptr;
+		resource.slot = UINT32_MAX;
+		resource.firstUse = UINT32_MAX;
+		resource.lastUse = 0;
+	}
+	for (auto& slot : slots) deletions->Retire(slot.allocation);
+	slots.clear();
+	finalBarriers.clear();
+	compiled = false;
+}
+
+RenderGraph::Resource RenderGraph::ImportImage(const std::string& name, Format format, Extent2D extent, State initial, State final, ImageAspectFlags aspect)
+{
+	ResourceNode resource{};
+	resource.name = name;
+	resource.isImage = true;
+	resource.imported = true;
+	resource.format = format;
+	resource.extent = extent;
+	resource.aspect = aspect;
+	resource.initial = initial;
+	resource.final = final;
+	resources.push_back(resource);
+	return (Resource)resources.size() - 1;
+}
+
+RenderGraph::Resource RenderGraph::ImportBuffer(const std::string& name, State initial, State final)
+{
+	ResourceNode resource{};
+	resource.name = name;
+	resource.isImage = false;
+	resource.imported = true;
+	resource.initial = initial;
+	resource.final = final;
+	resources.push_back(resource);
+	return (Resource)resources.size() - 1;
+}
+
+RenderGraph::Resource RenderGraph::CreateImage(const std::string& name, Format format, Extent2D extent, ImageAspectFlags aspect)
+{
+	ResourceNode resource{};
+	resource.name = name;
+	resource.isImage = true;
+	resource.imported = false;
+	resource.format = format;
+	resource.extent = extent;
+	resource.aspect = aspect;
+	resources.push_back(resource);
+	return (Resource)resources.size() - 1;
+}
+
+void RenderGraph::SetExtent(Resource resource, Extent2D extent)
+{
+	resources[resource].extent = extent;
+}
+
+RenderGraph::Pass RenderGraph::AddPass(const std::string& name, ExecuteFunction execute, SubpassContents contents)
+{
+	PassNode pass{};
+	pass.name = name;
+	pass.execute = std::move(execute);
+	pass.contents = contents;
+	passes.push_back(std::move(pass));
+	return (Pass)passes.size() - 1;
+}
+
+void RenderGraph::Read(Pass pass, Resource resource, Access access)
+{
+	passes[pass].uses.push_back({ resource, access, false, AttachmentLoadOp::eLoad, {} });
+}
+
+void RenderGraph::Write(Pass pass, Resource resource, Access access, AttachmentLoadOp load, ClearValue clear)
+{
+	passes[pass].uses.push_back({ resource, access, true, IsAttachment(access) ? load : AttachmentLoadOp::eLoad, clear });
+}
+
+void RenderGraph::Compile()
+{
+	Release();
+	Cull();
+	AllocateTransients();
+	for (auto& pass : passes) {
+		if (pass.live) CreateRenderPass(pass);
+	}
+	ComputeBarriers();
+	LogSchedule();
+	compiled = true;
+}
+
+void RenderGraph::Cull()
+{
+	// Walk backwards from the imports: a pass survives if it writes something a later surviving pass or the world
+	// outside the frame still needs. A full overwrite of an attachment ends the need for whatever was there before.
+	std::vector<bool> needed(resources.size());
+	for (size_t i = 0; i < resources.size(); i++) needed[i] = resources[i].imported;
+	for (size_t p = passes.size(); p-- > 0;) {
+		auto& pass = passes[p];
+		pass.live = std::any_of(pass.uses.begin(), pass.uses.end(), [&](const Use& use) { return use.write && needed[use.resource]; });
+		if (!pass.live) continue;
+		for (auto& use : pass.uses) {
+			if (use.write && use.load != AttachmentLoadOp::eLoad && !resources[use.resource].imported) needed[use.resource] = false;
+		}
+		for (auto& use : pass.uses) {
+			if (!use.write || use.load == AttachmentLoadOp::eLoad) needed[use.resource] = true;
+		}
+	}
+}
+
+void RenderGraph::AllocateTransients()
+{
+	std::vector<Resource> transients;
+	for (uint32_t p = 0; p < passes.size(); p++) {
+		if (!passes[p].live) continue;
+		for (auto& use : passes[p].uses) {
+			auto& resource = resources[use.resource];
+			if (resource.imported) continue;
+			if (resource.firstUse == UINT32_MAX) {
+				transients.push_back(use.resource);
+				resource.firstUse = p;
+				resource.usage = {};
+			}
+			resource.lastUse = p;
+			resource.usage |= AccessUsage(use.access);
+			auto state = AccessState(use.access, use.load);
+			resource.lastState = { state.stages, WriteAccess(state.access), state.layout };
+		}
+	}
+	std::vector<MemoryRequirements> requirements(resources.size());
+	for (auto index : transients) {
+		auto& resource = resources[index];
+		ImageCreateInfo imageInfo{};
+		imageInfo.sType = StructureType::eImageCreateInfo;
+		imageInfo.imageType = ImageType::e2D;
+		imageInfo.format = resource.format;
+		imageInfo.extent = Extent3D(resource.extent, 1);
+		imageInfo.mipLevels = 1;
+		imageInfo.arrayLayers = 1;
+		imageInfo.samples = SampleCountFlagBits::e1;
+		imageInfo.tiling = ImageTiling::eOptimal;
+		imageInfo.usage = resource.usage;
+		imageInfo.sharingMode = SharingMode::eExclusive;
+		imageInfo.initialLayout = ImageLayout::eUndefined;
+		assert(device.createImage(&imageInfo, nullptr, &resource.image) == Result::eSuccess);
+		deletions->Track(HandleType::Image);
+		device.getImageMemoryRequirements(resource.image, &requirements[index]);
+	}
+	// Largest first, each into the first slot whose occupants are all dead before it starts or born after it ends.
+	std::sort(transients.begin(), transients.end(), [&](Resource a, Resource b) { return requirements[a].size > requirements[b].size; });
+	for (auto index : transients) {
+		auto& resource = resources[index];
+		auto& required = requirements[index];
+		for (uint32_t s = 0; s < slots.size() && resource.slot == UINT32_MAX; s++) {
+			auto& slot = slots[s];
+			if ((slot.requirements.memoryTypeBits & required.memoryTypeBits) == 0) continue;
+			bool disjoint = std::all_of(slot.resources.begin(), slot.resources.end(), [&](Resource other) {
+				return resources[other].lastUse < resource.firstUse || resource.lastUse < resources[other].firstUse;
+			});
+			if (!disjoint) continue;
+			slot.requirements.size = std::max(slot.requirements.size, required.size);
+			slot.requirements.alignment = std::max(slot.requirements.alignment, required.alignment);
+			slot.requirements.memoryTypeBits &= required.memoryTypeBits;
+			slot.resources.push_back(index);
+			resource.slot = s;
+		}
+		if (resource.slot == UINT32_MAX) {
+			MemorySlot slot{};
+			slot.requirements = required;
+			slot.resources.push_back(index);
+			resource.slot = (uint32_t)slots.size();
+			slots.push_back(slot);
+		}
+	}
+	for (auto& slot : slots) {
+		std::sort(slot.resources.begin(), slot.resources.end(), [&](Resource a, Resource b) { return resources[a].firstUse < resources[b].firstUse; });
+		slot.allocation = allocator->Allocate(slot.requirements, MemoryPropertyFlagBits::eDeviceLocal, ResourceKind::Optimal);
+		deletions->Track(HandleType::Memory);
+		for (auto index : slot.resources) {
+			auto& resource = resources[index];
+			assert(device.bindImageMemory(resource.image, slot.allocation.memory, slot.allocation.offset) == Result::eSuccess);
+			ImageViewCreateInfo viewInfo{};
+			viewInfo.sType = StructureType::eImageViewCreateInfo;
+			viewInfo.image = resource.image;
+			viewInfo.viewType = ImageViewType::e2D;
+			viewInfo.format = resource.format;
+			viewInfo.subresourceRange.aspectMask = resource.aspect;
+			viewInfo.subresourceRange.levelCount = 1;
+			viewInfo.subresourceRange.layerCount = 1;
+			assert(device.createImageView(&viewInfo, nullptr, &resource.view) == Result::eSuccess);
+			deletions->Track(HandleType::ImageView);
+		}
+	}
+}
+
+void RenderGraph::CreateRenderPass(PassNode& pass)
+{
+	RenderPassKey key;
+	for (auto& use : pass.uses) {
+		if (!IsAttachment(use.access)) continue;
+		auto& resource = resources[use.resource];
+		if (key.empty()) pass.extent = resource.extent;
+		if (use.access == Access::DepthAttachment) pass.depthFormat = resource.format;
+		else pass.colorFormats.push_back(resource.format);
+		key.emplace_back(resource.format, use.load, AccessState(use.access, use.load).layout);
+	}
+	pass.raster = !key.empty();
+	if (!pass.raster || dynamicRendering) return;
+	auto found = renderPasses.find(key);
+	if (found != renderPasses.end()) {
+		pass.renderPass = found->second;
+		return;
+	}
+	// Layouts are changed by the graph's barriers, so every attachment starts and ends in the layout the subpass
+	// uses and the render pass needs no external dependencies of its own.
+	std::vector<AttachmentDescription> attachments;
+	std::vector<AttachmentReference> colorRefs;
+	AttachmentReference depthRef{};
+	bool hasDepth = false;
+	for (auto& use : pass.uses) {
+		if (!IsAttachment(use.access)) continue;
+		auto& resource = resources[use.resource];
+		auto layout = AccessState(use.access, use.load).layout;
+		AttachmentDescription attachment{};
+		attachment.format = resource.format;
+		attachment.samples = SampleCountFlagBits::e1;
+		attachment.loadOp = use.load;
+		attachment.storeOp = AttachmentStoreOp::eStore;
+		attachment.stencilLoadOp = AttachmentLoadOp::eDontCare;
+		attachment.stencilStoreOp = AttachmentStoreOp::eDontCare;
+		attachment.initialLayout = layout;
+		attachment.finalLayout = layout;
+		AttachmentReference reference{ (uint32_t)attachments.size(), layout };
+		if (use.access == Access::DepthAttachment) {
+			depthRef = reference;
+			hasDepth = true;
+		}
+		else {
+			colorRefs.push_back(reference);
+		}
+		attachments.push_back(attachment);
+	}
+	SubpassDescription subpass{};
+	subpass.pipelineBindPoint = PipelineBindPoint::eGraphics;
+	subpass.colorAttachmentCount = (uint32_t)colorRefs.size();
+	subpass.pColorAttachments = colorRefs.data();
+	subpass.pDepthStencilAttachment = hasDepth ? &depthRef : nullptr;
+	RenderPassCreateInfo renderPassInfo{};
+	renderPassInfo.sType = StructureType::eRenderPassCreateInfo;
+	renderPassInfo.attachmentCount = (uint32_t)attachments.size();
+	renderPassInfo.pAttachments = attachments.data();
+	renderPassInfo.subpassCount = 1;
+	renderPassInfo.pSubpasses = &subpass;
+	assert(device.createRenderPass(&renderPassInfo, nullptr, &pass.renderPass) == Result::eSuccess);
+	renderPasses.emplace(key, pass.renderPass);
+}
+
+Extent2D RenderGraph::RenderArea(const PassNode& pass)
+{
+	if (pass.renderArea.width == 0 || pass.renderArea.height == 0) return pass.extent;
+	return Extent2D(std::min(pass.renderArea.width, pass.extent.width), std::min(pass.renderArea.height, pass.extent.height));
+}
+
+void RenderGraph::BeginRendering(CommandBuffer commandBuffer, const PassNode& pass, Extent2D area) const
+{
+	std::vector<RenderingAttachmentInfoKHR> colorAttachments;
+	RenderingAttachmentInfoKHR depthAttachment{};
+	bool hasDepth = false;
+	for (auto& use : pass.uses) {
+		if (!IsAttachment(use.access)) continue;
+		RenderingAttachmentInfoKHR attachment{};
+		attachment.sType = StructureType::eRenderingAttachmentInfoKHR;
+		attachment.imageView = resources[use.resource].view;
+		attachment.imageLayout = AccessState(use.access, use.load).layout;
+		attachment.resolveMode = ResolveModeFlagBits::eNone;
+		attachment.loadOp = use.load;
+		attachment.storeOp = AttachmentStoreOp::eStore;
+		attachment.clearValue = use.clear;
+		if (use.access == Access::DepthAttachment) {
+			depthAttachment = attachment;
+			hasDepth = true;
+		}
+		else {
+			colorAttachments.push_back(attachment);
+		}
+	}
+	RenderingInfoKHR renderingInfo{};
+	renderingInfo.sType = StructureType::eRenderingInfoKHR;
+	if (pass.contents == SubpassContents::eSecondaryCommandBuffers) renderingInfo.flags = RenderingFlagBitsKHR::eContentsSecondaryCommandBuffers;
+	renderingInfo.renderArea.extent = area;
+	renderingInfo.layerCount = 1;
+	renderingInfo.colorAttachmentCount = (uint32_t)colorAttachments.size();
+	renderingInfo.pColorAttachments = colorAttachments.data();
+	renderingInfo.pDepthAttachment = hasDepth ? &depthAttachment : nullptr;
+	commandBuffer.beginRenderingKHR(&renderingInfo);
+}
+
+void RenderGraph::ComputeBarriers()
+{
+	// Per resource: the last writer, the readers since, and which stages and accesses that write was made visible
+	// to. A barrier is only emitted for a hazard: a layout change, a read of an unseen write, or a write after
+	// reads or another write.
+	struct Track {
+		ImageLayout layout;
+		PipelineStageFlags writeStages;
+		AccessFlags writeAccess;
+		PipelineStageFlags readStages;
+		PipelineStageFlags visibleStages;
+		AccessFlags visibleAccess;
+	};
+	std::vector<Track> tracks(resources.size());
+	for (size_t i = 0; i < resources.size(); i++) {
+		auto& resource = resources[i];
+		if (resource.imported) {
+			tracks[i] = { resource.initial.layout, resource.initial.stages, WriteAccess(resource.initial.access), {}, {}, {} };
+		}
+		else if (resource.slot != UINT32_MAX) {
+			// The memory was last used by whichever transient precedes this one in the slot, wrapping around to the
+			// previous frame; its contents are discarded.
+			auto& occupants = slots[resource.slot].resources;
+			size_t position = std::find(occupants.begin(), occupants.end(), (Resource)i) - occupants.begin();
+			auto& previous = resources[occupants[(position + occupants.size() - 1) % occupants.size()]];
+			tracks[i] = { ImageLayout::eUndefined, previous.lastState.stages, previous.lastState.access, {}, {}, {} };
+		}
+	}
+	auto transition = [&](Resource index, const State& state, bool write, std::vector<Barrier>& barriers) {
+		auto& track = tracks[index];
+		bool image = resources[index].isImage;
+		State dst = { state.stages, state.access, image ? state.layout : ImageLayout::eUndefined };
+		if (image && track.layout != dst.layout) {
+			barriers.push_back({ index, { track.writeStages | track.readStages, track.writeAccess, track.layout }, dst });
+			// Later users chain their dependency through this barrier's destination stages.
+			track.layout = dst.layout;
+			track.writeStages = state.stages;
+			track.writeAccess = write ? WriteAccess(state.access) : AccessFlags{};
+			track.readStages = write ? PipelineStageFlags{} : state.stages;
+			track.visibleStages = write ? PipelineStageFlags{} : state.stages;
+			track.visibleAccess = write ? AccessFlags{} : state.access;
+		}
+		else if (write) {
+			if (track.readStages) barriers.push_back({ index, { track.readStages, {}, track.layout }, dst });
+			else if (track.writeStages) barriers.push_back({ index, { track.writeStages, track.writeAccess, track.layout }, dst });
+			track.writeStages = state.stages;
+			track.writeAccess = WriteAccess(state.access);
+			track.readStages = {};
+			track.visibleStages = {};
+			track.visibleAccess = {};
+		}
+		else {
+			bool visible = (track.visibleStages & state.stages) == state.stages && (track.visibleAccess & state.access) == state.access;
+			if (track.writeStages && !visible) {
+				barriers.push_back({ index, { track.writeStages, track.writeAccess, track.layout }, dst });
+				track.visibleStages |= state.stages;
+				track.visibleAccess |= state.access;
+			}
+			track.readStages |= state.stages;
+		}
+	};
+	std::vector<bool> used(resources.size());
+	for (auto& pass : passes) {
+		if (!pass.live) continue;
+		for (auto& use : pass.uses) {
+			transition(use.resource, AccessState(use.access, use.load), use.write, pass.barriers);
+			used[use.resource] = true;
+		}
+	}
+	for (size_t i = 0; i < resources.size(); i++) {
+		auto& resource = resources[i];
+		bool hasFinal = resource.final.stages || resource.final.layout != ImageLayout::eUndefined;
+		if (!resource.imported || !used[i] || !hasFinal) continue;
+		// Hand the resource over in its final state even if the last pass left it compatible, so whatever
+		// follows the frame sees every write.
+		auto& track = tracks[i];
+		if (resource.isImage && track.layout != resource.final.layout) {
+			transition((Resource)i, resource.final, false, finalBarriers);
+		}
+		else if (track.writeStages) {
+			finalBarriers.push_back({ (Resource)i, { track.writeStages, track.writeAccess, track.layout }, { resource.final.stages, resource.final.access, track.layout } });
+		}
+	}
+}
+
+void RenderGraph::RecordBarriers(CommandBuffer commandBuffer, const std::vector<Barrier>& barriers) const
+{
+	if (barriers.empty()) return;
+	PipelineStageFlags srcStages;
+	PipelineStageFlags dstStages;
+	std::vector<BufferMemoryBarrier> bufferBarriers;
+	std::vector<ImageMemoryBarrier> imageBarriers;
+	for (auto& barrier : barriers) {
+		auto& resource = resources[barrier.resource];
+		srcStages |= barrier.src.stages;
+		dstStages |= barrier.dst.stages;
+		if (!resource.isImage) {
+			BufferMemoryBarrier bufferBarrier{};
+			bufferBarrier.sType = StructureType::eBufferMemoryBarrier;
+			bufferBarrier.srcAccessMask = barrier.src.access;
+			bufferBarrier.dstAccessMask = barrier.dst.access;
+			bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			bufferBarrier.buffer = resource.buffer;
+			bufferBarrier.offset = 0;
+			bufferBarrier.size = VK_WHOLE_SIZE;
+			bufferBarriers.push_back(bufferBarrier);
+			continue;
+		}
+		ImageMemoryBarrier imageBarrier{};
+		imageBarrier.sType = StructureType::eImageMemoryBarrier;
+		imageBarrier.srcAccessMask = barrier.src.access;
+		imageBarrier.dstAccessMask = barrier.dst.access;
+		imageBarrier.oldLayout = barrier.src.layout;
+		imageBarrier.newLayout = barrier.dst.layout;
+		imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		imageBarrier.image = resource.image;
+		imageBarrier.subresourceRange.aspectMask = resource.aspect;
+		imageBarrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+		imageBarrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+		imageBarriers.push_back(imageBarrier);
+	}
+	if (!srcStages) srcStages = PipelineStageFlagBits::eTopOfPipe;
+	if (!dstStages) dstStages = PipelineStageFlagBits::eBottomOfPipe;
+	commandBuffer.pipelineBarrier(srcStages, dstStages, {}, 0, nullptr, (uint32_t)bufferBarriers.size(), bufferBarriers.data(), (uint32_t)imageBarriers.size(), imageBarriers.data());
+}
+
+void RenderGraph::LogSchedule() const
+{
+	auto describe = [&](const Barrier& barrier) {
+		auto& resource = resources[barrier.resource];
+		std::string text = resource.name + ": " + to_string(barrier.src.stages) + " -> " + to_string(barrier.dst.stages);
+		if (barrier.src.layout != barrier.dst.layout) text += ", " + to_string(barrier.src.layout) + " -> " + to_string(barrier.dst.layout);
+		return text;
+	};
+	size_t livePasses = std::count_if(passes.begin(), passes.end(), [](const PassNode& pass) { return pass.live; });
+	DeviceSize aliasedBytes = 0;
+	DeviceSize separateBytes = 0;
+	size_t transients = 0;
+	for (auto& slot : slots) {
+		aliasedBytes += slot.requirements.size;
+		for (auto index : slot.resources) {
+			MemoryRequirements required;
+			device.getImageMemoryRequirements(resources[index].image, &required);
+			separateBytes += required.size;
+			transients++;
+		}
+	}
+	Log("render graph: %zu of %zu passes live, %zu transient images in %zu allocations (%.1f MB, %.1f MB unaliased), %s",
+		livePasses, passes.size(), transients, slots.size(), aliasedBytes / 1048576.0, separateBytes / 1048576.0,
+		dynamicRendering ? "dynamic rendering" : "render passes");
+	for (auto& pass : passes) {
+		if (!pass.live) {
+			Log("  %s: culled", pass.name.c_str());
+			continue;
+		}
+		std::string uses;
+		for (auto& use : pass.uses) {
+			if (!uses.empty()) uses += ", ";
+			uses += std::string(use.write ? "writes " : "reads ") + resources[use.resource].name + " as " + AccessName(use.access);
+			if (use.write && IsAttachment(use.access)) uses += " (" + to_string(use.load) + ")";
+		}
+		Log("  %s: %s", pass.name.c_str(), uses.c_str());
+		for (auto& barrier : pass.barriers) Log("    barrier %s", describe(barrier).c_str());
+	}
+	for (auto& barrier : finalBarriers) Log("  end of frame: barrier %s", describe(barrier).c_str());
+}
+
+void RenderGraph::BindImage(Resource resource, vk::Image image, ImageView view)
+{
+	resources[resource].image = image;
+	resources[resource].view = view;
+}
+
+void RenderGraph::BindBuffer(Resource resource, Buffer buffer)
+{
+	resources[resource].buffer = buffer;
+}
+
+vk::Framebuffer RenderGraph::Framebuffer(Pass pass)
+{
+	auto& node = passes[pass];
+	if (!node.renderPass) return nullptr;
+	std::vector<ImageView> views;
+	for (auto& use : node.uses) {
+		if (IsAttachment(use.access)) views.push_back(resources[use.resource].view);
+	}
+	auto key = std::make_pair(node.renderPass, views);
+	auto found = framebuffers.find(key);
+	if (found != framebuffers.end()) return found->second;
+	FramebufferCreateInfo framebufferInfo{};
+	framebufferInfo.sType = StructureType::eFramebufferCreateInfo;
+	framebufferInfo.renderPass = node.renderPass;
+	framebufferInfo.attachmentCount = (uint32_t)views.size();
+	framebufferInfo.pAttachments = views.data();
+	framebufferInfo.width = node.extent.width;
+	framebufferInfo.height = node.extent.height;
+	framebufferInfo.layers = 1;
+	vk::Framebuffer framebuffer;
+	assert(device.createFramebuffer(&framebufferInfo, nullptr, &framebuffer) == Result::eSuccess);
+	deletions->Track(HandleType::Framebuffer);
+	framebuffers.emplace(key, framebuffer);
+	return framebuffer;
+}
+
+CommandBufferInheritanceInfo RenderGraph::Inheritance(Pass pass, CommandBufferInheritanceRenderingInfoKHR& rendering)
+{
+	auto& node = passes[pass];
+	CommandBufferInheritanceInfo inheritanceInfo{};
+	inheritanceInfo.sType = StructureType::eCommandBufferInheritanceInfo;
+	if (dynamicRendering) {
+		rendering = CommandBufferInheritanceRenderingInfoKHR{};
+		rendering.sType = StructureType::eCommandBufferInheritanceRenderingInfoKHR;
+		rendering.colorAttachmentCount = (uint32_t)node.colorFormats.size();
+		rendering.pColorAttachmentFormats = node.colorFormats.data();
+		rendering.depthAttachmentFormat = node.depthFormat;
+		rendering.rasterizationSamples = SampleCountFlagBits::e1;
+		inheritanceInfo.pNext = &rendering;
+	}
+	else {
+		inheritanceInfo.renderPass = node.renderPass;
+		inheritanceInfo.subpass = 0;
+		inheritanceInfo.framebuffer = Framebuffer(pass);
+	}
+	return inheritanceInfo;
+}
+
+void RenderGraph::Execute(CommandBuffer commandBuffer)
+{
+	assert(compiled);
+	for (Pass p = 0; p < passes.size(); p++) {
+		auto& pass = passes[p];
+		if (!pass.live) continue;
+		RecordBarriers(commandBuffer, pass.barriers);
+		PassContext context{ commandBuffer, pass.renderPass, nullptr, RenderArea(pass) };
+		if (pass.raster && dynamicRendering) {
+			BeginRendering(commandBuffer, pass, context.extent);
+			pass.execute(context);
+			commandBuffer.endRenderingKHR();
+		}
+		else if (pass.raster) {
+			context.framebuffer = Framebuffer(p);
+			std::vector<ClearValue> clearValues;
+			for (auto& use : pass.uses) {
+				if (IsAttachment(use.access)) clearValues.push_back(use.clear);
+			}
+			RenderPassBeginInfo renderPassInfo{};
+			renderPassInfo.sType = StructureType::eRenderPassBeginInfo;
+			renderPassInfo.renderPass = pass.renderPass;
+			renderPassInfo.framebuffer = context.framebuffer;
+			renderPassInfo.renderArea.extent = context.extent;
+			renderPassInfo.clearValueCount = (uint32_t)clearValues.size();
+			renderPassInfo.pClearValues = clearValues.data();
+			commandBuffer.beginRenderPass(&renderPassInfo, pass.contents);
+			pass.execute(context);
+			commandBuffer.endRenderPass();
+		}
+		else {
+			pass.execute(context);
+		}
+	}
+	RecordBarriers(commandBuffer, finalBarriers);
+}
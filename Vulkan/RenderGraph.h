@@ -0,0 +1,185 @@
+#pragma once
+#include "DeletionQueue.h"
+#include "MemoryAllocator.h"
+#include <functional>
+#include <map>
+#include <string>
+#include <tuple>
+#include <vector>
+
+// A frame described as passes that declare how they use images and buffers. Compile() orders nothing (passes run
+// in the order they were added) but culls passes whose results never reach an imported resource, derives the
+// barriers and layout transitions between passes, and places transient images with disjoint lifetimes in the same
+// memory. Raster passes begin with dynamic rendering when the device has it and through render pass objects
+// otherwise; those are cached by attachment description, so recompiling after a resize hands out the same handles
+// and pipelines built against them stay valid. Transients and framebuffers a recompile replaces are retired to the
+// deletion queue, so a resize never waits for the frames still using them. The schedule is logged on every compile.
+//
+//   auto color = graph.ImportImage("swapchain", format, extent, acquired, present);
+//   auto main = graph.AddPass("main", [&](const RenderGraph::PassContext& context) { ... });
+//   graph.Write(main, color, RenderGraph::Access::ColorAttachment, vk::AttachmentLoadOp::eClear, clearValue);
+//   graph.Compile();
+//   ...
+//   graph.BindImage(color, image, view);
+//   graph.Execute(commandBuffer);
+class RenderGraph
+{
+public:
+	using Resource = uint32_t;
+	using Pass = uint32_t;
+
+	// How a pass touches a resource; each maps to one stage, access mask and image layout.
+	enum class Access {
+		ColorAttachment,
+		DepthAttachment,
+		// Sampled in the fragment shader.
+		Sampled,
+		TransferSrc,
+		TransferDst
+	};
+	// A point in the frame a resource is synchronized against.
+	struct State {
+		vk::PipelineStageFlags stages;
+		vk::AccessFlags access;
+		vk::ImageLayout layout = vk::ImageLayout::eUndefined;
+	};
+	struct PassContext {
+		vk::CommandBuffer commandBuffer;
+		// Null for passes without attachments and under dynamic rendering; rendering has already begun for any pass
+		// with attachments when it executes.
+		vk::RenderPass renderPass;
+		vk::Framebuffer framebuffer;
+		// The render area of a raster pass.
+		vk::Extent2D extent;
+	};
+	using ExecuteFunction = std::function<void(const PassContext&)>;
+
+private:
+	struct Use {
+		Resource resource;
+		Access access;
+		bool write;
+		vk::AttachmentLoadOp load;
+		vk::ClearValue clear;
+	};
+	struct Barrier {
+		Resource resource;
+		State src;
+		State dst;
+	};
+	struct PassNode {
+		std::string name;
+		ExecuteFunction execute;
+		vk::SubpassContents contents;
+		std::vector<Use> uses;
+		bool live = false;
+		// Has attachments, so it executes inside a render pass or dynamic rendering scope.
+		bool raster = false;
+		vk::RenderPass renderPass;
+		vk::Extent2D extent;
+		// Rendered part of the attachments, from the origin; empty covers them whole.
+		vk::Extent2D renderArea;
+		std::vector<vk::Format> colorFormats;
+		vk::Format depthFormat = vk::Format::eUndefined;
+		std::vector<Barrier> barriers;
+	};
+	// Format, load op and layout of each attachment, in order.
+	using RenderPassKey = std::vector<std::tuple<vk::Format, vk::AttachmentLoadOp, vk::ImageLayout>>;
+	struct ResourceNode {
+		std::string name;
+		bool isImage;
+		bool imported;
+		vk::Format format = vk::Format::eUndefined;
+		vk::Extent2D extent;
+		vk::ImageAspectFlags aspect;
+		vk::ImageUsageFlags usage;
+		// Imported resources: the state before the first pass and the one required after the last.
+		State initial;
+		State final;
+		vk::Image image;
+		vk::ImageView view;
+		vk::Buffer buffer;
+		// Compile results for transients: live pass range and the memory slot shared with other transients.
+		uint32_t firstUse = UINT32_MAX;
+		uint32_t lastUse = 0;
+		uint32_t slot = UINT32_MAX;
+		State lastState;
+	};
+	struct MemorySlot {
+		vk::MemoryRequirements requirements;
+		Allocation allocation;
+		// Transients placed here, ordered by first use.
+		std::vector<Resource> resources;
+	};
+
+	vk::Device device;
+	MemoryAllocator* allocator = nullptr;
+	DeletionQueue* deletions = nullptr;
+	std::vector<PassNode> passes;
+	std::vector<ResourceNode> resources;
+	std::vector<MemorySlot> slots;
+	std::vector<Barrier> finalBarriers;
+	bool dynamicRendering = false;
+	// Outlive Compile() and Reset(); only Destroy() frees them.
+	std::map<RenderPassKey, vk::RenderPass> renderPasses;
+	// Keyed by render pass and attachment views, so each swapchain image gets its own framebuffer.
+	std::map<std::pair<vk::RenderPass, std::vector<vk::ImageView>>, vk::Framebuffer> framebuffers;
+	bool compiled = false;
+
+	static State AccessState(Access access, vk::AttachmentLoadOp load);
+	static bool IsAttachment(Access access) { return access == Access::ColorAttachment || access == Access::DepthAttachment; }
+	void Cull();
+	void AllocateTransients();
+	void CreateRenderPass(PassNode& pass);
+	void BeginRendering(vk::CommandBuffer commandBuffer, const PassNode& pass, vk::Extent2D area) const;
+	static vk::Extent2D RenderArea(const PassNode& pass);
+	void ComputeBarriers();
+	void RecordBarriers(vk::CommandBuffer commandBuffer, const std::vector<Barrier>& barriers) const;
+	void LogSchedule() const;
+	void Release();
+public:
+	// dynamicRendering requires VK_KHR_dynamic_rendering to be enabled on device.
+	void Create(vk::Device device, MemoryAllocator& allocator, DeletionQueue& deletions, bool dynamicRendering = false);
+	// Retires everything the graph created, including its passes and resources, and destroys its render passes.
+	void Destroy();
+	// Drops passes and resources so the frame can be described again, e.g. after a resize.
+	void Reset();
+
+	// Images and buffers owned outside the graph; they are bound every frame and count as the frame's outputs.
+	// initial is the state they are in when the frame starts; final is the state they are left in, where an
+	// empty final state leaves them as the last pass used them.
+	Resource ImportImage(const std::string& name, vk::Format format, vk::Extent2D extent, State initial, State final, vk::ImageAspectFlags aspect = vk::ImageAspectFlagBits::eColor);
+	Resource ImportBuffer(const std::string& name, State initial, State final);
+	// An image that only lives within the frame; its memory may be shared with transients used at other times.
+	Resource CreateImage(const std::string& name, vk::Format format, vk::Extent2D extent, vk::ImageAspectFlags aspect = vk::ImageAspectFlagBits::eColor);
+	// Resizes an image; takes effect at the next Compile().
+	void SetExtent(Resource resource, vk::Extent2D extent);
+
+	Pass AddPass(const std::string& name, ExecuteFunction execute, vk::SubpassContents contents = vk::SubpassContents::eInline);
+	void Read(Pass pass, Resource resource, Access access);
+	// load and clear only apply to attachments.
+	void Write(Pass pass, Resource resource, Access access, vk::AttachmentLoadOp load = vk::AttachmentLoadOp::eDontCare, vk::ClearValue clear = {});
+	// Restricts a raster pass to the top-left area of its attachments from the next Execute() on, without a
+	// recompile; clear and the context's extent follow it. An empty area restores the whole attachments.
+	void SetRenderArea(Pass pass, vk::Extent2D area) { passes[pass].renderArea = area; }
+	void Compile();
+
+	void BindImage(Resource resource, vk::Image image, vk::ImageView view);
+	void BindBuffer(Resource resource, vk::Buffer buffer);
+	// Valid after Compile(); transients are created by the graph, imports return what was bound last.
+	vk::Image Image(Resource resource) const { return resources[resource].image; }
+	vk::ImageView View(Resource resource) const { return resources[resource].view; }
+	// Null under dynamic rendering; pipelines then target the pass's attachment formats instead.
+	vk::RenderPass RenderPass(Pass pass) const { return passes[pass].renderPass; }
+	const std::vector<vk::Format>& ColorFormats(Pass pass) const { return passes[pass].colorFormats; }
+	vk::Format DepthFormat(Pass pass) const { return passes[pass].depthFormat; }
+	bool DynamicRendering() const { return dynamicRendering; }
+	// The framebuffer for the pass's currently bound attachments, created on first use; null under dynamic rendering.
+	vk::Framebuffer Framebuffer(Pass pass);
+	// What secondaries executed inside pass inherit. Under dynamic rendering it chains rendering, which must stay
+	// alive while the returned info is used.
+	vk::CommandBufferInheritanceInfo Inheritance(Pass pass, vk::CommandBufferInheritanceRenderingInfoKHR& rendering);
+	bool IsLive(Pass pass) const { return passes[pass].live; }
+	// Records every live pass and its barriers.
+	void Execute(vk::CommandBuffer commandBuffer);
+};
@@ -0,0 +1,142 @@
+#include "Shaders.h"
+#include "Log.h"
+#include "Trace.h"
+#include "vs.spv.h"
+#include "ps.spv.h"
+#include "particles.spv.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+
+namespace fs = std::filesystem;
+
+static const char* const sources[] = { "vs.hlsl", "ps.hlsl", "header.hlsli" };
+
+SpirvCode EmbeddedVertexShader()
+{
+	return { vsSpirv, sizeof(vsSpirv) };
+}
+
+SpirvCode EmbeddedPixelShader()
+{
+	return { psSpirv, sizeof(psSpirv) };
+}
+
+SpirvCode EmbeddedParticleShader()
+{
+	return { particlesSpirv, sizeof(particlesSpirv) };
+}
+
+std::string ShaderSourceDirectory()
+{
+	return fs::path(__FILE__).parent_path().string();
+}
+
+static std::string Compiler()
+{
+	for (auto variable : { "VULKAN_SDK", "VK_SDK_PATH" }) {
+		auto root = std::getenv(variable);
+		if (!root) continue;
+#ifdef _WIN32
+		auto dxc = fs::path(root) / "Bin" / "dxc.exe";
+#else
+		auto dxc = fs::path(root) / "bin" / "dxc";
+#endif
+		if (fs::exists(dxc)) return dxc.string();
+	}
+	return "dxc";
+}
+
+// Compiles one entry point to SPIR-V with the same flags as the build; empty on failure.
+static std::vector<uint32_t> CompileShader(const std::string& compiler, const fs::path& source, const char* profile)
+{
+	auto output = fs::temp_directory_path() / (source.stem().string() + ".reload.spv");
+	std::error_code error;
+	fs::remove(output, error);
+	std::string command = "\"" + compiler + "\" -spirv -E main -Od -T " + profile + " -nologo -Fo \"" + output.string() + "\" \"" + source.string() + "\"";
+#ifdef _WIN32
+	// cmd.exe strips the outer quotes of a command line that starts with one.
+	command = "\"" + command + "\"";
+#endif
+	if (std::system(command.c_str()) != 0) return {};
+	std::ifstream file(output, std::ios::binary | std::ios::ate);
+	if (!file.is_open()) return {};
+	auto size = (size_t)file.tellg();
+	if (size == 0 || size % sizeof(uint32_t)) return {};
+	std::vector<uint32_t> words(size / sizeof(uint32_t));
+	file.seekg(0);
+	file.read(reinterpret_cast<char*>(words.data()), size);
+	return words;
+}
+
+ShaderWatcher::ShaderWatcher(const std::string& directory) : directory(directory)
+{
+	thread = std::thread(&ShaderWatcher::Run, this);
+}
+
+ShaderWatcher::~ShaderWatcher()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	thread.join();
+}
+
+void ShaderWatcher::Run()
+{
+	Trace::SetThreadName("shaders");
+	auto compiler = Compiler();
+	Log("shader hot reload: watching %s with %s", directory.c_str(), compiler.c_str());
+	auto lastWrite = [&] {
+		fs::file_time_type newest{};
+		std::error_code error;
+		for (auto name : sources) {
+			auto time = fs::last_write_time(fs::path(directory) / name, error);
+			if (!error && time > newest) newest = time;
+		}
+		return newest;
+	};
+	auto seen = lastWrite();
+	std::unique_lock<std::mutex> lock(mutex);
+	for (;;) {
+		if (wake.wait_for(lock, std::chrono::milliseconds(250), [&] { return stopping; })) return;
+		lock.unlock();
+		auto newest = lastWrite();
+		if (newest == seen) {
+			lock.lock();
+			continue;
+		}
+		seen = newest;
+		auto start = std::chrono::steady_clock::now();
+		std::vector<uint32_t> vertexCode, pixelCode;
+		{
+			TraceScope trace("compileShaders");
+			vertexCode = CompileShader(compiler, fs::path(directory) / "vs.hlsl", "vs_6_4");
+			if (!vertexCode.empty()) pixelCode = CompileShader(compiler, fs::path(directory) / "ps.hlsl", "ps_6_4");
+		}
+		double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		lock.lock();
+		if (vertexCode.empty() || pixelCode.empty()) {
+			Log("shader hot reload: compilation failed, keeping the running shaders");
+			continue;
+		}
+		Log("shader hot reload: recompiled in %.1fms", elapsed);
+		vertex = std::move(vertexCode);
+		pixel = std::move(pixelCode);
+		ready = true;
+	}
+}
+
+bool ShaderWatcher::Take(std::vector<uint32_t>& vertex, std::vector<uint32_t>& pixel)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (!ready) return false;
+	vertex = std::move(this->vertex);
+	pixel = std::move(this->pixel);
+	ready = false;
+	return true;
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// SPIR-V words and their size in bytes, the way vk::ShaderModuleCreateInfo takes them.
+struct SpirvCode {
+	const uint32_t* words = nullptr;
+	size_t size = 0;
+};
+
+// vs.hlsl, ps.hlsl and particles.hlsl as compiled into the executable by the build.
+SpirvCode EmbeddedVertexShader();
+SpirvCode EmbeddedPixelShader();
+SpirvCode EmbeddedParticleShader();
+// Where the shader sources lived when the executable was built.
+std::string ShaderSourceDirectory();
+
+// Development aid: polls the shader sources, recompiles them with dxc on its own thread when any of them
+// changes, and holds the result until the render loop picks it up at a frame boundary. Compile errors are
+// logged and leave the running shaders in place.
+class ShaderWatcher
+{
+	std::string directory;
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable wake;
+	bool stopping = false;
+	bool ready = false;
+	std::vector<uint32_t> vertex;
+	std::vector<uint32_t> pixel;
+
+	void Run();
+public:
+	explicit ShaderWatcher(const std::string& directory);
+	~ShaderWatcher();
+	ShaderWatcher(const ShaderWatcher&) = delete;
+	ShaderWatcher& operator=(const ShaderWatcher&) = delete;
+	// Moves out the newest successfully recompiled pair, once; false when nothing new is ready.
+	bool Take(std::vector<uint32_t>& vertex, std::vector<uint32_t>& pixel);
+};
@@ -0,0 +1,269 @@
+#include "SimdMath.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define SIMD_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+// MSVC emits any intrinsic regardless of /arch, so the AVX2 kernels need no special treatment.
+#define SIMD_TARGET_AVX2
+#else
+#define SIMD_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
+#else
+#define SIMD_X86 0
+#endif
+
+Sphere SphereFromBox(const float boundsMin[3], const float boundsMax[3])
+{
+	float extent[3];
+	for (int i = 0; i < 3; i++) extent[i] = (boundsMax[i] - boundsMin[i]) * 0.5f;
+	return { (boundsMin[0] + boundsMax[0]) * 0.5f, (boundsMin[1] + boundsMax[1]) * 0.5f, (boundsMin[2] + boundsMax[2]) * 0.5f,
+		std::sqrt(extent[0] * extent[0] + extent[1] * extent[1] + extent[2] * extent[2]) };
+}
+
+Affine3 Affine3::Identity()
+{
+	return ScaleTranslate({ 1, 1, 1 }, { 0, 0, 0 });
+}
+
+Affine3 Affine3::ScaleTranslate(Float3 scale, Float3 translation)
+{
+	return { { { scale.x, 0, 0, translation.x }, { 0, scale.y, 0, translation.y }, { 0, 0, scale.z, translation.z } } };
+}
+
+Affine3 Affine3::operator*(const Affine3& other) const
+{
+	Affine3 result;
+	for (int r = 0; r < 3; r++) {
+		for (int c = 0; c < 4; c++) {
+			result.m[r][c] = m[r][0] * other.m[0][c] + m[r][1] * other.m[1][c] + m[r][2] * other.m[2][c] + (c == 3 ? m[r][3] : 0.0f);
+		}
+	}
+	return result;
+}
+
+Sphere Affine3::operator*(const Sphere& sphere) const
+{
+	return { m[0][0] * sphere.x + m[0][1] * sphere.y + m[0][2] * sphere.z + m[0][3],
+		m[1][0] * sphere.x + m[1][1] * sphere.y + m[1][2] * sphere.z + m[1][3],
+		m[2][0] * sphere.x + m[2][1] * sphere.y + m[2][2] * sphere.z + m[2][3],
+		sphere.radius * MaxScale() };
+}
+
+float Affine3::MaxScale() const
+{
+	// The largest column length bounds the stretch of orthogonal and axis-scaled transforms exactly and of
+	// sheared ones within a factor of sqrt(3); the frame only ever uses the former.
+	float largest = 0;
+	for (int c = 0; c < 3; c++) largest = std::max(largest, m[0][c] * m[0][c] + m[1][c] * m[1][c] + m[2][c] * m[2][c]);
+	return std::sqrt(largest);
+}
+
+void SphereSoA::Resize(size_t count)
+{
+	x.resize(count);
+	y.resize(count);
+	z.resize(count);
+	radius.resize(count);
+}
+
+void SphereSoA::Push(const Sphere& sphere)
+{
+	x.push_back(sphere.x);
+	y.push_back(sphere.y);
+	z.push_back(sphere.z);
+	radius.push_back(sphere.radius);
+}
+
+std::array<Plane, 6> ClipVolumePlanes()
+{
+	return { { { 1, 0, 0, 1 }, { -1, 0, 0, 1 }, { 0, 1, 0, 1 }, { 0, -1, 0, 1 }, { 0, 0, 1, 0 }, { 0, 0, -1, 1 } } };
+}
+
+const char* SimdLevelName(SimdLevel level)
+{
+	switch (level)
+	{
+	case SimdLevel::Scalar: return "scalar";
+	case SimdLevel::SSE2: return "sse2";
+	case SimdLevel::AVX2: return "avx2";
+	default: return "unknown";
+	}
+}
+
+SimdLevel DetectSimdLevel()
+{
+#if SIMD_X86
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7) return SimdLevel::SSE2;
+	__cpuid(info, 1);
+	bool fma = info[2] & (1 << 12);
+	// AVX state must also be enabled by the OS, which XGETBV reports.
+	bool osAvx = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 6) == 6;
+	__cpuidex(info, 7, 0);
+	bool avx2 = info[1] & (1 << 5);
+	return avx2 && fma && osAvx ? SimdLevel::AVX2 : SimdLevel::SSE2;
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") ? SimdLevel::AVX2 : SimdLevel::SSE2;
+#endif
+#else
+	return SimdLevel::Scalar;
+#endif
+}
+
+namespace {
+	void TransformScalar(const SphereSoA& in, const Affine3& t, SphereSoA& out, size_t begin, size_t end)
+	{
+		auto& m = t.m;
+		float scale = t.MaxScale();
+		for (size_t i = begin; i < end; i++) {
+			float x = in.x[i], y = in.y[i], z = in.z[i];
+			out.x[i] = m[0][0] * x + m[0][1] * y + m[0][2] * z + m[0][3];
+			out.y[i] = m[1][0] * x + m[1][1] * y + m[1][2] * z + m[1][3];
+			out.z[i] = m[2][0] * x + m[2][1] * y + m[2][2] * z + m[2][3];
+			out.radius[i] = in.radius[i] * scale;
+		}
+	}
+
+	size_t CullScalar(const SphereSoA& spheres, const Plane* planes, size_t planeCount, size_t begin, size_t end, uint32_t* visible)
+	{
+		size_t count = 0;
+		for (size_t i = begin; i < end; i++) {
+			bool inside = true;
+			for (size_t p = 0; p < planeCount && inside; p++) {
+				auto& plane = planes[p];
+				inside = plane.x * spheres.x[i] + plane.y * spheres.y[i] + plane.z * spheres.z[i] + plane.w + spheres.radius[i] >= 0;
+			}
+			if (inside) visible[count++] = (uint32_t)i;
+		}
+		return count;
+	}
+
+#if SIMD_X86
+	inline uint32_t LowestBit(uint32_t bits)
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward(&index, bits);
+		return index;
+#else
+		return (uint32_t)__builtin_ctz(bits);
+#endif
+	}
+
+	// Appends base + the index of every set bit of mask.
+	inline size_t AppendLanes(uint32_t mask, size_t base, uint32_t* visible, size_t count)
+	{
+		while (mask) {
+			visible[count++] = (uint32_t)base + LowestBit(mask);
+			mask &= mask - 1;
+		}
+		return count;
+	}
+
+	void TransformSSE2(const SphereSoA& in, const Affine3& t, SphereSoA& out, size_t begin, size_t end)
+	{
+		__m128 m[3][4];
+		for (int r = 0; r < 3; r++) {
+			for (int c = 0; c < 4; c++) m[r][c] = _mm_set1_ps(t.m[r][c]);
+		}
+		__m128 scale = _mm_set1_ps(t.MaxScale());
+		size_t i = begin;
+		for (; i + 4 <= end; i += 4) {
+			__m128 x = _mm_loadu_ps(&in.x[i]), y = _mm_loadu_ps(&in.y[i]), z = _mm_loadu_ps(&in.z[i]);
+			float* outputs[] = { &out.x[i], &out.y[i], &out.z[i] };
+			for (int r = 0; r < 3; r++) {
+				__m128 value = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[r][0], x), _mm_mul_ps(m[r][1], y)), _mm_add_ps(_mm_mul_ps(m[r][2], z), m[r][3]));
+				_mm_storeu_ps(outputs[r], value);
+			}
+			_mm_storeu_ps(&out.radius[i], _mm_mul_ps(_mm_loadu_ps(&in.radius[i]), scale));
+		}
+		TransformScalar(in, t, out, i, end);
+	}
+
+	size_t CullSSE2(const SphereSoA& spheres, const Plane* planes, size_t planeCount, size_t begin, size_t end, uint32_t* visible)
+	{
+		size_t count = 0;
+		size_t i = begin;
+		__m128 zero = _mm_setzero_ps();
+		for (; i + 4 <= end; i += 4) {
+			__m128 x = _mm_loadu_ps(&spheres.x[i]), y = _mm_loadu_ps(&spheres.y[i]), z = _mm_loadu_ps(&spheres.z[i]);
+			__m128 radius = _mm_loadu_ps(&spheres.radius[i]);
+			__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+			for (size_t p = 0; p < planeCount; p++) {
+				auto& plane = planes[p];
+				__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.x), x), _mm_mul_ps(_mm_set1_ps(plane.y), y)),
+					_mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.z), z), _mm_add_ps(_mm_set1_ps(plane.w), radius)));
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, zero));
+			}
+			count = AppendLanes((uint32_t)_mm_movemask_ps(inside), i, visible, count);
+		}
+		return count + CullScalar(spheres, planes, planeCount, i, end, visible + count);
+	}
+
+	SIMD_TARGET_AVX2 void TransformAVX2(const SphereSoA& in, const Affine3& t, SphereSoA& out, size_t begin, size_t end)
+	{
+		__m256 m[3][4];
+		for (int r = 0; r < 3; r++) {
+			for (int c = 0; c < 4; c++) m[r][c] = _mm256_set1_ps(t.m[r][c]);
+		}
+		__m256 scale = _mm256_set1_ps(t.MaxScale());
+		size_t i = begin;
+		for (; i + 8 <= end; i += 8) {
+			__m256 x = _mm256_loadu_ps(&in.x[i]), y = _mm256_loadu_ps(&in.y[i]), z = _mm256_loadu_ps(&in.z[i]);
+			float* outputs[] = { &out.x[i], &out.y[i], &out.z[i] };
+			for (int r = 0; r < 3; r++) {
+				__m256 value = _mm256_fmadd_ps(m[r][0], x, _mm256_fmadd_ps(m[r][1], y, _mm256_fmadd_ps(m[r][2], z, m[r][3])));
+				_mm256_storeu_ps(outputs[r], value);
+			}
+			_mm256_storeu_ps(&out.radius[i], _mm256_mul_ps(_mm256_loadu_ps(&in.radius[i]), scale));
+		}
+		TransformScalar(in, t, out, i, end);
+	}
+
+	SIMD_TARGET_AVX2 size_t CullAVX2(const SphereSoA& spheres, const Plane* planes, size_t planeCount, size_t begin, size_t end, uint32_t* visible)
+	{
+		size_t count = 0;
+		size_t i = begin;
+		__m256 zero = _mm256_setzero_ps();
+		for (; i + 8 <= end; i += 8) {
+			__m256 x = _mm256_loadu_ps(&spheres.x[i]), y = _mm256_loadu_ps(&spheres.y[i]), z = _mm256_loadu_ps(&spheres.z[i]);
+			__m256 radius = _mm256_loadu_ps(&spheres.radius[i]);
+			__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+			for (size_t p = 0; p < planeCount; p++) {
+				auto& plane = planes[p];
+				__m256 distance = _mm256_fmadd_ps(_mm256_set1_ps(plane.x), x,
+					_mm256_fmadd_ps(_mm256_set1_ps(plane.y), y, _mm256_fmadd_ps(_mm256_set1_ps(plane.z), z, _mm256_add_ps(_mm256_set1_ps(plane.w), radius))));
+				inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, zero, _CMP_GE_OQ));
+			}
+			count = AppendLanes((uint32_t)_mm256_movemask_ps(inside), i, visible, count);
+		}
+		return count + CullScalar(spheres, planes, planeCount, i, end, visible + count);
+	}
+#endif
+}
+
+void TransformSpheres(SimdLevel level, const SphereSoA& in, const Affine3& m, SphereSoA& out, size_t begin, size_t end)
+{
+#if SIMD_X86
+	if (level == SimdLevel::AVX2) return TransformAVX2(in, m, out, begin, end);
+	if (level == SimdLevel::SSE2) return TransformSSE2(in, m, out, begin, end);
+#endif
+	TransformScalar(in, m, out, begin, end);
+}
+
+size_t CullSpheres(SimdLevel level, const SphereSoA& spheres, const Plane* planes, size_t planeCount, size_t begin, size_t end, uint32_t* visible)
+{
+#if SIMD_X86
+	if (level == SimdLevel::AVX2) return CullAVX2(spheres, planes, planeCount, begin, end, visible);
+	if (level == SimdLevel::SSE2) return CullSSE2(spheres, planes, planeCount, begin, end, visible);
+#endif
+	return CullScalar(spheres, planes, planeCount, begin, end, visible);
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Plain storage types laid out like float3 and float4 in HLSL, for data shared with shaders.
+struct Float3 {
+	float x, y, z;
+};
+
+struct Float4 {
+	float x, y, z, w;
+};
+
+struct Sphere {
+	float x, y, z, radius;
+};
+
+// The sphere around an axis-aligned box.
+Sphere SphereFromBox(const float boundsMin[3], const float boundsMax[3]);
+
+// Row-major 3x4 affine transform: p' = m * (p, 1).
+struct Affine3 {
+	float m[3][4];
+
+	static Affine3 Identity();
+	// Per-axis scale followed by a translation.
+	static Affine3 ScaleTranslate(Float3 scale, Float3 translation);
+	Affine3 operator*(const Affine3& other) const;
+	Sphere operator*(const Sphere& sphere) const;
+	// The most the transform stretches any length, which carries radii through it conservatively.
+	float MaxScale() const;
+};
+
+// Spheres stored as structure of arrays, so a kernel loads the same component of 4 or 8 consecutive spheres with one
+// instruction.
+struct SphereSoA {
+	std::vector<float> x;
+	std::vector<float> y;
+	std::vector<float> z;
+	std::vector<float> radius;
+
+	size_t Size() const { return x.size(); }
+	void Resize(size_t count);
+	void Push(const Sphere& sphere);
+	void Clear() { Resize(0); }
+};
+
+// A half space: points p with dot(xyz, p) + w >= 0 are inside.
+using Plane = Float4;
+// Vulkan's clip volume with an orthographic projection: x and y in [-1, 1], z in [0, 1].
+std::array<Plane, 6> ClipVolumePlanes();
+
+// Instruction sets the kernels are written for. Every level is compiled in on x86 and picked at runtime, so one
+// binary runs everywhere and can compare them; other architectures only have the scalar one.
+enum class SimdLevel {
+	Scalar,
+	SSE2,
+	AVX2
+};
+
+const char* SimdLevelName(SimdLevel level);
+// The widest level this CPU supports.
+SimdLevel DetectSimdLevel();
+
+// Transforms spheres [begin, end) of in by m into the same positions of out, which must be at least as large.
+void TransformSpheres(SimdLevel level, const SphereSoA& in, const Affine3& m, SphereSoA& out, size_t begin, size_t end);
+// Writes the indices of spheres [begin, end) that reach the inside of every plane to visible, in ascending order,
+// and returns how many there are. visible must have room for end - begin indices.
+size_t CullSpheres(SimdLevel level, const SphereSoA& spheres, const Plane* planes, size_t planeCount, size_t begin, size_t end, uint32_t* visible);
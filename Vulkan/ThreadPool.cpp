@@ -0,0 +1,79 @@
+#include "ThreadPool.h"
+#include "Trace.h"
+
+ThreadPool::ThreadPool(size_t threadCount)
+{
+	for (size_t i = 0; i < threadCount; i++) threads.emplace_back(&ThreadPool::Worker, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (auto& thread : threads) thread.join();
+}
+
+void ThreadPool::Worker()
+{
+	Trace::SetThreadName("worker");
+	std::unique_lock<std::mutex> lock(mutex);
+	for (;;) {
+		wake.wait(lock, [&] { return stopping || next < jobCount || !background.empty(); });
+		if (stopping) return;
+		if (next == jobCount) {
+			auto task = std::move(background.front());
+			background.pop_front();
+			lock.unlock();
+			task();
+			lock.lock();
+			continue;
+		}
+		size_t index = next++;
+		auto task = job;
+		lock.unlock();
+		(*task)(index);
+		lock.lock();
+		if (--remaining == 0) done.notify_all();
+	}
+}
+
+void ThreadPool::ParallelFor(size_t count, const std::function<void(size_t)>& task)
+{
+	if (threads.empty() || count <= 1) {
+		for (size_t i = 0; i < count; i++) task(i);
+		return;
+	}
+	std::unique_lock<std::mutex> lock(mutex);
+	job = &task;
+	jobCount = count;
+	next = 0;
+	remaining = count;
+	wake.notify_all();
+	while (next < jobCount) {
+		size_t index = next++;
+		lock.unlock();
+		task(index);
+		lock.lock();
+		remaining--;
+	}
+	done.wait(lock, [&] { return remaining == 0; });
+	job = nullptr;
+	jobCount = 0;
+	next = 0;
+}
+
+void ThreadPool::Submit(std::function<void()> task)
+{
+	if (threads.empty()) {
+		task();
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		background.push_back(std::move(task));
+	}
+	wake.notify_one();
+}
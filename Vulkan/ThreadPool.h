@@ -0,0 +1,38 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads for fork/join work and background jobs. ParallelFor must only be called from one
+// thread at a time; Submit may be called from any thread, including from a job.
+class ThreadPool
+{
+	std::vector<std::thread> threads;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+	const std::function<void(size_t)>* job = nullptr;
+	size_t jobCount = 0;
+	size_t next = 0;
+	size_t remaining = 0;
+	std::deque<std::function<void()>> background;
+	bool stopping = false;
+
+	void Worker();
+public:
+	explicit ThreadPool(size_t threadCount = 0);
+	~ThreadPool();
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+	// Worker threads plus the calling thread, which takes tasks too while it waits.
+	size_t Concurrency() const { return threads.size() + 1; }
+	// Runs task(0) .. task(count - 1) across the pool and returns once all of them finished.
+	void ParallelFor(size_t count, const std::function<void(size_t)>& task);
+	// Runs task on the next idle worker; ParallelFor tasks go first. Without workers task runs before Submit returns.
+	// Jobs not started by the time the pool is destroyed are dropped.
+	void Submit(std::function<void()> task);
+};
@@ -0,0 +1,134 @@
+#include "Trace.h"
+#include <chrono>
+#include <fstream>
+
+namespace {
+	struct Event {
+		const char* name;
+		int64_t begin;
+		int64_t end;
+		bool gpu;
+	};
+
+	// Filled only by the owning thread; count is published with release so Write sees complete events.
+	struct Chunk {
+		static constexpr size_t Capacity = 4096;
+		Event events[Capacity];
+		std::atomic<size_t> count{ 0 };
+		std::atomic<Chunk*> next{ nullptr };
+	};
+
+	struct ThreadBuffer {
+		uint32_t id = 0;
+		std::atomic<const char*> name{ nullptr };
+		Chunk* first = nullptr;
+		Chunk* last = nullptr;
+		ThreadBuffer* next = nullptr;
+	};
+
+	// Buffers are pushed with a CAS and never freed, so a thread that exits leaves its events behind for Write.
+	std::atomic<ThreadBuffer*> threads{ nullptr };
+	std::atomic<uint32_t> threadCount{ 0 };
+	const auto epoch = std::chrono::steady_clock::now();
+	thread_local ThreadBuffer* local = nullptr;
+	thread_local const char* localName = nullptr;
+
+	ThreadBuffer& LocalBuffer()
+	{
+		if (local == nullptr) {
+			local = new ThreadBuffer();
+			local->id = threadCount.fetch_add(1, std::memory_order_relaxed) + 1;
+			local->name.store(localName, std::memory_order_relaxed);
+			local->first = local->last = new Chunk();
+			local->next = threads.load(std::memory_order_relaxed);
+			while (!threads.compare_exchange_weak(local->next, local, std::memory_order_release, std::memory_order_relaxed));
+		}
+		return *local;
+	}
+
+	void Append(const char* name, int64_t begin, int64_t end, bool gpu)
+	{
+		auto& buffer = LocalBuffer();
+		auto chunk = buffer.last;
+		size_t count = chunk->count.load(std::memory_order_relaxed);
+		if (count == Chunk::Capacity) {
+			auto next = new Chunk();
+			chunk->next.store(next, std::memory_order_release);
+			buffer.last = chunk = next;
+			count = 0;
+		}
+		chunk->events[count] = { name, begin, end, gpu };
+		chunk->count.store(count + 1, std::memory_order_release);
+	}
+
+	void WriteString(std::ostream& out, const char* text)
+	{
+		out << '"';
+		for (; *text; text++) {
+			if (*text == '"' || *text == '\\') out << '\\';
+			out << *text;
+		}
+		out << '"';
+	}
+}
+
+void Trace::Start()
+{
+	enabled.store(true, std::memory_order_relaxed);
+}
+
+void Trace::Stop()
+{
+	enabled.store(false, std::memory_order_relaxed);
+}
+
+int64_t Trace::Now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+void Trace::Record(const char* name, int64_t begin, int64_t end)
+{
+	Append(name, begin, end, false);
+}
+
+void Trace::RecordGpu(const char* name, int64_t begin, int64_t end)
+{
+	Append(name, begin, end, true);
+}
+
+void Trace::SetThreadName(const char* name)
+{
+	localName = name;
+	if (local) local->name.store(name, std::memory_order_relaxed);
+}
+
+bool Trace::Write(const std::string& path)
+{
+	std::ofstream out(path);
+	if (!out.is_open()) return false;
+	out.setf(std::ios::fixed);
+	out.precision(3);
+	out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"CPU\"}},\n";
+	out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":2,\"tid\":0,\"args\":{\"name\":\"GPU\"}}";
+	for (auto buffer = threads.load(std::memory_order_acquire); buffer; buffer = buffer->next) {
+		if (auto name = buffer->name.load(std::memory_order_relaxed)) {
+			out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->id << ",\"args\":{\"name\":";
+			WriteString(out, name);
+			out << "}}";
+		}
+		for (auto chunk = buffer->first; chunk; chunk = chunk->next.load(std::memory_order_acquire)) {
+			size_t count = chunk->count.load(std::memory_order_acquire);
+			for (size_t i = 0; i < count; i++) {
+				auto& event = chunk->events[i];
+				out << ",\n{\"name\":";
+				WriteString(out, event.name);
+				out << ",\"ph\":\"X\",\"pid\":" << (event.gpu ? 2 : 1) << ",\"tid\":" << (event.gpu ? 0 : buffer->id)
+					<< ",\"ts\":" << event.begin / 1000.0 << ",\"dur\":" << (event.end - event.begin) / 1000.0 << "}";
+			}
+		}
+	}
+	out << "\n]}\n";
+	return out.good();
+}
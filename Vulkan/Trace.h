@@ -0,0 +1,57 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Process-wide recorder of named CPU scopes and GPU ranges, written out as Chrome trace JSON (chrome://tracing, Perfetto).
+// Every thread appends to its own buffer without locks; while recording is off a scope costs one relaxed load.
+// Names are stored by pointer and must outlive the trace, so pass string literals.
+namespace Trace {
+	inline std::atomic<bool> enabled{ false };
+
+	inline bool Enabled() { return enabled.load(std::memory_order_relaxed); }
+	void Start();
+	void Stop();
+	// Nanoseconds on the steady clock the trace is timestamped with.
+	int64_t Now();
+	void Record(const char* name, int64_t begin, int64_t end);
+	// GPU ranges already converted to the trace clock; they are written to a separate GPU track.
+	void RecordGpu(const char* name, int64_t begin, int64_t end);
+	// Labels the calling thread in the trace; cheap enough to call unconditionally.
+	void SetThreadName(const char* name);
+	// Writes everything recorded so far. Safe while other threads keep recording.
+	bool Write(const std::string& path);
+}
+
+class TraceScope
+{
+	const char* name;
+	int64_t begin;
+public:
+	explicit TraceScope(const char* name) : name(Trace::Enabled() ? name : nullptr), begin(this->name ? Trace::Now() : 0) {}
+	~TraceScope() { if (name) Trace::Record(name, begin, Trace::Now()); }
+	TraceScope(const TraceScope&) = delete;
+	TraceScope& operator=(const TraceScope&) = delete;
+};
+
+// Consecutive scopes in one block, such as the phases of a constructor: each Next closes the previous phase.
+class TracePhases
+{
+	const char* name = nullptr;
+	int64_t begin = 0;
+public:
+	void Next(const char* phase)
+	{
+		End();
+		if (Trace::Enabled()) {
+			name = phase;
+			begin = Trace::Now();
+		}
+	}
+	void End()
+	{
+		if (name) Trace::Record(name, begin, Trace::Now());
+		name = nullptr;
+	}
+	~TracePhases() { End(); }
+};
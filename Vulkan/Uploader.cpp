@@ -0,0 +1,220 @@
+#include "Uploader.h"
+#ifdef _DEBUG
+#include <cassert>
+#else
+#define assert(X) (void)(X)
+#endif
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+using namespace vk;
+
+static constexpr DeviceSize StagingAlignment = 16;
+
+void Uploader::Create(Device device, MemoryAllocator& allocator, Queue graphicsQueue, uint32_t graphicsFamily, Queue transferQueue, uint32_t transferFamily, DeviceSize ringSize)
+{
+	this->device = device;
+	this->allocator = &allocator;
+	this->graphicsQueue = graphicsQueue;
+	this->graphicsFamily = graphicsFamily;
+	this->transferQueue = transferQueue;
+	this->transferFamily = transferFamily;
+	capacity = ringSize;
+	BufferCreateInfo bufferInfo{};
+	bufferInfo.sType = StructureType::eBufferCreateInfo;
+	bufferInfo.size = capacity;
+	bufferInfo.usage = BufferUsageFlagBits::eTransferSrc;
+	bufferInfo.sharingMode = SharingMode::eExclusive;
+	assert(device.createBuffer(&bufferInfo, nullptr, &staging) == Result::eSuccess);
+	stagingAllocation = allocator.AllocateBuffer(staging, MemoryPropertyFlagBits::eHostVisible | MemoryPropertyFlagBits::eHostCoherent);
+	CommandPoolCreateInfo poolInfo{};
+	poolInfo.sType = StructureType::eCommandPoolCreateInfo;
+	poolInfo.flags = CommandPoolCreateFlagBits::eResetCommandBuffer | CommandPoolCreateFlagBits::eTransient;
+	poolInfo.queueFamilyIndex = transferFamily;
+	assert(device.createCommandPool(&poolInfo, nullptr, &transferPool) == Result::eSuccess);
+	if (SeparateFamilies()) {
+		poolInfo.queueFamilyIndex = graphicsFamily;
+		assert(device.createCommandPool(&poolInfo, nullptr, &graphicsPool) == Result::eSuccess);
+	}
+}
+
+void Uploader::Destroy()
+{
+	WaitIdle();
+	for (auto& batch : spare) {
+		device.freeCommandBuffers(transferPool, 1, &batch.transfer);
+		if (batch.acquire) device.freeCommandBuffers(graphicsPool, 1, &batch.acquire);
+		if (batch.semaphore) device.destroySemaphore(batch.semaphore, nullptr);
+		device.destroyFence(batch.fence, nullptr);
+	}
+	spare.clear();
+	if (graphicsPool) device.destroyCommandPool(graphicsPool, nullptr);
+	device.destroyCommandPool(transferPool, nullptr);
+	device.destroyBuffer(staging, nullptr);
+	allocator->Free(stagingAllocation);
+}
+
+DeviceSize Uploader::Reserve(DeviceSize size)
+{
+	if (size > capacity) throw std::runtime_error("upload does not fit in the staging ring!");
+	for (;;) {
+		bool empty = inFlight.empty() && !recording;
+		if (empty) head = tail = 0;
+		if (empty || head > tail) {
+			if (head + size <= capacity) {
+				auto offset = head;
+				head += size;
+				return offset;
+			}
+			// Wrap around; the bytes between head and the end of the ring come back when tail passes them.
+			if (size <= tail) {
+				head = size;
+				return 0;
+			}
+		}
+		else if (head < tail && head + size <= tail) {
+			auto offset = head;
+			head += size;
+			return offset;
+		}
+		if (recording) Flush();
+		RetireOldest();
+	}
+}
+
+void Uploader::Begin()
+{
+	if (recording) return;
+	if (!spare.empty()) {
+		pending = spare.back();
+		spare.pop_back();
+	}
+	else {
+		pending = {};
+		CommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = StructureType::eCommandBufferAllocateInfo;
+		allocInfo.commandPool = transferPool;
+		allocInfo.level = CommandBufferLevel::ePrimary;
+		allocInfo.commandBufferCount = 1;
+		assert(device.allocateCommandBuffers(&allocInfo, &pending.transfer) == Result::eSuccess);
+		if (SeparateFamilies()) {
+			allocInfo.commandPool = graphicsPool;
+			assert(device.allocateCommandBuffers(&allocInfo, &pending.acquire) == Result::eSuccess);
+			SemaphoreCreateInfo semaphoreInfo{};
+			semaphoreInfo.sType = StructureType::eSemaphoreCreateInfo;
+			assert(device.createSemaphore(&semaphoreInfo, nullptr, &pending.semaphore) == Result::eSuccess);
+		}
+		FenceCreateInfo fenceInfo{};
+		fenceInfo.sType = StructureType::eFenceCreateInfo;
+		assert(device.createFence(&fenceInfo, nullptr, &pending.fence) == Result::eSuccess);
+	}
+	CommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = StructureType::eCommandBufferBeginInfo;
+	beginInfo.flags = CommandBufferUsageFlagBits::eOneTimeSubmit;
+	assert(pending.transfer.begin(&beginInfo) == Result::eSuccess);
+	recording = true;
+}
+
+void Uploader::UploadBuffer(Buffer dst, DeviceSize dstOffset, const void* data, DeviceSize size, PipelineStageFlags dstStage, AccessFlags dstAccess)
+{
+	auto bytes = static_cast<const uint8_t*>(data);
+	// Quarter-ring pieces keep the transfer queue busy on one piece while the CPU fills the next.
+	DeviceSize piece = std::max<DeviceSize>(capacity / 4, StagingAlignment);
+	while (size > 0) {
+		auto count = std::min(size, piece);
+		auto offset = Reserve((count + StagingAlignment - 1) / StagingAlignment * StagingAlignment);
+		Begin();
+		memcpy(static_cast<uint8_t*>(stagingAllocation.mapped) + offset, bytes, (size_t)count);
+		BufferCopy region{};
+		region.srcOffset = offset;
+		region.dstOffset = dstOffset;
+		region.size = count;
+		pending.transfer.copyBuffer(staging, dst, 1, &region);
+		BufferMemoryBarrier barrier{};
+		barrier.sType = StructureType::eBufferMemoryBarrier;
+		barrier.srcAccessMask = AccessFlagBits::eTransferWrite;
+		barrier.buffer = dst;
+		barrier.offset = dstOffset;
+		barrier.size = count;
+		if (SeparateFamilies()) {
+			barrier.srcQueueFamilyIndex = transferFamily;
+			barrier.dstQueueFamilyIndex = graphicsFamily;
+			pending.transfer.pipelineBarrier(PipelineStageFlagBits::eTransfer, PipelineStageFlagBits::eBottomOfPipe, {}, 0, nullptr, 1, &barrier, 0, nullptr);
+			barrier.srcAccessMask = {};
+			barrier.dstAccessMask = dstAccess;
+			acquireBarriers.push_back(barrier);
+		}
+		else {
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstAccessMask = dstAccess;
+			pending.transfer.pipelineBarrier(PipelineStageFlagBits::eTransfer, dstStage, {}, 0, nullptr, 1, &barrier, 0, nullptr);
+		}
+		pendingStages |= dstStage;
+		bytes += count;
+		dstOffset += count;
+		size -= count;
+	}
+}
+
+void Uploader::Flush()
+{
+	if (!recording) return;
+	pending.transfer.end();
+	pending.end = head;
+	SubmitInfo submitInfo{};
+	submitInfo.sType = StructureType::eSubmitInfo;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &pending.transfer;
+	if (SeparateFamilies()) {
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores = &pending.semaphore;
+		assert(transferQueue.submit(1, &submitInfo, nullptr) == Result::eSuccess);
+		CommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = StructureType::eCommandBufferBeginInfo;
+		beginInfo.flags = CommandBufferUsageFlagBits::eOneTimeSubmit;
+		assert(pending.acquire.begin(&beginInfo) == Result::eSuccess);
+		// Source stages match the semaphore wait stages so the acquire chains after the transfer queue's release.
+		pending.acquire.pipelineBarrier(pendingStages, pendingStages, {}, 0, nullptr, (uint32_t)acquireBarriers.size(), acquireBarriers.data(), 0, nullptr);
+		pending.acquire.end();
+		SubmitInfo acquireInfo{};
+		acquireInfo.sType = StructureType::eSubmitInfo;
+		acquireInfo.waitSemaphoreCount = 1;
+		acquireInfo.pWaitSemaphores = &pending.semaphore;
+		acquireInfo.pWaitDstStageMask = &pendingStages;
+		acquireInfo.commandBufferCount = 1;
+		acquireInfo.pCommandBuffers = &pending.acquire;
+		assert(graphicsQueue.submit(1, &acquireInfo, pending.fence) == Result::eSuccess);
+	}
+	else {
+		assert(graphicsQueue.submit(1, &submitInfo, pending.fence) == Result::eSuccess);
+	}
+	inFlight.push_back(pending);
+	pending = {};
+	recording = false;
+	pendingStages = {};
+	acquireBarriers.clear();
+}
+
+void Uploader::RetireOldest()
+{
+	auto batch = inFlight.front();
+	inFlight.pop_front();
+	device.waitForFences(1, &batch.fence, VK_TRUE, UINT64_MAX);
+	device.resetFences(1, &batch.fence);
+	tail = batch.end;
+	spare.push_back(batch);
+}
+
+void Uploader::Poll()
+{
+	while (!inFlight.empty() && device.getFenceStatus(inFlight.front().fence) == Result::eSuccess) RetireOldest();
+}
+
+void Uploader::WaitIdle()
+{
+	Flush();
+	while (!inFlight.empty()) RetireOldest();
+}
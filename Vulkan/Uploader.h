@@ -0,0 +1,55 @@
+#pragma once
+#include "MemoryAllocator.h"
+#include <deque>
+
+// Streams data into device-local buffers through a persistently mapped staging ring. Copies run on the
+// transfer queue family when it differs from the graphics one, with ownership handed over by semaphore-ordered
+// release/acquire barriers so the graphics queue only executes the acquire.
+class Uploader
+{
+	struct Batch {
+		vk::CommandBuffer transfer;
+		vk::CommandBuffer acquire;
+		vk::Semaphore semaphore;
+		vk::Fence fence;
+		// Ring position just past this batch's last reservation; the ring tail moves here once the fence signals.
+		vk::DeviceSize end = 0;
+	};
+
+	vk::Device device;
+	MemoryAllocator* allocator = nullptr;
+	vk::Queue graphicsQueue;
+	vk::Queue transferQueue;
+	uint32_t graphicsFamily = 0;
+	uint32_t transferFamily = 0;
+	vk::CommandPool transferPool;
+	vk::CommandPool graphicsPool;
+	vk::Buffer staging;
+	Allocation stagingAllocation;
+	vk::DeviceSize capacity = 0;
+	vk::DeviceSize head = 0;
+	vk::DeviceSize tail = 0;
+	std::deque<Batch> inFlight;
+	std::vector<Batch> spare;
+	Batch pending;
+	bool recording = false;
+	vk::PipelineStageFlags pendingStages;
+	std::vector<vk::BufferMemoryBarrier> acquireBarriers;
+
+	bool SeparateFamilies() const { return transferFamily != graphicsFamily; }
+	vk::DeviceSize Reserve(vk::DeviceSize size);
+	void Begin();
+	void RetireOldest();
+public:
+	void Create(vk::Device device, MemoryAllocator& allocator, vk::Queue graphicsQueue, uint32_t graphicsFamily, vk::Queue transferQueue, uint32_t transferFamily, vk::DeviceSize ringSize = 16ull << 20);
+	void Destroy();
+	// Records a copy of size bytes into dst; data larger than the ring is streamed in pieces, flushing as the ring fills.
+	// dstStage/dstAccess describe the first use of the data on the graphics queue.
+	void UploadBuffer(vk::Buffer dst, vk::DeviceSize dstOffset, const void* data, vk::DeviceSize size, vk::PipelineStageFlags dstStage, vk::AccessFlags dstAccess);
+	// Submits recorded copies. Graphics work submitted afterwards observes the uploaded data.
+	void Flush();
+	// Releases staging space of every batch the GPU has finished with, without blocking.
+	void Poll();
+	void WaitIdle();
+	bool OnTransferQueue() const { return SeparateFamilies(); }
+};
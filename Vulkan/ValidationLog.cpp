@@ -0,0 +1,136 @@
+#include "ValidationLog.h"
+#include "Log.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <vector>
+
+bool ParseValidationSeverity(const std::string& name, ValidationSeverity& severity)
+{
+	const char* names[] = { "verbose", "info", "warning", "error" };
+	for (size_t i = 0; i < 4; i++) {
+		if (name == names[i]) {
+			severity = (ValidationSeverity)i;
+			return true;
+		}
+	}
+	return false;
+}
+
+VkDebugUtilsMessageSeverityFlagsEXT SeverityMask(ValidationSeverity minimum)
+{
+	const VkDebugUtilsMessageSeverityFlagBitsEXT bits[] = {
+		VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT,
+		VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT,
+		VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT,
+		VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT,
+	};
+	VkDebugUtilsMessageSeverityFlagsEXT mask = 0;
+	for (size_t i = (size_t)minimum; i < 4; i++) mask |= bits[i];
+	return mask;
+}
+
+static const char* SeverityName(VkDebugUtilsMessageSeverityFlagBitsEXT severity)
+{
+	if (severity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT) return "error";
+	if (severity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT) return "warning";
+	if (severity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT) return "info";
+	return "verbose";
+}
+
+static void CopyString(char* dst, size_t size, const char* src)
+{
+	if (src == nullptr) src = "";
+	size_t length = strlen(src);
+	if (length >= size) {
+		memcpy(dst, src, size - 4);
+		memcpy(dst + size - 4, "...", 4);
+	}
+	else {
+		memcpy(dst, src, length + 1);
+	}
+}
+
+ValidationLog::ValidationLog(size_t capacity)
+{
+	size_t size = 1;
+	while (size < capacity) size <<= 1;
+	slots.reset(new Slot[size]);
+	mask = size - 1;
+	for (size_t i = 0; i < size; i++) slots[i].sequence.store(i, std::memory_order_relaxed);
+	logger = std::thread([this] {
+		// Polling keeps producers free of any wake-up syscall; messages are for humans, a few ms of delay is fine.
+		while (!stopping.load(std::memory_order_acquire)) {
+			Drain();
+			std::this_thread::sleep_for(std::chrono::milliseconds(5));
+		}
+		Drain();
+	});
+}
+
+ValidationLog::~ValidationLog()
+{
+	stopping.store(true, std::memory_order_release);
+	logger.join();
+	std::vector<std::pair<uint64_t, const std::string*>> repeated;
+	for (auto& entry : seen) {
+		if (entry.second > 1) repeated.emplace_back(entry.second, &entry.first);
+	}
+	std::sort(repeated.begin(), repeated.end(), [](auto& a, auto& b) { return a.first > b.first; });
+	for (auto& entry : repeated) Log("validation: %s repeated %llu times", entry.second->c_str(), (unsigned long long)entry.first);
+	if (auto count = dropped.load()) Log("validation: %llu messages dropped, ring full", (unsigned long long)count);
+}
+
+bool ValidationLog::Push(VkDebugUtilsMessageSeverityFlagBitsEXT severity, VkDebugUtilsMessageTypeFlagsEXT type, const VkDebugUtilsMessengerCallbackDataEXT* data)
+{
+	// Bounded multi-producer queue: each slot's sequence tells producers whether it is free for the current lap.
+	size_t pos = enqueuePos.load(std::memory_order_relaxed);
+	Slot* slot;
+	for (;;) {
+		slot = &slots[pos & mask];
+		size_t sequence = slot->sequence.load(std::memory_order_acquire);
+		intptr_t difference = (intptr_t)sequence - (intptr_t)pos;
+		if (difference == 0) {
+			if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+		}
+		else if (difference < 0) {
+			return false;
+		}
+		else {
+			pos = enqueuePos.load(std::memory_order_relaxed);
+		}
+	}
+	auto& message = slot->message;
+	message.severity = severity;
+	message.type = type;
+	message.id = data->messageIdNumber;
+	CopyString(message.idName, sizeof(message.idName), data->pMessageIdName);
+	CopyString(message.text, sizeof(message.text), data->pMessage);
+	slot->sequence.store(pos + 1, std::memory_order_release);
+	return true;
+}
+
+void ValidationLog::Drain()
+{
+	for (;;) {
+		auto& slot = slots[dequeuePos & mask];
+		if (slot.sequence.load(std::memory_order_acquire) != dequeuePos + 1) return;
+		auto& message = slot.message;
+		// Some messages carry no ID name; the ID number still tells them apart.
+		auto& count = seen[message.idName[0] ? std::string(message.idName) : "#" + std::to_string(message.id)];
+		if (count++ == 0) {
+			Log("validation %s%s [%s]: %s", SeverityName(message.severity), message.type & VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT ? " (performance)" : "", message.idName, message.text);
+		}
+		slot.sequence.store(dequeuePos + mask + 1, std::memory_order_release);
+		dequeuePos++;
+	}
+}
+
+VkBool32 VKAPI_CALL ValidationLog::Callback(VkDebugUtilsMessageSeverityFlagBitsEXT severity, VkDebugUtilsMessageTypeFlagsEXT type, const VkDebugUtilsMessengerCallbackDataEXT* data, void* userData)
+{
+	if (type & (VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT)) {
+		auto log = static_cast<ValidationLog*>(userData);
+		if (!log->Push(severity, type, data)) log->dropped.fetch_add(1, std::memory_order_relaxed);
+	}
+	return VK_FALSE;
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include "Dispatch.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+enum class ValidationSeverity {
+	Verbose,
+	Info,
+	Warning,
+	Error
+};
+
+bool ParseValidationSeverity(const std::string& name, ValidationSeverity& severity);
+// Severity bits of minimum and everything above it, for VkDebugUtilsMessengerCreateInfoEXT::messageSeverity.
+VkDebugUtilsMessageSeverityFlagsEXT SeverityMask(ValidationSeverity minimum);
+
+// Debug messenger sink that never blocks the thread making the Vulkan call. The callback copies each message into a
+// bounded lock-free ring (dropping it when the ring is full); a background thread prints the first occurrence of
+// every message ID and counts repeats, which are summarized at shutdown.
+class ValidationLog
+{
+	struct Message {
+		VkDebugUtilsMessageSeverityFlagBitsEXT severity;
+		VkDebugUtilsMessageTypeFlagsEXT type;
+		int32_t id;
+		char idName[64];
+		char text[2048];
+	};
+	struct Slot {
+		std::atomic<size_t> sequence;
+		Message message;
+	};
+
+	std::unique_ptr<Slot[]> slots;
+	size_t mask;
+	std::atomic<size_t> enqueuePos{ 0 };
+	size_t dequeuePos = 0;
+	std::atomic<uint64_t> dropped{ 0 };
+	std::atomic<bool> stopping{ false };
+	std::thread logger;
+	// Owned by the logger thread: occurrences per message ID name.
+	std::unordered_map<std::string, uint64_t> seen;
+
+	bool Push(VkDebugUtilsMessageSeverityFlagBitsEXT severity, VkDebugUtilsMessageTypeFlagsEXT type, const VkDebugUtilsMessengerCallbackDataEXT* data);
+	void Drain();
+public:
+	// capacity is rounded up to a power of two.
+	explicit ValidationLog(size_t capacity = 512);
+	// Drains what is left and prints the repeat summary; destroy the messenger first.
+	~ValidationLog();
+	ValidationLog(const ValidationLog&) = delete;
+	ValidationLog& operator=(const ValidationLog&) = delete;
+	// PFN_vkDebugUtilsMessengerCallbackEXT; pass the ValidationLog as pUserData.
+	static VKAPI_ATTR VkBool32 VKAPI_CALL Callback(VkDebugUtilsMessageSeverityFlagBitsEXT severity, VkDebugUtilsMessageTypeFlagsEXT type, const VkDebugUtilsMessengerCallbackDataEXT* data, void* userData);
+};
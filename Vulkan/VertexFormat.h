@@ -0,0 +1,181 @@
+#pragma once
+#include "Dispatch.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// Vertex input descriptions derived from the vertex struct itself. Every member type maps to exactly one
+// vk::Format, so a member whose size disagrees with its format, a type without a format, or attributes that
+// overlap or run past the struct fail to compile instead of being fetched wrong.
+//
+//   template <> struct VertexAttributes<MyVertex> {
+//       static constexpr std::array<VertexAttribute, 2> value = { VERTEX_ATTRIBUTE(MyVertex, pos, 0), VERTEX_ATTRIBUTE(MyVertex, color, 1) };
+//   };
+
+// Four snorm16 components; xyz of a position quantized to [-1, 1], w padding since 3-component 16-bit formats
+// are rarely supported for vertex fetch.
+struct Snorm16x4 {
+	int16_t v[4];
+};
+
+// Four IEEE half floats.
+struct Half4 {
+	uint16_t v[4];
+};
+
+// Four unorm8 components, e.g. an RGBA color.
+struct Unorm8x4 {
+	uint8_t v[4];
+};
+
+// A unit vector folded onto the octahedron and stored as two snorm16; decoded with DecodeOctahedral in header.hlsli.
+struct Octahedral16 {
+	int16_t v[2];
+};
+
+template <typename T> struct AttributeFormat;
+template <> struct AttributeFormat<float[2]> { static constexpr vk::Format value = vk::Format::eR32G32Sfloat; };
+template <> struct AttributeFormat<float[3]> { static constexpr vk::Format value = vk::Format::eR32G32B32Sfloat; };
+template <> struct AttributeFormat<float[4]> { static constexpr vk::Format value = vk::Format::eR32G32B32A32Sfloat; };
+template <> struct AttributeFormat<Snorm16x4> { static constexpr vk::Format value = vk::Format::eR16G16B16A16Snorm; };
+template <> struct AttributeFormat<Half4> { static constexpr vk::Format value = vk::Format::eR16G16B16A16Sfloat; };
+template <> struct AttributeFormat<Unorm8x4> { static constexpr vk::Format value = vk::Format::eR8G8B8A8Unorm; };
+template <> struct AttributeFormat<Octahedral16> { static constexpr vk::Format value = vk::Format::eR16G16Snorm; };
+
+constexpr uint32_t FormatSize(vk::Format format)
+{
+	switch (format)
+	{
+	case vk::Format::eR32G32Sfloat: return 8;
+	case vk::Format::eR32G32B32Sfloat: return 12;
+	case vk::Format::eR32G32B32A32Sfloat: return 16;
+	case vk::Format::eR16G16B16A16Snorm: return 8;
+	case vk::Format::eR16G16B16A16Sfloat: return 8;
+	case vk::Format::eR8G8B8A8Unorm: return 4;
+	case vk::Format::eR16G16Snorm: return 4;
+	default: return 0;
+	}
+}
+
+struct VertexAttribute {
+	uint32_t location;
+	vk::Format format;
+	uint32_t offset;
+	uint32_t size;
+};
+
+template <typename T>
+constexpr VertexAttribute MakeVertexAttribute(uint32_t location, uint32_t offset)
+{
+	static_assert(FormatSize(AttributeFormat<T>::value) == sizeof(T), "vertex member size does not match its format");
+	return { location, AttributeFormat<T>::value, offset, (uint32_t)sizeof(T) };
+}
+
+#define VERTEX_ATTRIBUTE(Type, member, location) MakeVertexAttribute<decltype(Type::member)>(location, (uint32_t)offsetof(Type, member))
+
+// Specialized next to each vertex struct with a constexpr std::array<VertexAttribute, N> value.
+template <typename V> struct VertexAttributes;
+
+template <typename V>
+constexpr bool ValidVertexLayout()
+{
+	constexpr auto& attributes = VertexAttributes<V>::value;
+	for (size_t i = 0; i < attributes.size(); i++) {
+		if (attributes[i].offset + attributes[i].size > sizeof(V)) return false;
+		for (size_t j = i + 1; j < attributes.size(); j++) {
+			if (attributes[i].location == attributes[j].location) return false;
+			bool disjoint = attributes[i].offset + attributes[i].size <= attributes[j].offset || attributes[j].offset + attributes[j].size <= attributes[i].offset;
+			if (!disjoint) return false;
+		}
+	}
+	return true;
+}
+
+// Binding and attribute descriptions for a per-vertex stream of V.
+template <typename V>
+struct VertexLayout
+{
+	static_assert(ValidVertexLayout<V>(), "vertex attributes overlap, share a location or exceed the vertex");
+	static constexpr size_t AttributeCount = VertexAttributes<V>::value.size();
+
+	static vk::VertexInputBindingDescription Binding(uint32_t binding = 0)
+	{
+		vk::VertexInputBindingDescription description{};
+		description.binding = binding;
+		description.stride = sizeof(V);
+		description.inputRate = vk::VertexInputRate::eVertex;
+		return description;
+	}
+	static std::array<vk::VertexInputAttributeDescription, AttributeCount> Attributes(uint32_t binding = 0)
+	{
+		std::array<vk::VertexInputAttributeDescription, AttributeCount> descriptions{};
+		for (size_t i = 0; i < AttributeCount; i++) {
+			auto& attribute = VertexAttributes<V>::value[i];
+			descriptions[i].binding = binding;
+			descriptions[i].location = attribute.location;
+			descriptions[i].format = attribute.format;
+			descriptions[i].offset = attribute.offset;
+		}
+		return descriptions;
+	}
+};
+
+inline int16_t ToSnorm16(float value)
+{
+	return (int16_t)std::lround(std::clamp(value, -1.0f, 1.0f) * 32767.0f);
+}
+
+inline uint8_t ToUnorm8(float value)
+{
+	return (uint8_t)std::lround(std::clamp(value, 0.0f, 1.0f) * 255.0f);
+}
+
+// Round-to-nearest-even float to half conversion, including subnormals, infinities and NaN.
+inline uint16_t ToHalf(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	uint16_t sign = (uint16_t)((bits >> 16) & 0x8000);
+	uint32_t magnitude = bits & 0x7FFFFFFF;
+	if (magnitude >= 0x7F800000) return sign | (magnitude > 0x7F800000 ? 0x7E00 : 0x7C00);
+	// 65520 and above round past the largest half.
+	if (magnitude >= 0x477FF000) return sign | 0x7C00;
+	uint32_t result;
+	uint32_t remainder;
+	uint32_t halfway;
+	if (magnitude < 0x38800000) {
+		// Below the smallest normal half; shift the full mantissa down to units of 2^-24.
+		if (magnitude < 0x33000000) return sign;
+		uint32_t shift = 126 - (magnitude >> 23);
+		uint32_t mantissa = (magnitude & 0x7FFFFF) | 0x800000;
+		result = mantissa >> shift;
+		remainder = mantissa & ((1u << shift) - 1);
+		halfway = 1u << (shift - 1);
+	}
+	else {
+		result = (magnitude - 0x38000000) >> 13;
+		remainder = magnitude & 0x1FFF;
+		halfway = 0x1000;
+	}
+	// A carry out of the mantissa correctly bumps the exponent.
+	if (remainder > halfway || (remainder == halfway && (result & 1))) result++;
+	return sign | (uint16_t)result;
+}
+
+inline Octahedral16 EncodeOctahedral(float x, float y, float z)
+{
+	float length = std::abs(x) + std::abs(y) + std::abs(z);
+	if (length == 0) return { { 0, 0 } };
+	x /= length;
+	y /= length;
+	if (z < 0) {
+		float foldedX = (1 - std::abs(y)) * (x >= 0 ? 1 : -1);
+		float foldedY = (1 - std::abs(x)) * (y >= 0 ? 1 : -1);
+		x = foldedX;
+		y = foldedY;
+	}
+	return { { ToSnorm16(x), ToSnorm16(y) } };
+}
@@ -1,16 +1,33 @@
 ﻿#include "VulkanApp.h"
+#include "Benchmark.h"
+#include "MeshConverter.h"
+#include <cstring>
 
-const wchar_t* VulkanApp::WndClsName = L"VulkanWindow";
+static bool HasFlag(int argc, char** argv, const char* flag)
+{
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], flag) == 0) return true;
+	}
+	return false;
+}
 
-int WinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE, _In_ LPSTR, _In_ int)
+#ifdef _WIN32
+int WinMain(_In_ HINSTANCE, _In_opt_ HINSTANCE, _In_ LPSTR, _In_ int)
 {
 	SetProcessDpiAwarenessContext(DPI_AWARENESS_CONTEXT_PER_MONITOR_AWARE_V2);
-	WNDCLASS cls{};
-	cls.hInstance = hInstance;
-	cls.lpszClassName = VulkanApp::WndClsName;
-	cls.lpfnWndProc = VulkanApp::WndProcAlloter;
-	RegisterClass(&cls);
-
-	VulkanApp app;
+	if (HasFlag(__argc, __argv, "--benchmark")) return RunBenchmark(__argc, __argv);
+	if (HasFlag(__argc, __argv, "--convert-mesh")) return RunMeshConverter(__argc, __argv);
+	if (HasFlag(__argc, __argv, "--math-benchmark")) return RunMathBenchmark(__argc, __argv);
+	VulkanApp app(AppConfig::Parse(__argc, __argv));
+	return app.Run();
+}
+#else
+int main(int argc, char** argv)
+{
+	if (HasFlag(argc, argv, "--benchmark")) return RunBenchmark(argc, argv);
+	if (HasFlag(argc, argv, "--convert-mesh")) return RunMeshConverter(argc, argv);
+	if (HasFlag(argc, argv, "--math-benchmark")) return RunMathBenchmark(argc, argv);
+	VulkanApp app(AppConfig::Parse(argc, argv));
 	return app.Run();
-}
\ No newline at end of file
+}
+#endif
\ No newline at end of file
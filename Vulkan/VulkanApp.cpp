@@ -1,4 +1,7 @@
 #include "VulkanApp.h"
+#include "Log.h"
+#include "Dispatch.h"
+#include "DeviceSelector.h"
 #ifdef _DEBUG
 #include <cassert>
 #else
@@ -6,93 +9,481 @@
 #endif
 
 #include <fstream>
+#include <cstring>
+#include <cstdio>
+#include <algorithm>
+#include <cmath>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
 
 using namespace vk;
 
-LRESULT VulkanApp::WndProcAlloter(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
+void VulkanApp::DrawFrame()
+{
+	if (swapchainDirty && !RecreateSwapchain()) return;
+	auto inputTime = std::chrono::steady_clock::now();
+	ScopeTimer frameTimer(timing, FrameStage::Frame);
+	uint32_t imageIndex;
+	{
+		ScopeTimer timer(timing, FrameStage::WaitFence);
+		pacer.Wait(frameValues[currentFrame]);
+	}
+	timing.latency = pacer.Poll();
+	deletions.Collect(pacer.NextValue() - 1, pacer.Completed());
+	capture.Poll(pacer.NextValue() - 1, pacer.Completed());
+	if (shaderWatcher) {
+		std::vector<uint32_t> vertexCode, pixelCode;
+		if (shaderWatcher->Take(vertexCode, pixelCode)) {
+			pipelines.Reload({ vertexCode.data(), vertexCode.size() * sizeof(uint32_t) }, { pixelCode.data(), pixelCode.size() * sizeof(uint32_t) });
+		}
+	}
+	pipelines.Collect();
+	StreamMesh();
+	{
+		// The frame slot's previous submission has completed, so its region of the ring is free to overwrite.
+		FrameConstants constants{};
+		constants.view = { 0, 0, config.zoom, 0 };
+		constants.time = std::chrono::duration<float>(std::chrono::steady_clock::now() - startTime).count();
+		uniforms.BeginFrame(currentFrame);
+		frameConstantsOffset = uniforms.Push(constants);
+		timing.cpu[(size_t)FrameStage::Cull] = 0;
+		// The indirect commands are static and draw everything regardless.
+		if (cull && !DrawIndirect()) {
+			ScopeTimer timer(timing, FrameStage::Cull);
+			// The same pan and zoom the vertex shader applies after the instance transform.
+			auto& view = constants.view;
+			CullDraws(Affine3::ScaleTranslate({ view.z, view.z, 1 }, { view.x * view.z, view.y * view.z, 0 }));
+		}
+	}
+	{
+		ScopeTimer timer(timing, FrameStage::Acquire);
+		if (config.headless) {
+			imageIndex = currentFrame;
+		}
+		else {
+			auto result = device.acquireNextImageKHR(swapchain, UINT64_MAX, imageSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
+			if (result == Result::eErrorOutOfDateKHR) {
+				swapchainDirty = true;
+				return;
+			}
+			// A suboptimal image is still acquired and signals the semaphore, so it is drawn and presented first.
+			if (result == Result::eSuboptimalKHR) swapchainDirty = true;
+			else assert(result == Result::eSuccess);
+		}
+		pacer.Wait(imageValues[imageIndex]);
+	}
+	uint64_t signalValue = pacer.NextValue();
+	frameValues[currentFrame] = signalValue;
+	imageValues[imageIndex] = signalValue;
+	if (capturing) {
+		capture.Claim(signalValue, swapchainExtent);
+		graph.BindBuffer(captureTarget, capture.Target());
+	}
+	timing.gpu = -1;
+	if (timestampPool && timestampPending[currentFrame]) {
+		uint64_t ticks[2];
+		if (device.getQueryPoolResults(timestampPool, currentFrame * 2, 2, sizeof(ticks), ticks, sizeof(uint64_t), QueryResultFlagBits::e64) == Result::eSuccess) {
+			timing.gpu = (ticks[1] - ticks[0]) * timestampPeriod / 1e6;
+			if (Trace::Enabled()) {
+				Trace::RecordGpu("frame", (int64_t)(ticks[0] * (double)timestampPeriod) + gpuTraceOffset, (int64_t)(ticks[1] * (double)timestampPeriod) + gpuTraceOffset);
+			}
+		}
+	}
+	timestampPending[currentFrame] = true;
+	// Submitted ahead of recording, so the step is already running while the frame is recorded.
+	if (particles.Count() > 0) particles.Simulate(currentFrame, signalValue, pacer.Semaphore());
+	if (dynamicResolution) {
+		if (timing.gpu >= 0) resolution.Update(timing.gpu);
+		renderExtent = ResolutionController::Apply(swapchainExtent, resolution.Scale());
+		graph.SetRenderArea(scenePass, renderExtent);
+	}
+	{
+		ScopeTimer timer(timing, FrameStage::Record);
+		RecordFrame(imageIndex);
+	}
+	// The timeline value orders the CPU against the GPU; the binary semaphores only exist because the
+	// swapchain cannot wait on or signal timeline semaphores.
+	Semaphore waitSemaphores[2];
+	PipelineStageFlags waitStages[2];
+	uint64_t waitValues[2] = {};
+	uint32_t waitCount = 0;
+	if (!config.headless) {
+		waitSemaphores[waitCount] = imageSemaphores[currentFrame];
+		waitStages[waitCount++] = PipelineStageFlagBits::eColorAttachmentOutput;
+	}
+	if (particles.Count() > 0) {
+		// Only the particle draws need the simulation, so everything before vertex shading proceeds meanwhile.
+		waitSemaphores[waitCount] = compute.Timeline();
+		waitStages[waitCount] = PipelineStageFlagBits::eVertexShader;
+		waitValues[waitCount++] = particles.DrawnValue(signalValue);
+	}
+	Semaphore signalSemaphores[] = { pacer.Semaphore(), renderSemaphores[currentFrame] };
+	uint64_t signalValues[] = { signalValue, 0 };
+	TimelineSemaphoreSubmitInfo timelineInfo{};
+	timelineInfo.sType = StructureType::eTimelineSemaphoreSubmitInfo;
+	timelineInfo.waitSemaphoreValueCount = waitCount;
+	timelineInfo.pWaitSemaphoreValues = waitValues;
+	timelineInfo.signalSemaphoreValueCount = config.headless ? 1 : 2;
+	timelineInfo.pSignalSemaphoreValues = signalValues;
+	SubmitInfo submitInfo{};
+	submitInfo.sType = StructureType::eSubmitInfo;
+	submitInfo.pNext = &timelineInfo;
+	submitInfo.waitSemaphoreCount = waitCount;
+	submitInfo.pWaitSemaphores = waitSemaphores;
+	submitInfo.pWaitDstStageMask = waitStages;
+	submitInfo.signalSemaphoreCount = timelineInfo.signalSemaphoreValueCount;
+	submitInfo.pSignalSemaphores = signalSemaphores;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &frameResources[currentFrame].primary;
+	{
+		ScopeTimer timer(timing, FrameStage::Submit);
+		assert(queue.submit(1, &submitInfo, nullptr) == Result::eSuccess);
+		pacer.Submitted(inputTime);
+	}
+	lastImage = imageIndex;
+	timing.cpu[(size_t)FrameStage::Present] = 0;
+	if (!config.headless) {
+		ScopeTimer timer(timing, FrameStage::Present);
+		PresentInfoKHR presentInfo{};
+		presentInfo.sType = StructureType::ePresentInfoKHR;
+		presentInfo.waitSemaphoreCount = 1;
+		presentInfo.pWaitSemaphores = &renderSemaphores[currentFrame];
+		presentInfo.swapchainCount = 1;
+		presentInfo.pSwapchains = &swapchain;
+		presentInfo.pImageIndices = &imageIndex;
+		auto result = queue.presentKHR(&presentInfo);
+		if (result == Result::eErrorOutOfDateKHR || result == Result::eSuboptimalKHR) swapchainDirty = true;
+		else assert(result == Result::eSuccess);
+	}
+	currentFrame = (currentFrame + 1) % framesInFlight;
+}
+
+bool VulkanApp::CreateSwapchain()
 {
-	if (msg == WM_NCCREATE) {
-		CREATESTRUCT* ps = (CREATESTRUCT*)lParam;
-		VulkanApp* wnd = (VulkanApp*)ps->lpCreateParams;
-		SetWindowLongPtr(hwnd, GWLP_USERDATA, (LONG_PTR)wnd);
+	SurfaceCapabilitiesKHR caps{};
+	auto result = physicalDevice.getSurfaceCapabilitiesKHR(surface, &caps);
+	assert(result == Result::eSuccess);
+	Extent2D extent = caps.currentExtent;
+	if (extent.width == UINT32_MAX || extent.height == UINT32_MAX) {
+		extent.width = std::clamp(windowExtent.width, caps.minImageExtent.width, caps.maxImageExtent.width);
+		extent.height = std::clamp(windowExtent.height, caps.minImageExtent.height, caps.maxImageExtent.height);
+	}
+	if (extent.width == 0 || extent.height == 0) return false;
+	// One image beyond the frames in flight lets the presentation engine hold one while the GPU renders the rest.
+	uint32_t imageCount = std::max(caps.minImageCount, framesInFlight + 1);
+	if (caps.maxImageCount > 0) imageCount = std::min(imageCount, caps.maxImageCount);
+	SwapchainCreateInfoKHR swapchainCreateInfo = {};
+	swapchainCreateInfo.sType = StructureType::eSwapchainCreateInfoKHR;
+	swapchainCreateInfo.surface = surface;
+	swapchainCreateInfo.minImageCount = imageCount;
+	swapchainCreateInfo.imageFormat = Format::eR8G8B8A8Unorm;
+	swapchainCreateInfo.imageColorSpace = ColorSpaceKHR::eSrgbNonlinear;
+	swapchainCreateInfo.imageExtent = extent;
+	swapchainCreateInfo.imageArrayLayers = 1;
+	swapchainCreateInfo.imageUsage = ImageUsageFlagBits::eColorAttachment;
+	if (!swapchain && dynamicResolution && !(caps.supportedUsageFlags & ImageUsageFlagBits::eTransferDst)) {
+		Log("dynamic resolution: swapchain images cannot be blitted to, rendering at full resolution");
+		dynamicResolution = false;
 	}
-	VulkanApp* wnd = (VulkanApp*)GetWindowLongPtr(hwnd, GWLP_USERDATA);
-	return wnd == nullptr ? DefWindowProc(hwnd, msg, wParam, lParam) : wnd->WndProc(hwnd, msg, wParam, lParam);
+	if (dynamicResolution) swapchainCreateInfo.imageUsage |= ImageUsageFlagBits::eTransferDst;
+	if (!swapchain && capturing && !(caps.supportedUsageFlags & ImageUsageFlagBits::eTransferSrc)) {
+		Log("capture: swapchain images cannot be copied from, capture disabled");
+		capturing = false;
+	}
+	if (capturing) swapchainCreateInfo.imageUsage |= ImageUsageFlagBits::eTransferSrc;
+	swapchainCreateInfo.imageSharingMode = SharingMode::eExclusive;
+	swapchainCreateInfo.queueFamilyIndexCount = 1;
+	swapchainCreateInfo.pQueueFamilyIndices = &graphicsFamily;
+	swapchainCreateInfo.preTransform = SurfaceTransformFlagBitsKHR::eIdentity;
+	swapchainCreateInfo.compositeAlpha = CompositeAlphaFlagBitsKHR::eOpaque;
+	swapchainCreateInfo.presentMode = presentMode;
+	// Handing over the old swapchain lets the driver reuse its resources and keep presenting its queued images.
+	swapchainCreateInfo.oldSwapchain = swapchain;
+	SwapchainKHR created;
+	result = device.createSwapchainKHR(&swapchainCreateInfo, nullptr, &created);
+	assert(result == Result::eSuccess);
+	deletions.Track(HandleType::Swapchain);
+	// The presentation engine may still be showing the old swapchain's images, so it is only destroyed once the
+	// first frame submitted to the new one has completed.
+	if (swapchain) deletions.Retire(swapchain, pacer.NextValue());
+	swapchain = created;
+	swapchainExtent = extent;
+	result = device.getSwapchainImagesKHR(swapchain, &imageCount, nullptr);
+	assert(result == Result::eSuccess);
+	assert(imageCount > 0);
+	images.resize(imageCount);
+	result = device.getSwapchainImagesKHR(swapchain, &imageCount, images.data());
+	assert(result == Result::eSuccess);
+	return true;
 }
 
-ShaderModule VulkanApp::CreateShaderModule(const std::vector<char>& code)
+void VulkanApp::CreateViews()
 {
-	ShaderModuleCreateInfo createInfo{};
-	createInfo.sType = StructureType::eShaderModuleCreateInfo;
-	createInfo.codeSize = code.size();
-	createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
-	ShaderModule shaderModule{};
-	assert(device.createShaderModule(&createInfo, nullptr, &shaderModule) == Result::eSuccess);
-	return shaderModule;
+	views.resize(images.size());
+	for (size_t i = 0; i < images.size(); i++) {
+		ImageViewCreateInfo createInfo{};
+		createInfo.sType = StructureType::eImageViewCreateInfo;
+		createInfo.image = images[i];
+		createInfo.viewType = ImageViewType::e2D;
+		createInfo.format = Format::eR8G8B8A8Unorm;
+		createInfo.components.r = ComponentSwizzle::eIdentity;
+		createInfo.components.g = ComponentSwizzle::eIdentity;
+		createInfo.components.b = ComponentSwizzle::eIdentity;
+		createInfo.components.a = ComponentSwizzle::eIdentity;
+		createInfo.subresourceRange.aspectMask = ImageAspectFlagBits::eColor;
+		createInfo.subresourceRange.baseMipLevel = 0;
+		createInfo.subresourceRange.levelCount = 1;
+		createInfo.subresourceRange.baseArrayLayer = 0;
+		createInfo.subresourceRange.layerCount = 1;
+		assert(device.createImageView(&createInfo, nullptr, &views[i]) == Result::eSuccess);
+		deletions.Track(HandleType::ImageView);
+	}
 }
 
-uint32_t VulkanApp::FindMemoryType(uint32_t typeFilter, MemoryPropertyFlags properties)
+bool VulkanApp::RecreateSwapchain()
 {
-	PhysicalDeviceMemoryProperties memProperties;
-	physicalDevice.getMemoryProperties(&memProperties);
-	for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
-		if (typeFilter & 1 << i && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
-			return i;
+	{
+		ScopeTimer timer(swapchainRecreateTime, "recreateSwapchain");
+		if (!CreateSwapchain()) {
+			minimized = true;
+			return false;
 		}
+		// Frames already submitted still draw through the old views and the graph's framebuffers and transients,
+		// so those are retired rather than destroyed and nothing waits for the GPU here.
+		for (auto view : views) deletions.Retire(view);
+		CreateViews();
+		imageValues.assign(images.size(), 0);
+		// Pipelines only bake in formats and take viewport and scissor per draw, so none of them is touched.
+		graph.SetExtent(colorTarget, swapchainExtent);
+		if (dynamicResolution) graph.SetExtent(sceneTarget, ResolutionController::Apply(swapchainExtent, resolution.MaxScale()));
+		else renderExtent = swapchainExtent;
+		graph.Compile();
+		swapchainDirty = false;
 	}
-	throw std::runtime_error("failed to find suitable memory type!");
+	Log("swapchain: recreated at %ux%u with %zu images in %.2fms", swapchainExtent.width, swapchainExtent.height, images.size(), swapchainRecreateTime);
+	return true;
 }
 
-void VulkanApp::DrawFrame()
+void VulkanApp::CullDraws(const Affine3& view)
 {
-	device.waitForFences(1, &fences[currentFrame], VK_TRUE, UINT64_MAX);
-	uint32_t imageIndex;
-	auto result = device.acquireNextImageKHR(swapchain, UINT64_MAX, imageSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
-	if (imageFences[imageIndex] != Fence(VK_NULL_HANDLE)) {
-		device.waitForFences(1, &imageFences[imageIndex], VK_TRUE, UINT64_MAX);
+	// Enough objects per job to amortize waking a worker, few enough to spread 100k objects across all of them.
+	constexpr size_t ObjectsPerJob = 4096;
+	size_t count = drawBounds.Size();
+	size_t jobs = (count + ObjectsPerJob - 1) / ObjectsPerJob;
+	auto planes = ClipVolumePlanes();
+	cullJobCounts.resize(jobs);
+	workers->ParallelFor(jobs, [&](size_t job) {
+		TraceScope trace("cullJob");
+		size_t begin = job * ObjectsPerJob;
+		size_t end = std::min(count, begin + ObjectsPerJob);
+		TransformSpheres(simd, drawBounds, view, clipBounds, begin, end);
+		cullJobCounts[job] = CullSpheres(simd, clipBounds, planes.data(), planes.size(), begin, end, cullScratch.data() + begin);
+	});
+	// Each job left its survivors at the start of its own block; joining them keeps the draw order.
+	visibleDraws.clear();
+	for (size_t job = 0; job < jobs; job++) {
+		auto first = cullScratch.begin() + job * ObjectsPerJob;
+		visibleDraws.insert(visibleDraws.end(), first, first + cullJobCounts[job]);
 	}
-	imageFences[imageIndex] = fences[currentFrame];
+}
+
+void VulkanApp::RecordFrame(uint32_t imageIndex)
+{
+	auto& frame = frameResources[currentFrame];
+	// Resetting the pools recycles every command buffer allocated from them in one call.
+	device.resetCommandPool(frame.pool, {});
+	for (auto pool : frame.slicePools) device.resetCommandPool(pool, {});
+	// Small draw lists are not worth waking workers for; split only once each slice has enough draws.
+	constexpr size_t MinDrawsPerSlice = 64;
+	// The indirect path records a handful of commands regardless of scene size, so it always stays on this thread.
+	size_t sliceCount = DrawIndirect() ? 1 : std::max<size_t>(1, std::min(frame.secondaries.size(), (visibleDraws.size() + MinDrawsPerSlice - 1) / MinDrawsPerSlice));
+	graph.BindImage(colorTarget, images[imageIndex], views[imageIndex]);
+	// Looked up once per frame; until the requested variant is compiled this is the closest one that is.
+	auto pipeline = pipelines.Get(pipelineKey);
+	CommandBufferInheritanceRenderingInfoKHR renderingInfo;
+	auto inheritanceInfo = graph.Inheritance(scenePass, renderingInfo);
+	Viewport viewport(0.0f, 0.0f, (float)renderExtent.width, (float)renderExtent.height, 0.0f, 1.0f);
+	Rect2D scissor({ 0, 0 }, renderExtent);
+	workers->ParallelFor(sliceCount, [&](size_t slice) {
+		TraceScope trace("recordSlice");
+		auto commandBuffer = frame.secondaries[slice];
+		CommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = StructureType::eCommandBufferBeginInfo;
+		beginInfo.flags = CommandBufferUsageFlagBits::eOneTimeSubmit | CommandBufferUsageFlagBits::eRenderPassContinue;
+		beginInfo.pInheritanceInfo = &inheritanceInfo;
+		assert(commandBuffer.begin(&beginInfo) == Result::eSuccess);
+		BeginLabel(commandBuffer, "recordSlice");
+		Buffer vertexBuffers[] = { vertexBuffer.Get() };
+		DeviceSize offsets[] = { 0 };
+		commandBuffer.bindPipeline(PipelineBindPoint::eGraphics, pipeline);
+		// Dynamic state is not inherited, so every secondary sets its own.
+		commandBuffer.setViewport(0, 1, &viewport);
+		commandBuffer.setScissor(0, 1, &scissor);
+		commandBuffer.bindVertexBuffers(0, 1, vertexBuffers, offsets);
+		commandBuffer.bindIndexBuffer(indexBuffer.Get(), 0, IndexType::eUint32);
+		DescriptorSet sets[] = { bindless.Set(), uniforms.Set() };
+		commandBuffer.bindDescriptorSets(PipelineBindPoint::eGraphics, pipelineLayout, 0, 2, sets, 1, &frameConstantsOffset);
+		if (DrawIndirect()) {
+			// Indirect commands cannot change push constants, so every command reads the same instance buffer.
+			DrawConstants constants{ instanceSlot };
+			commandBuffer.pushConstants(pipelineLayout, ShaderStageFlagBits::eVertex, 0, sizeof(constants), &constants);
+			constexpr uint32_t stride = sizeof(DrawIndexedIndirectCommand);
+			if (drawIndirectCount) {
+				commandBuffer.drawIndexedIndirectCount(indirectBuffer.Get(), 0, indirectBuffer.Get(), indirectCountOffset, indirectDrawCount, stride);
+			}
+			else if (multiDrawIndirect) {
+				commandBuffer.drawIndexedIndirect(indirectBuffer.Get(), 0, indirectDrawCount, stride);
+			}
+			else {
+				for (uint32_t i = 0; i < indirectDrawCount; i++) commandBuffer.drawIndexedIndirect(indirectBuffer.Get(), (DeviceSize)i * stride, 1, stride);
+			}
+		}
+		else {
+			size_t begin = visibleDraws.size() * slice / sliceCount;
+			size_t end = visibleDraws.size() * (slice + 1) / sliceCount;
+			uint32_t boundInstanceBuffer = UINT32_MAX;
+			for (size_t i = begin; i < end; i++) {
+				auto& item = drawList[visibleDraws[i]];
+				if (item.firstIndex >= residentIndexCount) continue;
+				if (item.instanceBuffer != boundInstanceBuffer) {
+					DrawConstants constants{ item.instanceBuffer };
+					commandBuffer.pushConstants(pipelineLayout, ShaderStageFlagBits::eVertex, 0, sizeof(constants), &constants);
+					boundInstanceBuffer = item.instanceBuffer;
+				}
+				commandBuffer.drawIndexed(std::min(item.indexCount, residentIndexCount - item.firstIndex), 1, item.firstIndex, 0, item.firstInstance);
+			}
+		}
+		// Drawn last, over the scene, with the same pipeline; the instances come straight from the simulation.
+		if (particles.Count() > 0 && slice + 1 == sliceCount) {
+			DrawConstants constants{ particles.InstanceSlot(frameValues[currentFrame]) };
+			commandBuffer.pushConstants(pipelineLayout, ShaderStageFlagBits::eVertex, 0, sizeof(constants), &constants);
+			commandBuffer.drawIndexed(3, particles.Count(), particleFirstIndex, 0, 0);
+		}
+		EndLabel(commandBuffer);
+		commandBuffer.end();
+	});
+	auto commandBuffer = frame.primary;
+	CommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = StructureType::eCommandBufferBeginInfo;
+	beginInfo.flags = CommandBufferUsageFlagBits::eOneTimeSubmit;
+	assert(commandBuffer.begin(&beginInfo) == Result::eSuccess);
+	recordedSlices = (uint32_t)sliceCount;
+	if (timestampPool) {
+		commandBuffer.resetQueryPool(timestampPool, currentFrame * 2, 2);
+		commandBuffer.writeTimestamp(PipelineStageFlagBits::eTopOfPipe, timestampPool, currentFrame * 2);
+	}
+	if (particles.Count() > 0) particles.Acquire(commandBuffer, frameValues[currentFrame]);
+	graph.Execute(commandBuffer);
+	if (timestampPool) {
+		commandBuffer.writeTimestamp(PipelineStageFlagBits::eBottomOfPipe, timestampPool, currentFrame * 2 + 1);
+	}
+	commandBuffer.end();
+}
+
+void VulkanApp::BeginLabel(CommandBuffer commandBuffer, const char* name)
+{
+	if (!debugLabels) return;
+	DebugUtilsLabelEXT label{};
+	label.sType = StructureType::eDebugUtilsLabelEXT;
+	label.pLabelName = name;
+	commandBuffer.beginDebugUtilsLabelEXT(&label);
+}
+
+void VulkanApp::EndLabel(CommandBuffer commandBuffer)
+{
+	if (debugLabels) commandBuffer.endDebugUtilsLabelEXT();
+}
+
+void VulkanApp::CalibrateGpuClock()
+{
+	// Timestamp ticks share no epoch with the CPU clock, so anchor them with one timestamp whose completion the CPU
+	// waits for. GPU ranges land late by the wake-up latency of that wait, which is small against a frame.
+	auto commandBuffer = frameResources[0].primary;
+	CommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = StructureType::eCommandBufferBeginInfo;
+	beginInfo.flags = CommandBufferUsageFlagBits::eOneTimeSubmit;
+	assert(commandBuffer.begin(&beginInfo) == Result::eSuccess);
+	commandBuffer.resetQueryPool(timestampPool, 0, 1);
+	commandBuffer.writeTimestamp(PipelineStageFlagBits::eBottomOfPipe, timestampPool, 0);
+	commandBuffer.end();
 	SubmitInfo submitInfo{};
 	submitInfo.sType = StructureType::eSubmitInfo;
-	Semaphore waitSemaphores[] = { imageSemaphores[currentFrame] };
-	PipelineStageFlags waitStages[] = { PipelineStageFlagBits::eColorAttachmentOutput };
-	submitInfo.waitSemaphoreCount = 1;
-	submitInfo.pWaitSemaphores = waitSemaphores;
-	submitInfo.pWaitDstStageMask = waitStages;
 	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &commandBuffers[imageIndex];
-	Semaphore signalSemaphores[] = { renderSemaphores[currentFrame] };
-	submitInfo.signalSemaphoreCount = 1;
-	submitInfo.pSignalSemaphores = signalSemaphores;
-	device.resetFences(1, &fences[currentFrame]);
-	assert(queue.submit(1, &submitInfo, fences[currentFrame]) == Result::eSuccess);
-	PresentInfoKHR presentInfo{};
-	presentInfo.sType = StructureType::ePresentInfoKHR;
-	presentInfo.waitSemaphoreCount = 1;
-	presentInfo.pWaitSemaphores = signalSemaphores;
-	presentInfo.swapchainCount = 1;
-	presentInfo.pSwapchains = &swapchain;
-	presentInfo.pImageIndices = &imageIndex;
-	result = queue.presentKHR(&presentInfo);
-	assert(result == Result::eSuccess);
-	currentFrame = (currentFrame + 1) % MaxFrame;
+	submitInfo.pCommandBuffers = &commandBuffer;
+	assert(queue.submit(1, &submitInfo, nullptr) == Result::eSuccess);
+	queue.waitIdle();
+	auto now = Trace::Now();
+	uint64_t ticks = 0;
+	if (device.getQueryPoolResults(timestampPool, 0, 1, sizeof(ticks), &ticks, sizeof(uint64_t), QueryResultFlagBits::e64) == Result::eSuccess) {
+		gpuTraceOffset = now - (int64_t)(ticks * (double)timestampPeriod);
+	}
+	device.resetCommandPool(frameResources[0].pool, {});
 }
 
-#ifdef _DEBUG
-static VKAPI_ATTR VkBool32 VKAPI_CALL DebugCallback(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity, VkDebugUtilsMessageTypeFlagsEXT messageType, const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData, void* pUserData) {
-	if (messageType & (VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT))
-	{
-		MessageBoxA(nullptr, pCallbackData->pMessage, "validation layer ", MB_ICONERROR);
+bool VulkanApp::ReadbackFrame(std::vector<uint8_t>& pixels)
+{
+	if (readbackData == nullptr || lastImage == UINT32_MAX) return false;
+	pacer.Wait(imageValues[lastImage]);
+	size_t frameSize = (size_t)swapchainExtent.width * swapchainExtent.height * 4;
+	pixels.resize(frameSize);
+	memcpy(pixels.data(), readbackData + frameSize * lastImage, frameSize);
+	return true;
+}
+
+bool VulkanApp::DumpFrame(const std::string& path)
+{
+	std::vector<uint8_t> pixels;
+	if (!ReadbackFrame(pixels)) return false;
+	std::ofstream file(path, std::ios::binary);
+	if (!file.is_open()) return false;
+	file << "P6\n" << swapchainExtent.width << " " << swapchainExtent.height << "\n255\n";
+	for (size_t i = 0; i < pixels.size(); i += 4) {
+		file.write(reinterpret_cast<const char*>(&pixels[i]), 3);
 	}
-	return VK_FALSE;
+	return file.good();
 }
-#endif
 
-VulkanApp::VulkanApp() : hwnd(CreateWindowEx(0, WndClsName, L"vulkan", WS_OVERLAPPEDWINDOW & ~(WS_MAXIMIZEBOX | WS_SIZEBOX), 200, 200, 1280, 720, nullptr, nullptr, nullptr, this))
+VulkanApp::VulkanApp(const AppConfig& config) : config(config), framesInFlight(FramesInFlight(config.pacing, config.framesInFlight)),
+	window(config.headless ? CreateHeadlessWindow() : CreateNativeWindow(config.width, config.height))
 {
-	if (hwnd == nullptr) throw std::exception("null pointer exception");
+	if (!config.tracePath.empty()) Trace::Start();
+	Trace::SetThreadName("main");
+	TracePhases phases;
+	currentFrame = 0;
+	startTime = std::chrono::steady_clock::now();
+	workers = std::make_unique<ThreadPool>(config.recordThreads > 0 ? config.recordThreads - 1 : std::max(1u, std::thread::hardware_concurrency()) - 1);
+	MeshSource generated;
+	if (!config.meshPath.empty()) {
+		meshOpenTime = std::chrono::steady_clock::now();
+		mesh.Open(config.meshPath);
+		auto& header = mesh.Header();
+		vertexFormat = header.vertexFormat;
+		std::copy_n(header.boundsMin, 3, boundsMin);
+		std::copy_n(header.boundsMax, 3, boundsMax);
+		meshLoad.bytes = mesh.SizeBytes();
+		meshLoad.open = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - meshOpenTime).count();
+	}
+	else {
+		generated = GenerateTriangles(std::max(1u, config.triangleCount));
+		MeshBounds(generated, boundsMin, boundsMax);
+		if (config.particleCount > 0) {
+			// Particles are instances of one small triangle centered on the origin, stored after the scene's and
+			// inside its bounds so the quantization covers it.
+			uint32_t base = (uint32_t)(generated.positions.size() / 3);
+			particleFirstIndex = (uint32_t)generated.indices.size();
+			generated.positions.insert(generated.positions.end(), { 0.0f, -0.5f, 0, 0.433f, 0.25f, 0, -0.433f, 0.25f, 0 });
+			generated.colors.insert(generated.colors.end(), { 1.0f, 1.0f, 1.0f, 1, 1.0f, 1.0f, 1.0f, 1, 1.0f, 1.0f, 1.0f, 1 });
+			generated.indices.insert(generated.indices.end(), { base, base + 1, base + 2 });
+		}
+	}
+	if (vertexFormat == MeshVertexFormat::PositionColorPacked) quantization = PositionQuantization::FromBounds(boundsMin, boundsMax);
 #pragma region CreateInstance
+	phases.Next("CreateInstance");
 	{
+		Dispatch::LoadLoader();
 		ApplicationInfo appInfo{};
 		appInfo.sType = StructureType::eApplicationInfo;
 		appInfo.pNext = nullptr;
@@ -103,34 +494,46 @@ VulkanApp::VulkanApp() : hwnd(CreateWindowEx(0, WndClsName, L"vulkan", WS_OVERLA
 		createInfo.sType = StructureType::eInstanceCreateInfo;
 		createInfo.pNext = nullptr;
 		createInfo.pApplicationInfo = &appInfo;
-		std::vector<const char*> enabledExtensions{
+		std::vector<const char*> enabledExtensions = window->InstanceExtensions();
 #ifdef _DEBUG
-			VK_EXT_DEBUG_UTILS_EXTENSION_NAME,
+		debugLabels = true;
+#else
+		// Release builds only pay for debug utils when tracing, so captures carry the same labels as the trace.
+		if (!config.tracePath.empty()) {
+			uint32_t extensionCount = 0;
+			enumerateInstanceExtensionProperties(nullptr, &extensionCount, nullptr);
+			std::vector<ExtensionProperties> extensions(extensionCount);
+			enumerateInstanceExtensionProperties(nullptr, &extensionCount, extensions.data());
+			for (auto& extension : extensions) {
+				if (strcmp(extension.extensionName, VK_EXT_DEBUG_UTILS_EXTENSION_NAME) == 0) debugLabels = true;
+			}
+		}
 #endif
-			VK_KHR_SURFACE_EXTENSION_NAME,
-			VK_KHR_WIN32_SURFACE_EXTENSION_NAME,
-		};
+		if (debugLabels) enabledExtensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
 		createInfo.enabledExtensionCount = enabledExtensions.size();
 		createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 		auto result = createInstance(&createInfo, nullptr, &instance);
 		assert(result == Result::eSuccess);
-		void LoadReferences(VkInstance);
-		LoadReferences(instance);
+		Dispatch::LoadInstance(instance);
 	}
 #pragma endregion
 #pragma region SetupDebug
+	phases.Next("SetupDebug");
 #ifdef _DEBUG
 	{
 		DebugUtilsMessengerCreateInfoEXT createInfo{};
 		createInfo.sType = StructureType::eDebugUtilsMessengerCreateInfoEXT;
-		createInfo.messageSeverity = DebugUtilsMessageSeverityFlagBitsEXT::eVerbose | DebugUtilsMessageSeverityFlagBitsEXT::eError | DebugUtilsMessageSeverityFlagBitsEXT::eWarning;
+		validationLog = std::make_unique<ValidationLog>();
+		createInfo.messageSeverity = DebugUtilsMessageSeverityFlagsEXT(SeverityMask(config.validationSeverity));
 		createInfo.messageType = DebugUtilsMessageTypeFlagBitsEXT::eGeneral | DebugUtilsMessageTypeFlagBitsEXT::eValidation | DebugUtilsMessageTypeFlagBitsEXT::ePerformance;
-		createInfo.pfnUserCallback = DebugCallback;
+		createInfo.pfnUserCallback = ValidationLog::Callback;
+		createInfo.pUserData = validationLog.get();
 		debugger = instance.createDebugUtilsMessengerEXT(createInfo, nullptr);
 	}
 #endif
 #pragma endregion
 #pragma region CreateDevice
+	phases.Next("CreateDevice");
 	{
 		uint32_t deviceCount = 0;
 		auto result = instance.enumeratePhysicalDevices(&deviceCount, nullptr);
@@ -139,415 +542,772 @@ VulkanApp::VulkanApp() : hwnd(CreateWindowEx(0, WndClsName, L"vulkan", WS_OVERLA
 		std::vector<PhysicalDevice> physicalDevices(deviceCount);
 		result = instance.enumeratePhysicalDevices(&deviceCount, physicalDevices.data());
 		assert(result == Result::eSuccess);
-		physicalDevice = physicalDevices[0];
+		// Every adapter is described and scored, so the log explains the pick and why the others lost.
+		std::vector<AdapterInfo> adapters;
+		for (auto candidate : physicalDevices) {
+			adapters.push_back(DescribeAdapter(candidate, [&](uint32_t family) { return window->PresentationSupport(candidate, family); }));
+		}
+		DeviceRequirements requirements;
+		requirements.present = !config.headless;
+		std::vector<AdapterScore> scores;
+		int chosen = SelectAdapter(adapters, requirements, config.adapter, scores);
+		for (size_t i = 0; i < adapters.size(); i++) {
+			Log("adapter %zu: %s (%s, %llu MiB): %s", i, adapters[i].name.c_str(), AdapterTypeName(adapters[i].type),
+				(unsigned long long)(adapters[i].localHeapBytes >> 20), scores[i].suitable ? std::to_string(scores[i].score).c_str() : scores[i].reason.c_str());
+		}
+		if (chosen < 0) throw std::runtime_error("no suitable Vulkan adapter");
+		physicalDevice = physicalDevices[chosen];
+		auto& adapter = adapters[chosen];
+		graphicsFamily = scores[chosen].queues.graphics;
+		computeFamily = scores[chosen].queues.compute;
+		transferFamily = scores[chosen].queues.transfer;
+		Log("adapter: using %s, graphics family %u, compute family %u, transfer family %u", adapter.name.c_str(), graphicsFamily, computeFamily, transferFamily);
 		float priorities[] = { 1.0f };
-		DeviceQueueCreateInfo queueInfo{};
-		queueInfo.sType = StructureType::eDeviceQueueCreateInfo;
-		queueInfo.pNext = nullptr;
-		queueInfo.queueFamilyIndex = 0;
-		queueInfo.queueCount = 1;
-		queueInfo.pQueuePriorities = priorities;
-		std::vector<const char*> enabledExtensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
+		std::vector<DeviceQueueCreateInfo> queueInfos;
+		for (uint32_t family : { graphicsFamily, computeFamily, transferFamily }) {
+			if (std::any_of(queueInfos.begin(), queueInfos.end(), [&](const DeviceQueueCreateInfo& info) { return info.queueFamilyIndex == family; })) continue;
+			DeviceQueueCreateInfo queueInfo{};
+			queueInfo.sType = StructureType::eDeviceQueueCreateInfo;
+			queueInfo.queueFamilyIndex = family;
+			queueInfo.queueCount = 1;
+			queueInfo.pQueuePriorities = priorities;
+			queueInfos.push_back(queueInfo);
+		}
+		std::vector<const char*> enabledExtensions;
+		if (!config.headless) enabledExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+		PhysicalDeviceProperties properties;
+		physicalDevice.getProperties(&properties);
+		auto& supportedFeatures = adapter.features;
+		auto& supported12 = adapter.features12;
+		// Indirect draws need multiDrawIndirect to cover the scene in one command and drawIndirectFirstInstance to
+		// address instances; each is optional and RecordFrame falls back to what is supported.
+		PhysicalDeviceFeatures enabledFeatures{};
+		enabledFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+		enabledFeatures.drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance;
+		PhysicalDeviceVulkan12Features enabled12{};
+		enabled12.sType = StructureType::ePhysicalDeviceVulkan12Features;
+		enabled12.drawIndirectCount = supported12.drawIndirectCount;
+		enabled12.timelineSemaphore = VK_TRUE;
+		multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+		drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance;
+		drawIndirectCount = supported12.drawIndirectCount;
+		if (!BindlessTable::EnableFeatures(supported12, enabled12)) throw std::runtime_error("descriptor indexing is required");
+		// Dynamic rendering begins passes straight on image views, so a resize leaves render passes and
+		// framebuffers out of it entirely; without it the render graph falls back to render pass objects.
+		PhysicalDeviceDynamicRenderingFeaturesKHR enabledDynamicRendering{};
+		enabledDynamicRendering.sType = StructureType::ePhysicalDeviceDynamicRenderingFeaturesKHR;
+		dynamicRendering = config.dynamicRendering && adapter.dynamicRendering;
+		if (dynamicRendering) {
+			enabledDynamicRendering.dynamicRendering = VK_TRUE;
+			enabled12.pNext = &enabledDynamicRendering;
+			enabledExtensions.push_back(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+		}
+		if (config.dynamicResolution) {
+			// The scaled scene is stretched into the output with a linear blit.
+			FormatProperties formatProperties;
+			physicalDevice.getFormatProperties(Format::eR8G8B8A8Unorm, &formatProperties);
+			auto required = FormatFeatureFlagBits::eColorAttachment | FormatFeatureFlagBits::eBlitSrc | FormatFeatureFlagBits::eBlitDst | FormatFeatureFlagBits::eSampledImageFilterLinear;
+			dynamicResolution = (formatProperties.optimalTilingFeatures & required) == required;
+			if (!dynamicResolution) Log("dynamic resolution: linear blits unsupported, rendering at full resolution");
+		}
+		capturing = !config.capture.directory.empty();
 		DeviceCreateInfo deviceInfo{};
 		deviceInfo.sType = StructureType::eDeviceCreateInfo;
-		deviceInfo.pNext = nullptr;
-		deviceInfo.queueCreateInfoCount = 1;
-		deviceInfo.pQueueCreateInfos = &queueInfo;
+		deviceInfo.pNext = &enabled12;
+		deviceInfo.queueCreateInfoCount = queueInfos.size();
+		deviceInfo.pQueueCreateInfos = queueInfos.data();
 		deviceInfo.enabledExtensionCount = enabledExtensions.size();
 		deviceInfo.ppEnabledExtensionNames = enabledExtensions.data();
-		deviceInfo.pEnabledFeatures = nullptr;
+		deviceInfo.pEnabledFeatures = &enabledFeatures;
 		result = physicalDevice.createDevice(&deviceInfo, nullptr, &device);
 		assert(result == Result::eSuccess);
-		device.getQueue(0, 0, &queue);
+		if (config.deviceDispatch) Dispatch::LoadDevice(device);
+		device.getQueue(graphicsFamily, 0, &queue);
+		device.getQueue(computeFamily, 0, &computeQueue);
+		device.getQueue(transferFamily, 0, &transferQueue);
+		allocator.Create(physicalDevice, device);
+		deletions.Create(device, allocator);
+		if (adapter.families[graphicsFamily].timestampValidBits > 0 && properties.limits.timestampPeriod > 0) {
+			timestampPeriod = properties.limits.timestampPeriod;
+		}
 	}
 #pragma endregion
 #pragma region CreateSwapchain
-	Extent2D swapchainExtent{};
-	{
-		Win32SurfaceCreateInfoKHR surfaceCreateInfo{};
-		surfaceCreateInfo.sType = StructureType::eWin32SurfaceCreateInfoKHR;
-		surfaceCreateInfo.pNext = nullptr;
-		surfaceCreateInfo.hinstance = GetModuleHandle(nullptr);
-		surfaceCreateInfo.hwnd = hwnd;
-		auto result = instance.createWin32SurfaceKHR(&surfaceCreateInfo, nullptr, &surface);
-		assert(result == Result::eSuccess);
-	}
-	{
-		SurfaceCapabilitiesKHR caps{};
-		auto result = physicalDevice.getSurfaceCapabilitiesKHR(surface, &caps);
-		assert(result == Result::eSuccess);
-		if (caps.currentExtent.width == -1 || caps.currentExtent.height == -1) {
-			swapchainExtent.width = 1280;
-			swapchainExtent.height = 720;
-		}
-		else {
-			swapchainExtent = caps.currentExtent;
-		}
+	phases.Next("CreateSwapchain");
+	if (!config.headless) {
+		surface = window->CreateSurface(instance);
+		windowExtent = Extent2D(config.width, config.height);
 		uint32_t presentModeCount = 0;
-		result = physicalDevice.getSurfacePresentModesKHR(surface, &presentModeCount, nullptr);
+		auto result = physicalDevice.getSurfacePresentModesKHR(surface, &presentModeCount, nullptr);
 		assert(result == Result::eSuccess);
 		assert(presentModeCount >= 1);
 		std::vector<PresentModeKHR> presentModes(presentModeCount);
 		result = physicalDevice.getSurfacePresentModesKHR(surface, &presentModeCount, presentModes.data());
 		assert(result == Result::eSuccess);
-		PresentModeKHR presentMode = (PresentModeKHR)-1;
-		for (uint32_t i = 0; i < presentModeCount; i++) {
-			if (presentModes[i] == PresentModeKHR::eImmediate) {
-				presentMode = PresentModeKHR::eImmediate;
+		std::vector<PresentModeKHR> preferred;
+		if (config.pacing == PacingMode::LowLatency) preferred = { PresentModeKHR::eMailbox, PresentModeKHR::eImmediate };
+		else if (config.pacing == PacingMode::Throughput) preferred = { PresentModeKHR::eImmediate, PresentModeKHR::eMailbox };
+		// FIFO is the one mode every surface must support.
+		presentMode = PresentModeKHR::eFifo;
+		for (auto mode : preferred) {
+			if (std::find(presentModes.begin(), presentModes.end(), mode) != presentModes.end()) {
+				presentMode = mode;
 				break;
 			}
 		}
-		if (presentMode == (PresentModeKHR)-1) throw std::exception("no present mode support");
-		assert(caps.maxImageCount >= 1);
-		uint32_t imageCount = 2;
-		SwapchainCreateInfoKHR swapchainCreateInfo = {};
-		swapchainCreateInfo.sType = StructureType::eSwapchainCreateInfoKHR;
-		swapchainCreateInfo.surface = surface;
-		swapchainCreateInfo.minImageCount = imageCount;
-		swapchainCreateInfo.imageFormat = Format::eR8G8B8A8Unorm;
-		swapchainCreateInfo.imageColorSpace = ColorSpaceKHR::eSrgbNonlinear;
-		swapchainCreateInfo.imageExtent = swapchainExtent;
-		swapchainCreateInfo.imageArrayLayers = 1;
-		swapchainCreateInfo.imageUsage = ImageUsageFlagBits::eColorAttachment;
-		swapchainCreateInfo.imageSharingMode = SharingMode::eExclusive;
-		swapchainCreateInfo.queueFamilyIndexCount = 1;
-		swapchainCreateInfo.pQueueFamilyIndices = { 0 };
-		swapchainCreateInfo.preTransform = SurfaceTransformFlagBitsKHR::eIdentity;
-		swapchainCreateInfo.compositeAlpha = CompositeAlphaFlagBitsKHR::eOpaque;
-		swapchainCreateInfo.presentMode = presentMode;
-		result = device.createSwapchainKHR(&swapchainCreateInfo, nullptr, &swapchain);
-		assert(result == Result::eSuccess);
-		result = device.getSwapchainImagesKHR(swapchain, &imageCount, nullptr);
-		assert(result == Result::eSuccess);
-		assert(imageCount > 0);
-		images.resize(imageCount);
-		result = device.getSwapchainImagesKHR(swapchain, &imageCount, images.data());
-		assert(result == Result::eSuccess);
-		views.resize(imageCount);
-		for (auto i = 0; i < imageCount; i++) {
-			ImageViewCreateInfo createInfo{};
-			createInfo.sType = StructureType::eImageViewCreateInfo;
-			createInfo.image = images[i];
-			createInfo.viewType = ImageViewType::e2D;
-			createInfo.format = swapchainCreateInfo.imageFormat;
-			createInfo.components.r = ComponentSwizzle::eIdentity;
-			createInfo.components.g = ComponentSwizzle::eIdentity;
-			createInfo.components.b = ComponentSwizzle::eIdentity;
-			createInfo.components.a = ComponentSwizzle::eIdentity;
-			createInfo.subresourceRange.aspectMask = ImageAspectFlagBits::eColor;
-			createInfo.subresourceRange.baseMipLevel = 0;
-			createInfo.subresourceRange.levelCount = 1;
-			createInfo.subresourceRange.baseArrayLayer = 0;
-			createInfo.subresourceRange.layerCount = 1;
-			result = device.createImageView(&createInfo, nullptr, &views[i]);
-			assert(result == Result::eSuccess);
+		Log("present: %s mode, %s, %u frames in flight", PacingModeName(config.pacing), to_string(presentMode).c_str(), framesInFlight);
+		if (!CreateSwapchain()) throw std::runtime_error("window has no area to present to");
+	}
+#pragma endregion
+#pragma region CreateOffscreenTargets
+	phases.Next("CreateOffscreenTargets");
+	if (config.headless) {
+		swapchainExtent = Extent2D(config.width, config.height);
+		for (uint32_t i = 0; i < framesInFlight; i++) {
+			ImageCreateInfo imageInfo{};
+			imageInfo.sType = StructureType::eImageCreateInfo;
+			imageInfo.imageType = ImageType::e2D;
+			imageInfo.format = Format::eR8G8B8A8Unorm;
+			imageInfo.extent = Extent3D(swapchainExtent, 1);
+			imageInfo.mipLevels = 1;
+			imageInfo.arrayLayers = 1;
+			imageInfo.samples = SampleCountFlagBits::e1;
+			imageInfo.tiling = ImageTiling::eOptimal;
+			imageInfo.usage = ImageUsageFlagBits::eColorAttachment | ImageUsageFlagBits::eTransferSrc;
+			if (dynamicResolution) imageInfo.usage |= ImageUsageFlagBits::eTransferDst;
+			imageInfo.sharingMode = SharingMode::eExclusive;
+			imageInfo.initialLayout = ImageLayout::eUndefined;
+			offscreenImages.push_back(deletions.CreateImage(imageInfo, MemoryPropertyFlagBits::eDeviceLocal));
+			images.push_back(offscreenImages.back().Get());
+		}
+		if (config.readback) {
+			BufferCreateInfo bufferInfo{};
+			bufferInfo.sType = StructureType::eBufferCreateInfo;
+			bufferInfo.size = (DeviceSize)swapchainExtent.width * swapchainExtent.height * 4 * framesInFlight;
+			bufferInfo.usage = BufferUsageFlagBits::eTransferDst;
+			bufferInfo.sharingMode = SharingMode::eExclusive;
+			readbackBuffer = deletions.CreateBuffer(bufferInfo, MemoryPropertyFlagBits::eHostVisible | MemoryPropertyFlagBits::eHostCoherent);
+			readbackData = static_cast<uint8_t*>(readbackBuffer.Memory().mapped);
 		}
 	}
+	CreateViews();
 #pragma endregion
-#pragma region CreateRenderPass
+#pragma region CreateRenderGraph
+	phases.Next("CreateRenderGraph");
 	{
-		AttachmentDescription colorAttachment{};
-		colorAttachment.format = Format::eR8G8B8A8Unorm;
-		colorAttachment.samples = SampleCountFlagBits::e1;
-		colorAttachment.loadOp = AttachmentLoadOp::eClear;
-		colorAttachment.storeOp = AttachmentStoreOp::eStore;
-		colorAttachment.stencilLoadOp = AttachmentLoadOp::eDontCare;
-		colorAttachment.stencilStoreOp = AttachmentStoreOp::eDontCare;
-		colorAttachment.initialLayout = ImageLayout::eUndefined;
-		colorAttachment.finalLayout = ImageLayout::ePresentSrcKHR;
-		AttachmentReference colorAttachmentRef{};
-		colorAttachmentRef.attachment = 0;
-		colorAttachmentRef.layout = ImageLayout::eColorAttachmentOptimal;
-		SubpassDescription subpass{};
-		subpass.pipelineBindPoint = PipelineBindPoint::eGraphics;
-		subpass.colorAttachmentCount = 1;
-		subpass.pColorAttachments = &colorAttachmentRef;
-		SubpassDependency dependency{};
-		dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-		dependency.dstSubpass = 0;
-		dependency.srcStageMask = PipelineStageFlagBits::eColorAttachmentOutput;
-		dependency.srcAccessMask = AccessFlagBits::eNoneKHR;
-		dependency.dstStageMask = PipelineStageFlagBits::eColorAttachmentOutput;
-		dependency.dstAccessMask = AccessFlagBits::eColorAttachmentWrite;
-		RenderPassCreateInfo renderPassInfo = {};
-		renderPassInfo.sType = StructureType::eRenderPassCreateInfo;
-		renderPassInfo.attachmentCount = 1;
-		renderPassInfo.pAttachments = &colorAttachment;
-		renderPassInfo.subpassCount = 1;
-		renderPassInfo.pSubpasses = &subpass;
-		renderPassInfo.dependencyCount = 1;
-		renderPassInfo.pDependencies = &dependency;
-		assert(device.createRenderPass(&renderPassInfo, nullptr, &renderPass) == Result::eSuccess);
+		graph.Create(device, allocator, deletions, dynamicRendering);
+		// Swapchain images arrive through the acquire semaphore, which is waited on at color output. Offscreen
+		// images were last written or copied from by this frame slot's previous frame.
+		RenderGraph::State initial{ PipelineStageFlagBits::eColorAttachmentOutput, {}, ImageLayout::eUndefined };
+		RenderGraph::State final{};
+		if (config.headless) initial.stages |= PipelineStageFlagBits::eTransfer;
+		else final = { PipelineStageFlagBits::eBottomOfPipe, {}, ImageLayout::ePresentSrcKHR };
+		colorTarget = graph.ImportImage("color", Format::eR8G8B8A8Unorm, swapchainExtent, initial, final);
+		renderExtent = swapchainExtent;
+		if (dynamicResolution) {
+			// GPU times are read back one frame slot later, so that many samples still describe the previous scale.
+			resolution.Configure(config.resolution, framesInFlight);
+			sceneTarget = graph.CreateImage("scene", Format::eR8G8B8A8Unorm, ResolutionController::Apply(swapchainExtent, resolution.MaxScale()));
+			Log("dynamic resolution: %.1fms target, scale %.2f to %.2f", config.resolution.targetMs, config.resolution.minScale, resolution.MaxScale());
+		}
+		auto sceneColor = dynamicResolution ? sceneTarget : colorTarget;
+		scenePass = graph.AddPass("scene", [this](const RenderGraph::PassContext& context) {
+			BeginLabel(context.commandBuffer, "scene");
+			context.commandBuffer.executeCommands(recordedSlices, frameResources[currentFrame].secondaries.data());
+			EndLabel(context.commandBuffer);
+		}, SubpassContents::eSecondaryCommandBuffers);
+		graph.Write(scenePass, sceneColor, RenderGraph::Access::ColorAttachment, AttachmentLoadOp::eClear, ClearColorValue(std::array<float, 4>{ 0.0f, 1.0f, 1.0f, 1.0f }));
+		if (dynamicResolution) {
+			auto upscalePass = graph.AddPass("upscale", [this](const RenderGraph::PassContext& context) {
+				BeginLabel(context.commandBuffer, "upscale");
+				// The scene only covers the top-left renderExtent of its target this frame.
+				ImageBlit region{};
+				region.srcSubresource.aspectMask = ImageAspectFlagBits::eColor;
+				region.srcSubresource.layerCount = 1;
+				region.srcOffsets[1] = Offset3D((int32_t)renderExtent.width, (int32_t)renderExtent.height, 1);
+				region.dstSubresource = region.srcSubresource;
+				region.dstOffsets[1] = Offset3D((int32_t)swapchainExtent.width, (int32_t)swapchainExtent.height, 1);
+				context.commandBuffer.blitImage(graph.Image(sceneTarget), ImageLayout::eTransferSrcOptimal, graph.Image(colorTarget), ImageLayout::eTransferDstOptimal, 1, &region, Filter::eLinear);
+				EndLabel(context.commandBuffer);
+			});
+			graph.Read(upscalePass, sceneTarget, RenderGraph::Access::TransferSrc);
+			graph.Write(upscalePass, colorTarget, RenderGraph::Access::TransferDst);
+		}
+		if (readbackBuffer) {
+			readbackTarget = graph.ImportBuffer("readback", {}, { PipelineStageFlagBits::eHost, AccessFlagBits::eHostRead });
+			graph.BindBuffer(readbackTarget, readbackBuffer.Get());
+			auto readbackPass = graph.AddPass("readback", [this](const RenderGraph::PassContext& context) {
+				BeginLabel(context.commandBuffer, "readback");
+				// Readback only exists offscreen, where each frame slot renders into its own image.
+				BufferImageCopy region{};
+				region.bufferOffset = (DeviceSize)swapchainExtent.width * swapchainExtent.height * 4 * currentFrame;
+				region.imageSubresource.aspectMask = ImageAspectFlagBits::eColor;
+				region.imageSubresource.layerCount = 1;
+				region.imageExtent = Extent3D(swapchainExtent, 1);
+				context.commandBuffer.copyImageToBuffer(graph.Image(colorTarget), ImageLayout::eTransferSrcOptimal, readbackBuffer.Get(), 1, &region);
+				EndLabel(context.commandBuffer);
+			});
+			graph.Read(readbackPass, colorTarget, RenderGraph::Access::TransferSrc);
+			graph.Write(readbackPass, readbackTarget, RenderGraph::Access::TransferDst);
+		}
+		if (capturing) {
+			capture.Create(allocator, deletions, config.capture, swapchainExtent);
+			// Rebound every frame to the slot DrawFrame claimed; the host reads it once the frame has completed.
+			captureTarget = graph.ImportBuffer("capture", {}, { PipelineStageFlagBits::eHost, AccessFlagBits::eHostRead });
+			graph.BindBuffer(captureTarget, capture.Target());
+			auto capturePass = graph.AddPass("capture", [this](const RenderGraph::PassContext& context) {
+				// A frame dropped for a full ring keeps the pass and its barriers but copies nothing.
+				if (!capture.Claimed()) return;
+				BeginLabel(context.commandBuffer, "capture");
+				BufferImageCopy region{};
+				region.imageSubresource.aspectMask = ImageAspectFlagBits::eColor;
+				region.imageSubresource.layerCount = 1;
+				region.imageExtent = Extent3D(swapchainExtent, 1);
+				context.commandBuffer.copyImageToBuffer(graph.Image(colorTarget), ImageLayout::eTransferSrcOptimal, capture.Target(), 1, &region);
+				EndLabel(context.commandBuffer);
+			});
+			graph.Read(capturePass, colorTarget, RenderGraph::Access::TransferSrc);
+			graph.Write(capturePass, captureTarget, RenderGraph::Access::TransferDst);
+		}
+		graph.Compile();
 	}
 #pragma endregion
 #pragma region CreatePipeline
+	phases.Next("CreatePipeline");
 	{
-		auto&& vertexShaderCode = ReadFile("vs.spv");
-		auto&& pixelShaderCode = ReadFile("ps.spv");
-		auto&& vertexShaderModule = CreateShaderModule(vertexShaderCode);
-		auto&& pixelShaderModule = CreateShaderModule(pixelShaderCode);
-		PipelineShaderStageCreateInfo vertexShaderStageInfo{};
-		vertexShaderStageInfo.sType = StructureType::ePipelineShaderStageCreateInfo;
-		vertexShaderStageInfo.stage = ShaderStageFlagBits::eVertex;
-		vertexShaderStageInfo.module = vertexShaderModule;
-		vertexShaderStageInfo.pName = "main";
-		PipelineShaderStageCreateInfo pixelShaderStageInfo{};
-		pixelShaderStageInfo.sType = StructureType::ePipelineShaderStageCreateInfo;
-		pixelShaderStageInfo.stage = ShaderStageFlagBits::eFragment;
-		pixelShaderStageInfo.module = pixelShaderModule;
-		pixelShaderStageInfo.pName = "main";
-		PipelineShaderStageCreateInfo shaderStages[] = { vertexShaderStageInfo, pixelShaderStageInfo };
-		auto bindingDescription = Vertex::GetBindingDescription();
-		auto attributeDescriptions = Vertex::GetAttributeDescriptions();
-		PipelineVertexInputStateCreateInfo vertexInputInfo{};
-		vertexInputInfo.sType = StructureType::ePipelineVertexInputStateCreateInfo;
-		vertexInputInfo.vertexBindingDescriptionCount = 1;
-		vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
-		vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
-		vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
-		PipelineInputAssemblyStateCreateInfo inputAssembly{};
-		inputAssembly.sType = StructureType::ePipelineInputAssemblyStateCreateInfo;
-		inputAssembly.topology = PrimitiveTopology::eTriangleList;
-		inputAssembly.primitiveRestartEnable = VK_FALSE;
-		Viewport viewport{};
-		viewport.x = 0.0f;
-		viewport.y = 0.0f;
-		viewport.width = (float)swapchainExtent.width;
-		viewport.height = (float)swapchainExtent.height;
-		viewport.minDepth = 0.0f;
-		viewport.maxDepth = 1.0f;
-		Rect2D scissor{};
-		scissor.offset = { { 0, 0 } };
-		scissor.extent = swapchainExtent;
-		PipelineViewportStateCreateInfo viewportState{};
-		viewportState.sType = StructureType::ePipelineViewportStateCreateInfo;
-		viewportState.viewportCount = 1;
-		viewportState.pViewports = &viewport;
-		viewportState.scissorCount = 1;
-		viewportState.pScissors = &scissor;
-		PipelineRasterizationStateCreateInfo rasterizer{};
-		rasterizer.sType = StructureType::ePipelineRasterizationStateCreateInfo;
-		rasterizer.depthClampEnable = VK_FALSE;
-		rasterizer.rasterizerDiscardEnable = VK_FALSE;
-		rasterizer.polygonMode = PolygonMode::eFill;
-		rasterizer.lineWidth = 1.0f;
-		rasterizer.cullMode = CullModeFlagBits::eBack;
-		rasterizer.frontFace = FrontFace::eClockwise;
-		rasterizer.depthBiasEnable = VK_FALSE;
-		PipelineMultisampleStateCreateInfo multisampling{};
-		multisampling.sType = StructureType::ePipelineMultisampleStateCreateInfo;
-		multisampling.sampleShadingEnable = VK_FALSE;
-		multisampling.rasterizationSamples = SampleCountFlagBits::e1;
-		PipelineColorBlendAttachmentState colorBlendAttachment{};
-		colorBlendAttachment.colorWriteMask = ColorComponentFlagBits::eR | ColorComponentFlagBits::eG | ColorComponentFlagBits::eB | ColorComponentFlagBits::eA;
-		colorBlendAttachment.blendEnable = VK_FALSE;
-		PipelineColorBlendStateCreateInfo colorBlending{};
-		colorBlending.sType = StructureType::ePipelineColorBlendStateCreateInfo;
-		colorBlending.logicOpEnable = VK_FALSE;
-		colorBlending.logicOp = LogicOp::eCopy;
-		colorBlending.attachmentCount = 1;
-		colorBlending.pAttachments = &colorBlendAttachment;
-		colorBlending.blendConstants[0] = 0.0f;
-		colorBlending.blendConstants[1] = 0.0f;
-		colorBlending.blendConstants[2] = 0.0f;
-		colorBlending.blendConstants[3] = 0.0f;
+		bindless.Create(physicalDevice, device);
+		uniforms.Create(physicalDevice, device, allocator, framesInFlight);
+		DescriptorSetLayout setLayouts[] = { bindless.Layout(), uniforms.Layout() };
+		PushConstantRange pushConstantRange{};
+		pushConstantRange.stageFlags = ShaderStageFlagBits::eVertex;
+		pushConstantRange.offset = 0;
+		pushConstantRange.size = sizeof(DrawConstants);
 		PipelineLayoutCreateInfo pipelineLayoutInfo{};
 		pipelineLayoutInfo.sType = StructureType::ePipelineLayoutCreateInfo;
-		pipelineLayoutInfo.setLayoutCount = 0;
-		pipelineLayoutInfo.pushConstantRangeCount = 0;
+		pipelineLayoutInfo.setLayoutCount = 2;
+		pipelineLayoutInfo.pSetLayouts = setLayouts;
+		pipelineLayoutInfo.pushConstantRangeCount = 1;
+		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
 		assert(device.createPipelineLayout(&pipelineLayoutInfo, nullptr, &pipelineLayout) == Result::eSuccess);
-		GraphicsPipelineCreateInfo pipelineInfo{};
-		pipelineInfo.sType = StructureType::eGraphicsPipelineCreateInfo;
-		pipelineInfo.stageCount = 2;
-		pipelineInfo.pStages = shaderStages;
-		pipelineInfo.pVertexInputState = &vertexInputInfo;
-		pipelineInfo.pInputAssemblyState = &inputAssembly;
-		pipelineInfo.pViewportState = &viewportState;
-		pipelineInfo.pRasterizationState = &rasterizer;
-		pipelineInfo.pMultisampleState = &multisampling;
-		pipelineInfo.pColorBlendState = &colorBlending;
-		pipelineInfo.layout = pipelineLayout;
-		pipelineInfo.renderPass = renderPass;
-		pipelineInfo.subpass = 0;
-		pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
-		assert(device.createGraphicsPipelines(VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline) == Result::eSuccess);
-		device.destroyShaderModule(pixelShaderModule, nullptr);
-		device.destroyShaderModule(vertexShaderModule, nullptr);
+		pipelineCache.Create(physicalDevice, device, config.pipelineCachePath);
+		pipelines.Create(device, deletions, pipelineCache.Handle(), pipelineLayout, graph.RenderPass(scenePass), graph.ColorFormats(scenePass), EmbeddedVertexShader(), EmbeddedPixelShader(), *workers);
+		pipelineKey.vertexFormat = vertexFormat;
+		{
+			// The variant every frame starts with is built up front; everything else compiles in the background.
+			ScopeTimer timer(pipelineCreateTime, "createGraphicsPipelines");
+			pipelines.Compile(pipelineKey);
+		}
+		Log("pipeline creation: %.3fms (%s start)", pipelineCreateTime, pipelineCache.IsWarm() ? "warm" : "cold");
+		if (config.pipelineVariants) {
+			std::vector<PipelineKey> keys;
+			for (auto blend : { BlendMode::Opaque, BlendMode::Alpha, BlendMode::Additive }) {
+				for (auto cullMode : { CullModeFlagBits::eBack, CullModeFlagBits::eNone, CullModeFlagBits::eFront }) {
+					for (auto colorSource : { ColorSource::VertexTimesInstance, ColorSource::Vertex, ColorSource::Instance }) {
+						PipelineKey key = pipelineKey;
+						key.blend = blend;
+						key.cullMode = cullMode;
+						key.constants[0] = (uint32_t)colorSource;
+						keys.push_back(key);
+					}
+				}
+			}
+			pipelines.Request(keys);
+			Log("pipeline variants: %zu queued", keys.size());
+		}
+		if (config.shaderHotReload && !config.headless) {
+			shaderWatcher = std::make_unique<ShaderWatcher>(config.shaderDirectory.empty() ? ShaderSourceDirectory() : config.shaderDirectory);
+		}
 	}
 #pragma endregion
 #pragma region CreateOthers
-	{
-		framebuffers.resize(views.size());
-		for (size_t i = 0; i < views.size(); i++) {
-			ImageView attachments[] = { views[i] };
-			FramebufferCreateInfo framebufferInfo{};
-			framebufferInfo.sType = StructureType::eFramebufferCreateInfo;
-			framebufferInfo.renderPass = renderPass;
-			framebufferInfo.attachmentCount = 1;
-			framebufferInfo.pAttachments = attachments;
-			framebufferInfo.width = swapchainExtent.width;
-			framebufferInfo.height = swapchainExtent.height;
-			framebufferInfo.layers = 1;
-			assert(device.createFramebuffer(&framebufferInfo, nullptr, &framebuffers[i]) == Result::eSuccess);
-		}
-	}
+	phases.Next("CreateOthers");
 	{
 		CommandPoolCreateInfo poolInfo{};
 		poolInfo.sType = StructureType::eCommandPoolCreateInfo;
-		poolInfo.queueFamilyIndex = 0;
-		assert(device.createCommandPool(&poolInfo, nullptr, &commandPool) == Result::eSuccess);
+		poolInfo.flags = CommandPoolCreateFlagBits::eTransient;
+		poolInfo.queueFamilyIndex = graphicsFamily;
+		size_t sliceCount = workers->Concurrency();
+		frameResources.resize(framesInFlight);
+		for (auto& frame : frameResources) {
+			assert(device.createCommandPool(&poolInfo, nullptr, &frame.pool) == Result::eSuccess);
+			CommandBufferAllocateInfo allocInfo{};
+			allocInfo.sType = StructureType::eCommandBufferAllocateInfo;
+			allocInfo.commandPool = frame.pool;
+			allocInfo.level = CommandBufferLevel::ePrimary;
+			allocInfo.commandBufferCount = 1;
+			assert(device.allocateCommandBuffers(&allocInfo, &frame.primary) == Result::eSuccess);
+			frame.slicePools.resize(sliceCount);
+			frame.secondaries.resize(sliceCount);
+			for (size_t i = 0; i < sliceCount; i++) {
+				assert(device.createCommandPool(&poolInfo, nullptr, &frame.slicePools[i]) == Result::eSuccess);
+				allocInfo.commandPool = frame.slicePools[i];
+				allocInfo.level = CommandBufferLevel::eSecondary;
+				assert(device.allocateCommandBuffers(&allocInfo, &frame.secondaries[i]) == Result::eSuccess);
+			}
+		}
 	}
-	{
+	uploader.Create(device, allocator, queue, graphicsFamily, transferQueue, transferFamily);
+	if (mesh.IsOpen()) {
+		auto& header = mesh.Header();
+		indexCount = header.indexCount;
+		BufferCreateInfo bufferInfo{};
+		bufferInfo.sType = StructureType::eBufferCreateInfo;
+		bufferInfo.size = (DeviceSize)header.vertexStride * std::max(1u, header.vertexCount);
+		bufferInfo.usage = BufferUsageFlagBits::eVertexBuffer | BufferUsageFlagBits::eTransferDst;
+		bufferInfo.sharingMode = SharingMode::eExclusive;
+		vertexBuffer = deletions.CreateBuffer(bufferInfo, MemoryPropertyFlagBits::eDeviceLocal);
+	}
+	else {
+		auto vertices = PackVertices(generated, quantization);
 		BufferCreateInfo bufferInfo{};
 		bufferInfo.sType = StructureType::eBufferCreateInfo;
 		bufferInfo.size = sizeof(Vertex) * vertices.size();
-		bufferInfo.usage = BufferUsageFlagBits::eVertexBuffer;
+		bufferInfo.usage = BufferUsageFlagBits::eVertexBuffer | BufferUsageFlagBits::eTransferDst;
 		bufferInfo.sharingMode = SharingMode::eExclusive;
-		assert(device.createBuffer(&bufferInfo, nullptr, &vertexBuffer) == Result::eSuccess);
-		MemoryRequirements memRequirements;
-		device.getBufferMemoryRequirements(vertexBuffer, &memRequirements);
-		MemoryAllocateInfo allocInfo{};
-		allocInfo.sType = StructureType::eMemoryAllocateInfo;
-		allocInfo.allocationSize = memRequirements.size;
-		allocInfo.memoryTypeIndex = FindMemoryType(memRequirements.memoryTypeBits, MemoryPropertyFlagBits::eHostVisible | MemoryPropertyFlagBits::eHostCoherent);
-		assert(device.allocateMemory(&allocInfo, nullptr, &vertexBufferMemory) == Result::eSuccess);
-		device.bindBufferMemory(vertexBuffer, vertexBufferMemory, 0);
-		void* data = device.mapMemory(vertexBufferMemory, 0, bufferInfo.size);
-		memcpy(data, vertices.data(), bufferInfo.size);
-		device.unmapMemory(vertexBufferMemory);
+		vertexBuffer = deletions.CreateBuffer(bufferInfo, MemoryPropertyFlagBits::eDeviceLocal);
+		uploader.UploadBuffer(vertexBuffer.Get(), 0, vertices.data(), bufferInfo.size, PipelineStageFlagBits::eVertexInput, AccessFlagBits::eVertexAttributeRead);
+	}
+	if (mesh.IsOpen()) {
+		BufferCreateInfo bufferInfo{};
+		bufferInfo.sType = StructureType::eBufferCreateInfo;
+		bufferInfo.size = sizeof(uint32_t) * std::max(1u, indexCount);
+		bufferInfo.usage = BufferUsageFlagBits::eIndexBuffer | BufferUsageFlagBits::eTransferDst;
+		bufferInfo.sharingMode = SharingMode::eExclusive;
+		indexBuffer = deletions.CreateBuffer(bufferInfo, MemoryPropertyFlagBits::eDeviceLocal);
+	}
+	else {
+		auto& indices = generated.indices;
+		indexCount = (uint32_t)std::min<size_t>(indices.size(), particleFirstIndex);
+		residentIndexCount = indexCount;
+		BufferCreateInfo bufferInfo{};
+		bufferInfo.sType = StructureType::eBufferCreateInfo;
+		bufferInfo.size = sizeof(uint32_t) * indices.size();
+		bufferInfo.usage = BufferUsageFlagBits::eIndexBuffer | BufferUsageFlagBits::eTransferDst;
+		bufferInfo.sharingMode = SharingMode::eExclusive;
+		indexBuffer = deletions.CreateBuffer(bufferInfo, MemoryPropertyFlagBits::eDeviceLocal);
+		uploader.UploadBuffer(indexBuffer.Get(), 0, indices.data(), bufferInfo.size, PipelineStageFlagBits::eVertexInput, AccessFlagBits::eIndexRead);
 	}
 	{
-		commandBuffers.resize(framebuffers.size());
-		CommandBufferAllocateInfo allocInfo{};
-		allocInfo.sType = StructureType::eCommandBufferAllocateInfo;
-		allocInfo.commandPool = commandPool;
-		allocInfo.level = CommandBufferLevel::ePrimary;
-		allocInfo.commandBufferCount = (uint32_t)commandBuffers.size();
-		assert(device.allocateCommandBuffers(&allocInfo, commandBuffers.data()) == Result::eSuccess);
-		for (size_t i = 0; i < commandBuffers.size(); i++) {
-			CommandBufferBeginInfo beginInfo{};
-			beginInfo.sType = StructureType::eCommandBufferBeginInfo;
-			assert(commandBuffers[i].begin(&beginInfo) == Result::eSuccess);
-			RenderPassBeginInfo renderPassInfo{};
-			renderPassInfo.sType = StructureType::eRenderPassBeginInfo;
-			renderPassInfo.renderPass = renderPass;
-			renderPassInfo.framebuffer = framebuffers[i];
-			renderPassInfo.renderArea.offset = { {0, 0} };
-			renderPassInfo.renderArea.extent = swapchainExtent;
-			ClearValue clearColor(ClearColorValue(std::array<float, 4>{0.0f, 1.0f, 1.0f, 1.0f}));
-			renderPassInfo.clearValueCount = 1;
-			renderPassInfo.pClearValues = &clearColor;
-			Buffer vertexBuffers[] = { vertexBuffer };
-			DeviceSize offsets[] = { 0 };
-			commandBuffers[i].beginRenderPass(&renderPassInfo, SubpassContents::eInline);
-			commandBuffers[i].bindPipeline(PipelineBindPoint::eGraphics, graphicsPipeline);
-			commandBuffers[i].bindVertexBuffers(0, 1, vertexBuffers, offsets);
-			commandBuffers[i].draw(3, 1, 0, 0);
-			commandBuffers[i].endRenderPass();
-			commandBuffers[i].end();
+		// Without instances the scene is a single identity instance so the shader path stays the same.
+		float meshRadius = std::max({ std::abs(boundsMin[0]), std::abs(boundsMin[1]), std::abs(boundsMax[0]), std::abs(boundsMax[1]) });
+		std::vector<InstanceData> instances = config.instanceCount > 0 ? GenerateInstances(config.instanceCount, meshRadius)
+			: std::vector<InstanceData>{ { { 0, 0, 1, 0 }, { 1, 1, 1, 1 } } };
+		if (config.instanceCount > 0) {
+			// Taken before the quantization is folded in, while the transforms still map model space.
+			auto meshBounds = SphereFromBox(boundsMin, boundsMax);
+			for (auto& instance : instances) {
+				auto& transform = instance.offsetScale;
+				drawBounds.Push(Affine3::ScaleTranslate({ transform.z, transform.z, transform.z }, { transform.x, transform.y, transform.w }) * meshBounds);
+			}
+		}
+		// Undoing the position quantization is folded into every instance's transform.
+		for (auto& instance : instances) {
+			auto& transform = instance.offsetScale;
+			transform = { transform.x + quantization.center[0] * transform.z, transform.y + quantization.center[1] * transform.z,
+				transform.z * quantization.scale, transform.w + quantization.center[2] * transform.z };
 		}
+		BufferCreateInfo bufferInfo{};
+		bufferInfo.sType = StructureType::eBufferCreateInfo;
+		bufferInfo.size = sizeof(InstanceData) * instances.size();
+		bufferInfo.usage = BufferUsageFlagBits::eStorageBuffer | BufferUsageFlagBits::eTransferDst;
+		bufferInfo.sharingMode = SharingMode::eExclusive;
+		instanceBuffer = deletions.CreateBuffer(bufferInfo, MemoryPropertyFlagBits::eDeviceLocal);
+		uploader.UploadBuffer(instanceBuffer.Get(), 0, instances.data(), bufferInfo.size, PipelineStageFlagBits::eVertexShader, AccessFlagBits::eShaderRead);
+		instanceSlot = bindless.AddBuffer(instanceBuffer.Get());
 	}
+	if (config.instanceCount > 0) {
+		// One object per draw item; the indirect path merges them back into instanced commands.
+		drawList.resize(config.instanceCount);
+		for (uint32_t i = 0; i < config.instanceCount; i++) drawList[i] = { 0, indexCount, i, instanceSlot };
+	}
+	else if (mesh.IsOpen()) {
+		// One draw per chunk, so the per-chunk bounds line up with draws.
+		drawList.resize(mesh.Header().chunkCount);
+		for (uint32_t i = 0; i < drawList.size(); i++) {
+			auto& chunk = mesh.Chunk(i);
+			drawList[i] = { chunk.firstIndex, chunk.indexCount, 0, instanceSlot };
+			drawBounds.Push(SphereFromBox(chunk.boundsMin, chunk.boundsMax));
+		}
+	}
+	else {
+		uint32_t triangles = indexCount / 3;
+		uint32_t drawCount = std::max(1u, std::min(config.drawCount, triangles));
+		drawList.reserve(drawCount);
+		for (uint32_t i = 0; i < drawCount; i++) {
+			uint32_t first = (uint32_t)((uint64_t)triangles * i / drawCount);
+			uint32_t last = (uint32_t)((uint64_t)triangles * (i + 1) / drawCount);
+			// An empty draw has no bounds to take; dropping it keeps drawList and drawBounds in step.
+			if (last == first) continue;
+			drawList.push_back({ first * 3, (last - first) * 3, 0, instanceSlot });
+			float drawMin[3], drawMax[3];
+			for (uint32_t index = first * 3; index < last * 3; index++) {
+				const float* position = &generated.positions[(size_t)generated.indices[index] * 3];
+				for (int axis = 0; axis < 3; axis++) {
+					drawMin[axis] = index == first * 3 ? position[axis] : std::min(drawMin[axis], position[axis]);
+					drawMax[axis] = index == first * 3 ? position[axis] : std::max(drawMax[axis], position[axis]);
+				}
+			}
+			drawBounds.Push(SphereFromBox(drawMin, drawMax));
+		}
+	}
+	cull = config.cull;
+	simd = DetectSimdLevel();
+	clipBounds.Resize(drawBounds.Size());
+	cullScratch.resize(drawList.size());
+	visibleDraws.resize(drawList.size());
+	for (uint32_t i = 0; i < visibleDraws.size(); i++) visibleDraws[i] = i;
+	if (cull) Log("culling: %zu objects with %s kernels", drawList.size(), SimdLevelName(simd));
+	compute.Create(device, computeQueue, computeFamily, graphicsFamily, framesInFlight);
+	if (config.particleCount > 0 && particleFirstIndex == UINT32_MAX) {
+		Log("particles: not supported with mesh files");
+	}
+	else if (config.particleCount > 0) {
+		particles.Create(device, pipelineCache.Handle(), deletions, bindless, compute, config.particleCount, config.particleOverlap, quantization, 0.01f);
+		Log("particles: %u on the %s queue, %s", particles.Count(), compute.Async() ? "async compute" : "graphics",
+			particles.Overlapped() ? "overlapping the previous frame" : "serialized before each frame");
+	}
+	if (config.indirect) {
+		std::vector<DrawIndexedIndirectCommand> commands;
+		for (auto& item : drawList) {
+			auto* last = commands.empty() ? nullptr : &commands.back();
+			if (last != nullptr && last->firstIndex == item.firstIndex && last->indexCount == item.indexCount && last->firstInstance + last->instanceCount == item.firstInstance) {
+				last->instanceCount++;
+			}
+			else {
+				commands.emplace_back(item.indexCount, 1, item.firstIndex, 0, item.firstInstance);
+			}
+		}
+		bool usable = drawIndirectFirstInstance || std::all_of(commands.begin(), commands.end(), [](auto& command) { return command.firstInstance == 0; });
+		if (usable) {
+			indirectDrawCount = (uint32_t)commands.size();
+			indirectCountOffset = sizeof(DrawIndexedIndirectCommand) * commands.size();
+			BufferCreateInfo bufferInfo{};
+			bufferInfo.sType = StructureType::eBufferCreateInfo;
+			bufferInfo.size = indirectCountOffset + sizeof(uint32_t);
+			bufferInfo.usage = BufferUsageFlagBits::eIndirectBuffer | BufferUsageFlagBits::eTransferDst;
+			bufferInfo.sharingMode = SharingMode::eExclusive;
+			indirectBuffer = deletions.CreateBuffer(bufferInfo, MemoryPropertyFlagBits::eDeviceLocal);
+			uploader.UploadBuffer(indirectBuffer.Get(), 0, commands.data(), indirectCountOffset, PipelineStageFlagBits::eDrawIndirect, AccessFlagBits::eIndirectCommandRead);
+			uploader.UploadBuffer(indirectBuffer.Get(), indirectCountOffset, &indirectDrawCount, sizeof(uint32_t), PipelineStageFlagBits::eDrawIndirect, AccessFlagBits::eIndirectCommandRead);
+			Log("indirect: %u commands for %zu objects (%s)", indirectDrawCount, drawList.size(),
+				drawIndirectCount ? "count buffer" : multiDrawIndirect ? "multi-draw" : "one command per draw");
+		}
+		else {
+			Log("indirect: drawIndirectFirstInstance unsupported, drawing directly");
+		}
+	}
+	// Mesh chunks follow from the first frame on, so partially loaded meshes are drawn while the rest streams in.
+	uploader.Flush();
+	if (timestampPeriod > 0) {
+		QueryPoolCreateInfo queryInfo{};
+		queryInfo.sType = StructureType::eQueryPoolCreateInfo;
+		queryInfo.queryType = QueryType::eTimestamp;
+		queryInfo.queryCount = framesInFlight * 2;
+		assert(device.createQueryPool(&queryInfo, nullptr, &timestampPool) == Result::eSuccess);
+	}
+	timestampPending.resize(framesInFlight, false);
 #pragma endregion
 #pragma region CreateSyncObjects
+	phases.Next("CreateSyncObjects");
 	{
-		imageSemaphores.resize(MaxFrame);
-		renderSemaphores.resize(MaxFrame);
-		fences.resize(MaxFrame);
-		imageFences.resize(images.size(), VK_NULL_HANDLE);
+		pacer.Create(device);
+		frameValues.resize(framesInFlight, 0);
+		imageValues.resize(images.size(), 0);
+		imageSemaphores.resize(framesInFlight);
+		renderSemaphores.resize(framesInFlight);
 		SemaphoreCreateInfo semaphoreInfo{};
 		semaphoreInfo.sType = StructureType::eSemaphoreCreateInfo;
-		FenceCreateInfo fenceInfo{};
-		fenceInfo.sType = StructureType::eFenceCreateInfo;
-		fenceInfo.flags = FenceCreateFlagBits::eSignaled;
-		for (size_t i = 0; i < MaxFrame; i++) {
+		for (size_t i = 0; i < framesInFlight; i++) {
 			assert(device.createSemaphore(&semaphoreInfo, nullptr, &imageSemaphores[i]) == Result::eSuccess);
 			assert(device.createSemaphore(&semaphoreInfo, nullptr, &renderSemaphores[i]) == Result::eSuccess);
-			assert(device.createFence(&fenceInfo, nullptr, &fences[i]) == Result::eSuccess);
 		}
 	}
 #pragma endregion
+	phases.End();
+	if (Trace::Enabled() && timestampPool) CalibrateGpuClock();
 	}
 
-VertexInputBindingDescription Vertex::GetBindingDescription()
+AppConfig AppConfig::Parse(int argc, char** argv)
 {
-	VertexInputBindingDescription bindingDescription{};
-	bindingDescription.binding = 0;
-	bindingDescription.stride = sizeof(Vertex);
-	bindingDescription.inputRate = VertexInputRate::eVertex;
-	return bindingDescription;
+	AppConfig config;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--headless") config.headless = true;
+		else if (arg == "--width" && i + 1 < argc) config.width = (uint32_t)std::stoul(argv[++i]);
+		else if (arg == "--height" && i + 1 < argc) config.height = (uint32_t)std::stoul(argv[++i]);
+		else if (arg == "--frames" && i + 1 < argc) config.frameCount = (uint32_t)std::stoul(argv[++i]);
+		else if (arg == "--mesh" && i + 1 < argc) config.meshPath = argv[++i];
+		else if (arg == "--mesh-budget-mb" && i + 1 < argc) config.meshStreamBudget = std::stoull(argv[++i]) << 20;
+		else if (arg == "--draws" && i + 1 < argc) config.drawCount = (uint32_t)std::stoul(argv[++i]);
+		else if (arg == "--instances" && i + 1 < argc) config.instanceCount = (uint32_t)std::stoul(argv[++i]);
+		else if (arg == "--indirect") config.indirect = true;
+		else if (arg == "--record-threads" && i + 1 < argc) config.recordThreads = (uint32_t)std::stoul(argv[++i]);
+		else if (arg == "--frames-in-flight" && i + 1 < argc) config.framesInFlight = (uint32_t)std::stoul(argv[++i]);
+		else if (arg == "--pacing" && i + 1 < argc) {
+			if (!ParsePacingMode(argv[++i], config.pacing)) throw std::runtime_error("unknown pacing mode");
+		}
+		else if (arg == "--validation-severity" && i + 1 < argc) {
+			if (!ParseValidationSeverity(argv[++i], config.validationSeverity)) throw std::runtime_error("unknown validation severity");
+		}
+		else if (arg == "--loader-dispatch") config.deviceDispatch = false;
+		else if (arg == "--max-fps" && i + 1 < argc) config.maxFps = std::stod(argv[++i]);
+		else if (arg == "--trace" && i + 1 < argc) config.tracePath = argv[++i];
+		else if (arg == "--pipeline-cache" && i + 1 < argc) config.pipelineCachePath = argv[++i];
+		else if (arg == "--no-pipeline-cache") config.pipelineCachePath.clear();
+		else if (arg == "--pipeline-variants") config.pipelineVariants = true;
+		else if (arg == "--hot-reload") config.shaderHotReload = true;
+		else if (arg == "--no-hot-reload") config.shaderHotReload = false;
+		else if (arg == "--shader-dir" && i + 1 < argc) config.shaderDirectory = argv[++i];
+		else if (arg == "--no-dynamic-rendering") config.dynamicRendering = false;
+		else if (arg == "--dynamic-resolution") config.dynamicResolution = true;
+		else if (arg == "--target-ms" && i + 1 < argc) config.resolution.targetMs = std::stod(argv[++i]);
+		else if (arg == "--min-scale" && i + 1 < argc) config.resolution.minScale = std::stof(argv[++i]);
+		else if (arg == "--max-scale" && i + 1 < argc) config.resolution.maxScale = std::stof(argv[++i]);
+		else if (arg == "--scale-hysteresis" && i + 1 < argc) config.resolution.hysteresis = std::stof(argv[++i]);
+		else if (arg == "--no-cull") config.cull = false;
+		else if (arg == "--zoom" && i + 1 < argc) config.zoom = std::stof(argv[++i]);
+		else if (arg == "--adapter" && i + 1 < argc) config.adapter = argv[++i];
+		else if (arg == "--particles" && i + 1 < argc) config.particleCount = (uint32_t)std::stoul(argv[++i]);
+		else if (arg == "--serial-compute") config.particleOverlap = false;
+		else if (arg == "--capture" && i + 1 < argc) config.capture.directory = argv[++i];
+		else if (arg == "--capture-format" && i + 1 < argc) {
+			if (!ParseCaptureFormat(argv[++i], config.capture.format)) throw std::runtime_error("unknown capture format");
+		}
+		else if (arg == "--capture-ring" && i + 1 < argc) config.capture.ringSize = (uint32_t)std::stoul(argv[++i]);
+		else if (arg == "--capture-delay" && i + 1 < argc) config.capture.delay = (uint32_t)std::stoul(argv[++i]);
+		else if (arg == "--capture-interval" && i + 1 < argc) config.capture.interval = (uint32_t)std::stoul(argv[++i]);
+		else if (arg == "--dump" && i + 1 < argc) {
+			config.dumpPath = argv[++i];
+			config.readback = true;
+		}
+	}
+#ifndef _WIN32
+	config.headless = true;
+#endif
+	return config;
 }
 
-std::array<VertexInputAttributeDescription, 2> Vertex::GetAttributeDescriptions()
+MeshSource VulkanApp::GenerateTriangles(uint32_t count)
 {
-	std::array<VertexInputAttributeDescription, 2> attributeDescriptions{};
-	attributeDescriptions[0].binding = 0;
-	attributeDescriptions[0].location = 0;
-	attributeDescriptions[0].format = Format::eR32G32B32A32Sfloat;
-	attributeDescriptions[0].offset = offsetof(Vertex, pos);
-	attributeDescriptions[1].binding = 0;
-	attributeDescriptions[1].location = 1;
-	attributeDescriptions[1].format = Format::eR32G32B32A32Sfloat;
-	attributeDescriptions[1].offset = offsetof(Vertex, color);
-	return attributeDescriptions;
+	MeshSource result;
+	if (count <= 1) {
+		result.positions = { 0.0f, -0.5f, 0, 0.5f, 0.5f, 0, -0.5f, 0.5f, 0 };
+		result.colors = { 1.0f, 0.0f, 0.0f, 1, 0.0f, 1.0f, 0.0f, 1, 0.0f, 0.0f, 1.0f, 1 };
+		result.indices = { 0, 1, 2 };
+		return result;
+	}
+	result.positions.reserve((size_t)count * 9);
+	result.colors.reserve((size_t)count * 12);
+	uint32_t side = 1;
+	while ((uint64_t)side * side < count) side++;
+	float cell = 2.0f / side;
+	for (uint32_t i = 0; i < count; i++) {
+		float x = -1.0f + (i % side) * cell;
+		float y = -1.0f + (i / side) * cell;
+		float shade = (float)i / count;
+		result.positions.insert(result.positions.end(), { x + cell * 0.5f, y + cell * 0.1f, 0, x + cell * 0.9f, y + cell * 0.9f, 0, x + cell * 0.1f, y + cell * 0.9f, 0 });
+		result.colors.insert(result.colors.end(), { 1.0f, shade, 0.0f, 1, 0.0f, 1.0f, shade, 1, shade, 0.0f, 1.0f, 1 });
+	}
+	// The triangles never share vertices, so the index buffer is the identity sequence.
+	result.indices.resize((size_t)count * 3);
+	for (uint32_t i = 0; i < result.indices.size(); i++) result.indices[i] = i;
+	return result;
 }
 
-std::vector<char> VulkanApp::ReadFile(const std::string& filename)
+std::vector<InstanceData> VulkanApp::GenerateInstances(uint32_t count, float meshRadius)
 {
-	std::ifstream file(filename, std::ios::ate | std::ios::binary);
-	if (!file.is_open()) throw std::exception("failed to open file!");
-	size_t fileSize = (size_t)file.tellg();
-	std::vector<char> buffer(fileSize);
-	file.seekg(0);
-	file.read(buffer.data(), fileSize);
-	file.close();
-	return buffer;
+	std::vector<InstanceData> result;
+	result.reserve(count);
+	uint32_t side = 1;
+	while ((uint64_t)side * side < count) side++;
+	float cell = 2.0f / side;
+	float scale = meshRadius > 0 ? cell * 0.45f / meshRadius : cell;
+	for (uint32_t i = 0; i < count; i++) {
+		float u = (float)(i % side) / side;
+		float v = (float)(i / side) / side;
+		result.push_back({ { -1.0f + (u + 0.5f / side) * 2.0f, -1.0f + (v + 0.5f / side) * 2.0f, scale, 0 }, { 0.5f + u * 0.5f, 0.5f + v * 0.5f, 1.0f - u * 0.5f, 1 } });
+	}
+	return result;
 }
 
-LRESULT VulkanApp::WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
+void VulkanApp::StreamMesh()
 {
-	switch (msg)
-	{
-	case WM_ERASEBKGND:
-		return 1;
-	case WM_PAINT:
-		DrawFrame();
-		return 0;
-	default:
-		return DefWindowProc(hwnd, msg, wParam, lParam);
+	if (!mesh.IsOpen()) return;
+	TraceScope trace("streamMesh");
+	uploader.Poll();
+	auto& header = mesh.Header();
+	DeviceSize streamed = 0;
+	// Always make progress, even when a single chunk exceeds the budget.
+	while (meshChunksLoaded < header.chunkCount && (streamed == 0 || streamed < config.meshStreamBudget)) {
+		auto& chunk = mesh.Chunk(meshChunksLoaded);
+		if (!mesh.ValidateChunk(meshChunksLoaded)) throw std::runtime_error("mesh chunk references vertices of later chunks");
+		if (meshChunksLoaded + 1 < header.chunkCount) mesh.Prefetch(meshChunksLoaded + 1);
+		DeviceSize vertexBytes = (DeviceSize)chunk.vertexCount * header.vertexStride;
+		DeviceSize indexBytes = (DeviceSize)chunk.indexCount * sizeof(uint32_t);
+		uploader.UploadBuffer(vertexBuffer.Get(), (DeviceSize)chunk.firstVertex * header.vertexStride, mesh.Vertices() + (size_t)chunk.firstVertex * header.vertexStride, vertexBytes,
+			PipelineStageFlagBits::eVertexInput, AccessFlagBits::eVertexAttributeRead);
+		uploader.UploadBuffer(indexBuffer.Get(), (DeviceSize)chunk.firstIndex * sizeof(uint32_t), mesh.Indices() + chunk.firstIndex, indexBytes,
+			PipelineStageFlagBits::eVertexInput, AccessFlagBits::eIndexRead);
+		streamed += vertexBytes + indexBytes;
+		meshChunksLoaded++;
+		residentIndexCount = chunk.firstIndex + chunk.indexCount;
+	}
+	uploader.Flush();
+	auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - meshOpenTime).count();
+	if (meshLoad.firstChunk == 0) meshLoad.firstChunk = elapsed;
+	if (meshChunksLoaded == header.chunkCount) {
+		meshLoad.resident = elapsed;
+		Log("mesh: %u triangles resident after %.1fms and %u frames (%.1f MB/s)", indexCount / 3, elapsed, meshLoad.residentFrames, meshLoad.bytes / 1048576.0 / (elapsed / 1000));
+		// Every chunk has been copied to staging, so the mapping is no longer needed.
+		mesh.Close();
+	}
+	else {
+		meshLoad.residentFrames++;
 	}
 }
 
-int VulkanApp::Run()
+bool VulkanApp::HandleEvents()
 {
-	ShowWindow(hwnd, SW_SHOW);
-	MSG msg;
-	while (GetMessage(&msg, hwnd, 0, 0) > 0)
-	{
-		TranslateMessage(&msg);
-		DispatchMessage(&msg);
+	WindowEvent event;
+	while (events.Pop(event)) {
+		switch (event.type)
+		{
+		case WindowEventType::Close:
+			return false;
+		case WindowEventType::Resize:
+			minimized = event.x == 0 || event.y == 0;
+			windowExtent = Extent2D((uint32_t)event.x, (uint32_t)event.y);
+			if (!minimized && swapchain && windowExtent != swapchainExtent) swapchainDirty = true;
+			break;
+		case WindowEventType::KeyDown:
+			if (event.key == 'B') pipelineKey.blend = (BlendMode)(((uint32_t)pipelineKey.blend + 1) % 3);
+			else if (event.key == 'C') {
+				pipelineKey.cullMode = pipelineKey.cullMode == CullModeFlagBits::eBack ? CullModeFlagBits::eNone
+					: pipelineKey.cullMode == CullModeFlagBits::eNone ? CullModeFlagBits::eFront : CullModeFlagBits::eBack;
+			}
+			else if (event.key == 'V') pipelineKey.constants[0] = (pipelineKey.constants[0] + 1) % 3;
+			else break;
+			Log("pipeline: %s", pipelineKey.Name().c_str());
+			break;
+		default:
+			break;
+		}
 	}
-	return (int)msg.wParam;
+	return true;
+}
+
+bool VulkanApp::PumpEvents()
+{
+	window->Show();
+	return window->PollEvents(events) && HandleEvents();
+}
+
+int VulkanApp::Run()
+{
+	std::atomic<bool> running{ true };
+	std::exception_ptr failure;
+	// Bumped by the window thread whenever it queued events, so a minimized render thread can sleep until one arrives.
+	std::mutex eventMutex;
+	std::condition_variable eventArrived;
+	uint64_t eventGeneration = 0;
+	auto signalEvents = [&] {
+		{
+			std::lock_guard<std::mutex> lock(eventMutex);
+			eventGeneration++;
+		}
+		eventArrived.notify_one();
+	};
+	// The window thread only turns messages into events, so dragging or a slow message never stalls a frame,
+	// and frames are no longer tied to WM_PAINT.
+	std::thread renderThread([&] {
+		Trace::SetThreadName("render");
+		try {
+			FrameLimiter limiter(config.maxFps);
+			for (uint32_t frame = 0; running.load(std::memory_order_relaxed); limiter.Wait()) {
+				uint64_t seen;
+				{
+					std::lock_guard<std::mutex> lock(eventMutex);
+					seen = eventGeneration;
+				}
+				if (!HandleEvents()) break;
+				if (config.headless && frame++ == config.frameCount) break;
+				if (!minimized) {
+					DrawFrame();
+					continue;
+				}
+				// Nothing is drawn until a restore arrives as an event, so block instead of spinning on an empty queue.
+				std::unique_lock<std::mutex> lock(eventMutex);
+				eventArrived.wait(lock, [&] { return eventGeneration != seen || !running.load(std::memory_order_relaxed); });
+			}
+			device.waitIdle();
+		}
+		catch (...) {
+			failure = std::current_exception();
+		}
+		running = false;
+		window->Wake();
+	});
+	window->Show();
+	while (running && window->WaitEvents(events)) signalEvents();
+	running = false;
+	signalEvents();
+	renderThread.join();
+	if (failure) std::rethrow_exception(failure);
+	if (config.headless && !config.dumpPath.empty() && !DumpFrame(config.dumpPath)) return 1;
+	return 0;
 }
 
 VulkanApp::~VulkanApp()
 {
-	for (size_t i = 0; i < 2; i++) {
+	// Run() idles the device when its loop ends, but callers driving DrawFrame() themselves may leave frames in flight.
+	device.waitIdle();
+	if (!config.tracePath.empty() && !Trace::Write(config.tracePath)) Log("failed to write trace to %s", config.tracePath.c_str());
+	if (dynamicResolution) {
+		auto& stats = resolution.Stats();
+		Log("dynamic resolution: final scale %.2f at %.2fms, %llu raises, %llu lowers, %llu holds", stats.scale, stats.gpuMs,
+			(unsigned long long)stats.raises, (unsigned long long)stats.lowers, (unsigned long long)stats.holds);
+	}
+	for (size_t i = 0; i < framesInFlight; i++) {
 		device.destroySemaphore(renderSemaphores[i], nullptr);
 		device.destroySemaphore(imageSemaphores[i], nullptr);
-		device.destroyFence(fences[i], nullptr);
 	}
-	for (auto buff : framebuffers) device.destroyFramebuffer(buff, nullptr);
-	for (auto view : views) device.destroyImageView(view, nullptr);
-	device.freeCommandBuffers(commandPool, static_cast<uint32_t>(commandBuffers.size()), commandBuffers.data());
-	device.destroyPipeline(graphicsPipeline, nullptr);
+	// The device is idle, so every frame still waiting in the ring has completed and is written out first.
+	capture.Destroy(pacer.NextValue() - 1);
+	pacer.Destroy();
+	particles.Destroy();
+	compute.Destroy();
+	// Workers may still be compiling against the graph's render pass.
+	shaderWatcher.reset();
+	pipelines.Destroy();
+	graph.Destroy();
+	for (auto view : views) deletions.Retire(view);
+	offscreenImages.clear();
+	if (timestampPool) device.destroyQueryPool(timestampPool, nullptr);
+	// Members outlive this body, so owned objects are handed to the queue here, while the device still exists.
+	readbackBuffer.Reset();
+	indirectBuffer.Reset();
+	instanceBuffer.Reset();
+	indexBuffer.Reset();
+	vertexBuffer.Reset();
+	uniforms.Destroy();
+	bindless.Destroy();
+	pipelineCache.Save();
+	pipelineCache.Destroy();
 	device.destroyPipelineLayout(pipelineLayout, nullptr);
-	device.destroyRenderPass(renderPass, nullptr);
-	device.destroyCommandPool(commandPool, nullptr);
-	device.destroySwapchainKHR(swapchain, nullptr);
+	for (auto& frame : frameResources) {
+		for (auto pool : frame.slicePools) device.destroyCommandPool(pool, nullptr);
+		device.destroyCommandPool(frame.pool, nullptr);
+	}
+	uploader.Destroy();
+	if (swapchain) deletions.Retire(swapchain);
+	deletions.Destroy();
+	allocator.LogStats();
+	allocator.Destroy();
 	device.destroy(nullptr);
-	instance.destroySurfaceKHR(surface, nullptr);
+	if (surface) instance.destroySurfaceKHR(surface, nullptr);
 #ifdef _DEBUG
 	instance.destroyDebugUtilsMessengerEXT(debugger, nullptr);
+	validationLog.reset();
 #endif
 	instance.destroy();
 }
@@ -1,64 +1,325 @@
 #pragma once
-#define VK_USE_PLATFORM_WIN32_KHR
-#include <string>
+#include "Dispatch.h"
+#ifdef _WIN32
 #include <Windows.h>
-#include <vulkan/vulkan.hpp>
+#endif
+#include <string>
 #include <vector>
 #include <array>
-#include <DirectXMath.h>
+#include "Profiler.h"
+#include "PipelineCache.h"
+#include "PipelineLibrary.h"
+#include "Shaders.h"
+#include "MemoryAllocator.h"
+#include "Uploader.h"
+#include "ThreadPool.h"
+#include "FramePacer.h"
+#include "ValidationLog.h"
+#include "Window.h"
+#include "MeshFile.h"
+#include "Descriptors.h"
+#include "RenderGraph.h"
+#include "DynamicResolution.h"
+#include "SimdMath.h"
+#include "DeletionQueue.h"
+#include "ComputeQueue.h"
+#include "Particles.h"
+#include "FrameCapture.h"
+#include <chrono>
+#include <memory>
+
+// Per-object data read by the vertex shader from a storage buffer, indexed by the instance index.
+struct InstanceData {
+	// xy: translation, z: uniform scale, w: depth translation.
+	Float4 offsetScale;
+	Float4 color;
+};
 
-struct Vertex {
-	DirectX::XMFLOAT3 pos;
-	DirectX::XMFLOAT4 color;
-	static vk::VertexInputBindingDescription GetBindingDescription();
-	static std::array<vk::VertexInputAttributeDescription, 2> GetAttributeDescriptions();
+// Per-frame constants, written into the uniform ring once per frame and read through set 1.
+struct FrameConstants {
+	// xy: pan, z: zoom, applied after the instance transform.
+	Float4 view;
+	// Seconds since startup.
+	float time;
+	float padding[3];
+};
+
+// Per-draw push constants.
+struct DrawConstants {
+	// Bindless slot of the buffer the draw's instances are read from.
+	uint32_t instanceBuffer;
+};
+
+struct AppConfig {
+	// Render into device-owned images instead of a window surface and swapchain.
+	bool headless = false;
+	// Copy every headless frame into a host-visible buffer so it can be read back.
+	bool readback = false;
+	uint32_t width = 1280;
+	uint32_t height = 720;
+	// Number of frames Run() renders in headless mode.
+	uint32_t frameCount = 1;
+	// When non-empty, Run() writes the last headless frame to this path as PPM.
+	std::string dumpPath;
+	// 1 draws the original triangle, anything larger draws a generated grid of that many triangles.
+	uint32_t triangleCount = 1;
+	// Mesh file drawn instead of the generated triangles; it is streamed in over as many frames as it takes.
+	std::string meshPath;
+	// Bytes of mesh data uploaded per frame while streaming.
+	uint64_t meshStreamBudget = 8ull << 20;
+	// The triangles are split into this many draw calls.
+	uint32_t drawCount = 1;
+	// Objects drawn as instances of the mesh, laid out on a grid; 0 draws the mesh once.
+	uint32_t instanceCount = 0;
+	// Submit the scene with indexed indirect draws read from a device buffer instead of one draw call per object.
+	bool indirect = false;
+	// Threads recording secondary command buffers, including the render thread; 0 uses every hardware thread.
+	uint32_t recordThreads = 0;
+	// Present mode preference and default queue depth.
+	PacingMode pacing = PacingMode::LowLatency;
+	// Frames the CPU may record ahead of the GPU; 0 uses the pacing mode's default.
+	uint32_t framesInFlight = 0;
+	// When non-empty, CPU scopes and GPU ranges are recorded and written to this path as Chrome trace JSON at shutdown.
+	std::string tracePath;
+	// Least severe debug messenger message forwarded to the log in debug builds.
+	ValidationSeverity validationSeverity = ValidationSeverity::Warning;
+	// Call device commands through entry points fetched for the device; false keeps the loader's trampolines.
+	bool deviceDispatch = true;
+	// Upper bound on the render loop's frame rate; 0 renders as fast as pacing allows.
+	double maxFps = 0;
+	// Pipeline cache file loaded at startup and written back at shutdown; empty disables it.
+	std::string pipelineCachePath = "pipeline.cache";
+	// Compile every blend, cull and color source variant in the background at startup.
+	bool pipelineVariants = false;
+	// Watch the shader sources and swap recompiled shaders in while running; windowed builds only.
+#ifdef _DEBUG
+	bool shaderHotReload = true;
+#else
+	bool shaderHotReload = false;
+#endif
+	// Where the watched shader sources live; empty uses the directory they were built from.
+	std::string shaderDirectory;
+	// Begin passes with VK_KHR_dynamic_rendering where the device has it; false keeps render pass objects.
+	bool dynamicRendering = true;
+	// Render the scene offscreen at a scale adjusted every frame to hold resolution.targetMs of GPU time, and
+	// upscale it into the presented image.
+	bool dynamicResolution = false;
+	ResolutionSettings resolution;
+	// Skip draws whose bounding sphere is outside the view, tested on the CPU every frame.
+	bool cull = true;
+	// Magnification of the view around the origin; above 1 pushes objects off screen for culling to drop.
+	float zoom = 1.0f;
+	// Adapter to run on, by index or part of its name; empty picks the best scored one. An unsuitable adapter is
+	// passed over.
+	std::string adapter;
+	// Particles simulated on the compute queue and drawn over the scene; 0 disables them. Generated scenes only.
+	uint32_t particleCount = 0;
+	// Draw the previous frame's simulation so it overlaps graphics work, instead of waiting for this frame's.
+	bool particleOverlap = true;
+	// Stream presented frames, windowed or headless, to capture.directory from a background thread.
+	CaptureSettings capture;
+
+	static AppConfig Parse(int argc, char** argv);
 };
 
 class VulkanApp
 {
+	struct DrawItem {
+		uint32_t firstIndex;
+		uint32_t indexCount;
+		uint32_t firstInstance;
+		uint32_t instanceBuffer;
+	};
+	struct FrameResources {
+		vk::CommandPool pool;
+		vk::CommandBuffer primary;
+		// One pool and secondary per recording slice so no pool is ever touched by two threads.
+		std::vector<vk::CommandPool> slicePools;
+		std::vector<vk::CommandBuffer> secondaries;
+	};
 #ifdef _DEBUG
 	vk::DebugUtilsMessengerEXT debugger;
+	std::unique_ptr<ValidationLog> validationLog;
 #endif
 private:
-	constexpr static uint32_t MaxFrame = 2;
-	const HWND hwnd;
+	const AppConfig config;
+	const uint32_t framesInFlight;
+	std::unique_ptr<Window> window;
+	// Written by the thread pumping the window, read by the thread rendering.
+	WindowEventQueue events;
+	// The window has no area to present to; frames are skipped until it is restored.
+	bool minimized = false;
+	// Client size from the last resize, for surfaces that leave the swapchain extent to the application.
+	vk::Extent2D windowExtent;
+	// The swapchain no longer matches the window; it is recreated before the next frame.
+	bool swapchainDirty = false;
 	vk::Instance instance;
 	vk::PhysicalDevice physicalDevice;
 	vk::Device device;
 	vk::Queue queue;
+	// Falls back to queue when the adapter has no compute family without graphics.
+	vk::Queue computeQueue;
+	vk::Queue transferQueue;
+	uint32_t graphicsFamily = 0;
+	uint32_t computeFamily = 0;
+	uint32_t transferFamily = 0;
+	MemoryAllocator allocator;
+	// Everything replaced while frames may still use it is destroyed through here: swapchains and their views,
+	// the graph's transients and framebuffers, pipelines and owned buffers and images.
+	DeletionQueue deletions;
+	Uploader uploader;
 	vk::SurfaceKHR surface;
 	vk::SwapchainKHR swapchain;
-	vk::RenderPass renderPass;
+	vk::Extent2D swapchainExtent;
+	vk::PresentModeKHR presentMode = vk::PresentModeKHR::eFifo;
+	double swapchainRecreateTime = 0;
+	// The frame: the scene pass drawing into the presented image, then the readback and capture copies when enabled.
+	RenderGraph graph;
+	RenderGraph::Resource colorTarget = 0;
+	RenderGraph::Resource readbackTarget = 0;
+	RenderGraph::Resource captureTarget = 0;
+	// Offscreen color the scene is drawn into under dynamic resolution, sized for the largest scale.
+	RenderGraph::Resource sceneTarget = 0;
+	RenderGraph::Pass scenePass = 0;
+	// Secondaries recorded for the current frame, executed by the scene pass.
+	uint32_t recordedSlices = 0;
 	vk::PipelineLayout pipelineLayout;
-	vk::Pipeline graphicsPipeline;
-	vk::CommandPool commandPool;
-	vk::Buffer vertexBuffer;
-	vk::DeviceMemory vertexBufferMemory;
+	PipelineLibrary pipelines;
+	// The variant the scene is drawn with; B, C and V cycle its blend mode, cull mode and color source.
+	PipelineKey pipelineKey;
+	PipelineCache pipelineCache;
+	// Recompiles edited shaders in the background when hot reload is on.
+	std::unique_ptr<ShaderWatcher> shaderWatcher;
+	double pipelineCreateTime = 0;
+	vk::QueryPool timestampPool;
+	float timestampPeriod = 0;
+	// Added to timestamp nanoseconds to place GPU ranges on the trace clock.
+	int64_t gpuTraceOffset = 0;
+	// VK_EXT_debug_utils is enabled, so command buffers carry labels named like the trace scopes.
+	bool debugLabels = false;
+	bool multiDrawIndirect = false;
+	bool drawIndirectFirstInstance = false;
+	bool drawIndirectCount = false;
+	bool dynamicRendering = false;
+	bool dynamicResolution = false;
+	ResolutionController resolution;
+	// Size the scene is drawn at this frame; the swapchain extent unless dynamic resolution scales it.
+	vk::Extent2D renderExtent;
+	Owned<vk::Buffer> vertexBuffer;
+	Owned<vk::Buffer> indexBuffer;
+	uint32_t indexCount = 0;
+	// Layout of the vertex buffer, and how its positions map back to model space.
+	MeshVertexFormat vertexFormat = MeshVertexFormat::PositionColorPacked;
+	PositionQuantization quantization;
+	float boundsMin[3] = {};
+	float boundsMax[3] = {};
+	// Length of the index buffer prefix that has been uploaded; draws are clipped to it.
+	uint32_t residentIndexCount = 0;
+	// Mapped while chunks remain to be streamed, then closed.
+	MeshFile mesh;
+	uint32_t meshChunksLoaded = 0;
+	std::chrono::steady_clock::time_point meshOpenTime;
+	MeshLoadStats meshLoad;
+	Owned<vk::Buffer> instanceBuffer;
+	// DrawIndexedIndirectCommands followed by their count at indirectCountOffset.
+	Owned<vk::Buffer> indirectBuffer;
+	vk::DeviceSize indirectCountOffset = 0;
+	uint32_t indirectDrawCount = 0;
+	uint32_t instanceSlot = 0;
+	// Set 0: every buffer and texture the shaders index; set 1: the per-frame uniform ring.
+	BindlessTable bindless;
+	UniformRing uniforms;
+	// Dynamic offset of this frame's FrameConstants.
+	uint32_t frameConstantsOffset = 0;
+	std::chrono::steady_clock::time_point startTime;
+	Owned<vk::Buffer> readbackBuffer;
+	uint8_t* readbackData = nullptr;
+	// Capture was requested and the presented images can be copied from.
+	bool capturing = false;
+	FrameCapture capture;
 	std::vector<vk::Image> images;
+	// Backs images in headless mode.
+	std::vector<Owned<vk::Image>> offscreenImages;
 	std::vector<vk::ImageView> views;
-	std::vector<vk::Framebuffer> framebuffers;
-	std::vector<vk::CommandBuffer> commandBuffers;
+	std::vector<FrameResources> frameResources;
+	// Compute work and its reference workload, stepped once per frame when particles are enabled.
+	ComputeQueue compute;
+	ParticleSystem particles;
+	// First index of the triangle every particle is drawn as; UINT32_MAX when the index buffer has none.
+	uint32_t particleFirstIndex = UINT32_MAX;
+	std::unique_ptr<ThreadPool> workers;
+	std::vector<DrawItem> drawList;
+	// World bounds of each draw item, the same bounds in clip space this frame, and the draw items that survived
+	// culling in order; without culling visibleDraws lists every item.
+	SphereSoA drawBounds;
+	SphereSoA clipBounds;
+	std::vector<uint32_t> visibleDraws;
+	std::vector<uint32_t> cullScratch;
+	std::vector<size_t> cullJobCounts;
+	bool cull = false;
+	SimdLevel simd = SimdLevel::Scalar;
 	std::vector<vk::Semaphore> imageSemaphores;
 	std::vector<vk::Semaphore> renderSemaphores;
-	std::vector<vk::Fence> fences;
-	std::vector<vk::Fence> imageFences;
+	FramePacer pacer;
+	// Timeline value each frame slot and each image was last submitted with; 0 when never used.
+	std::vector<uint64_t> frameValues;
+	std::vector<uint64_t> imageValues;
 	uint32_t currentFrame;
+	uint32_t lastImage = UINT32_MAX;
+	std::vector<bool> timestampPending;
+	FrameTiming timing;
+	static std::vector<InstanceData> GenerateInstances(uint32_t count, float meshRadius);
+	// Creates the swapchain for the surface's current size, retiring the previous one; false when it has no area.
+	bool CreateSwapchain();
+	void CreateViews();
+	// Rebuilds the swapchain images and everything sized by them, but no pipelines; false while minimized.
+	bool RecreateSwapchain();
+	// Fills visibleDraws with the draw items view maps into the clip volume, spread across the workers.
+	void CullDraws(const Affine3& view);
+	void RecordFrame(uint32_t imageIndex);
+	void BeginLabel(vk::CommandBuffer commandBuffer, const char* name);
+	void EndLabel(vk::CommandBuffer commandBuffer);
+	void CalibrateGpuClock();
+	// Applies queued window events on the rendering thread; false once the window asked to close.
+	bool HandleEvents();
+	// Uploads the next mesh chunks within the per-frame budget straight from the mapping.
+	void StreamMesh();
+	// The static indirect commands cover the whole mesh, so they are only used once it is resident.
+	bool DrawIndirect() const { return indirectDrawCount > 0 && residentIndexCount == indexCount; }
 public:
-	static const wchar_t* WndClsName;
-	const std::vector<Vertex> vertices = {
-	{{0.0f, -0.5f, 0}, {1.0f, 0.0f, 0.0f, 1}},
-	{{0.5f, 0.5f, 0}, {0.0f, 1.0f, 0.0f, 1}},
-	{{-0.5f, 0.5f, 0}, {0.0f, 0.0f, 1.0f, 1}}
-	};
-private:
-	static std::vector<char> ReadFile(const std::string& filename);
-	virtual LRESULT WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam);
-	vk::ShaderModule CreateShaderModule(const std::vector<char>& code);
-	uint32_t FindMemoryType(uint32_t typeFilter, vk::MemoryPropertyFlags properties);
+	// A grid of count unconnected triangles covering clip space; 1 is the original RGB triangle.
+	static MeshSource GenerateTriangles(uint32_t count);
 	void DrawFrame();
-public:
-	static LRESULT WndProcAlloter(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam);
+	const FrameTiming& LastFrameTiming() const { return timing; }
+	const AppConfig& Config() const { return config; }
+	// Milliseconds spent in createGraphicsPipelines, and whether a cache from disk was used.
+	double PipelineCreateTime() const { return pipelineCreateTime; }
+	bool PipelineCacheWarm() const { return pipelineCache.IsWarm(); }
+	// Milliseconds the last swapchain recreation took.
+	double SwapchainRecreateTime() const { return swapchainRecreateTime; }
+	bool DynamicResolution() const { return dynamicResolution; }
+	// The render scale and how the controller arrived at it.
+	const ResolutionStats& Resolution() const { return resolution.Stats(); }
+	MemoryStats MemoryUsage() const { return allocator.Stats(); }
+	const MeshLoadStats& MeshLoad() const { return meshLoad; }
+	// Objects drawn each frame, and the draw commands the CPU records to draw them.
+	size_t ObjectCount() const { return drawList.size(); }
+	size_t DrawCallsPerFrame() const { return DrawIndirect() ? (drawIndirectCount || multiDrawIndirect ? 1 : indirectDrawCount) : visibleDraws.size(); }
+	// Objects left after culling in the last frame.
+	size_t VisibleCount() const { return DrawIndirect() ? drawList.size() : visibleDraws.size(); }
+	size_t ParticleCount() const { return particles.Count(); }
+	// The simulation runs on a queue family without graphics, beside the graphics queue.
+	bool AsyncCompute() const { return compute.Async(); }
+	// Frames captured and dropped so far; the writer's counts trail until the app is destroyed.
+	CaptureStats CaptureStatistics() const { return capture.Stats(); }
+	// Shows the window and handles pending events without blocking, for callers that render on the window's thread;
+	// returns false once the window is closed.
+	bool PumpEvents();
+	// Reads back the most recently rendered headless frame as tightly packed RGBA8 rows.
+	bool ReadbackFrame(std::vector<uint8_t>& pixels);
+	bool DumpFrame(const std::string& path);
+	// Renders on a dedicated thread while the calling thread, which must own the window, waits on OS messages.
 	int Run();
-	VulkanApp();
+	VulkanApp(const AppConfig& config = {});
 	virtual ~VulkanApp();
 };
@@ -0,0 +1,187 @@
+#include "Window.h"
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+#ifdef _DEBUG
+#include <cassert>
+#else
+#define assert(X) (void)(X)
+#endif
+
+#include <condition_variable>
+#include <mutex>
+#include <stdexcept>
+
+using namespace vk;
+
+namespace {
+	class HeadlessWindow : public Window
+	{
+		std::mutex mutex;
+		std::condition_variable wake;
+		bool woken = false;
+	public:
+		std::vector<const char*> InstanceExtensions() const override { return {}; }
+		bool PresentationSupport(PhysicalDevice, uint32_t) const override { return true; }
+		SurfaceKHR CreateSurface(Instance) override { return nullptr; }
+		void Show() override {}
+		bool PollEvents(WindowEventQueue&) override { return true; }
+		bool WaitEvents(WindowEventQueue&) override
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [&] { return woken; });
+			woken = false;
+			return true;
+		}
+		void Wake() override
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				woken = true;
+			}
+			wake.notify_one();
+		}
+	};
+
+#ifdef _WIN32
+	class Win32Window : public Window
+	{
+		static constexpr const wchar_t* ClassName = L"VulkanWindow";
+		HWND hwnd = nullptr;
+		// Set while this thread dispatches messages; WndProc runs inside DispatchMessage and pushes here.
+		WindowEventQueue* sink = nullptr;
+		bool closed = false;
+
+		static LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
+		{
+			if (msg == WM_NCCREATE) {
+				auto create = (CREATESTRUCT*)lParam;
+				SetWindowLongPtr(hwnd, GWLP_USERDATA, (LONG_PTR)create->lpCreateParams);
+			}
+			auto window = (Win32Window*)GetWindowLongPtr(hwnd, GWLP_USERDATA);
+			return window == nullptr ? DefWindowProc(hwnd, msg, wParam, lParam) : window->HandleMessage(hwnd, msg, wParam, lParam);
+		}
+
+		void Emit(const WindowEvent& event)
+		{
+			if (sink == nullptr) return;
+			// Input may be dropped under a full queue, but the render thread must always hear about a close.
+			while (!sink->Push(event) && event.type == WindowEventType::Close) Sleep(0);
+		}
+
+		LRESULT HandleMessage(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
+		{
+			switch (msg)
+			{
+			case WM_ERASEBKGND:
+				return 1;
+			case WM_PAINT:
+				// The render thread presents continuously; painting here would only block the message loop.
+				ValidateRect(hwnd, nullptr);
+				return 0;
+			case WM_SIZE:
+				Emit({ WindowEventType::Resize, LOWORD(lParam), HIWORD(lParam) });
+				return 0;
+			case WM_KEYDOWN:
+				Emit({ WindowEventType::KeyDown, 0, 0, (uint32_t)wParam });
+				return 0;
+			case WM_KEYUP:
+				Emit({ WindowEventType::KeyUp, 0, 0, (uint32_t)wParam });
+				return 0;
+			case WM_MOUSEMOVE:
+				Emit({ WindowEventType::MouseMove, (int16_t)LOWORD(lParam), (int16_t)HIWORD(lParam) });
+				return 0;
+			case WM_CLOSE:
+				// The window outlives the close request so the render thread never presents to a destroyed surface;
+				// it is destroyed with this object, after the swapchain.
+				closed = true;
+				Emit({ WindowEventType::Close });
+				return 0;
+			default:
+				return DefWindowProc(hwnd, msg, wParam, lParam);
+			}
+		}
+
+		bool Dispatch(WindowEventQueue& events, bool wait)
+		{
+			sink = &events;
+			MSG msg;
+			if (wait && !closed && GetMessage(&msg, hwnd, 0, 0) > 0) {
+				TranslateMessage(&msg);
+				DispatchMessage(&msg);
+			}
+			while (!closed && PeekMessage(&msg, hwnd, 0, 0, PM_REMOVE)) {
+				TranslateMessage(&msg);
+				DispatchMessage(&msg);
+			}
+			sink = nullptr;
+			return !closed;
+		}
+	public:
+		Win32Window(uint32_t width, uint32_t height)
+		{
+			static bool registered = false;
+			if (!registered) {
+				WNDCLASS cls{};
+				cls.hInstance = GetModuleHandle(nullptr);
+				cls.lpszClassName = ClassName;
+				cls.lpfnWndProc = WndProc;
+				cls.hCursor = LoadCursor(nullptr, IDC_ARROW);
+				RegisterClass(&cls);
+				registered = true;
+			}
+			hwnd = CreateWindowEx(0, ClassName, L"vulkan", WS_OVERLAPPEDWINDOW, 200, 200, width, height, nullptr, nullptr, nullptr, this);
+			if (hwnd == nullptr) throw std::runtime_error("failed to create window");
+		}
+		~Win32Window() override
+		{
+			if (hwnd) DestroyWindow(hwnd);
+		}
+		std::vector<const char*> InstanceExtensions() const override
+		{
+			return { VK_KHR_SURFACE_EXTENSION_NAME, VK_KHR_WIN32_SURFACE_EXTENSION_NAME };
+		}
+		bool PresentationSupport(PhysicalDevice physicalDevice, uint32_t queueFamily) const override
+		{
+			return physicalDevice.getWin32PresentationSupportKHR(queueFamily);
+		}
+		SurfaceKHR CreateSurface(Instance instance) override
+		{
+			Win32SurfaceCreateInfoKHR surfaceCreateInfo{};
+			surfaceCreateInfo.sType = StructureType::eWin32SurfaceCreateInfoKHR;
+			surfaceCreateInfo.pNext = nullptr;
+			surfaceCreateInfo.hinstance = GetModuleHandle(nullptr);
+			surfaceCreateInfo.hwnd = hwnd;
+			SurfaceKHR surface;
+			assert(instance.createWin32SurfaceKHR(&surfaceCreateInfo, nullptr, &surface) == Result::eSuccess);
+			return surface;
+		}
+		void Show() override
+		{
+			if (hwnd && !IsWindowVisible(hwnd)) ShowWindow(hwnd, SW_SHOW);
+		}
+		bool PollEvents(WindowEventQueue& events) override { return Dispatch(events, false); }
+		bool WaitEvents(WindowEventQueue& events) override { return Dispatch(events, true); }
+		void Wake() override
+		{
+			if (auto target = hwnd) PostMessage(target, WM_NULL, 0, 0);
+		}
+	};
+#endif
+}
+
+std::unique_ptr<Window> CreateHeadlessWindow()
+{
+	return std::make_unique<HeadlessWindow>();
+}
+
+std::unique_ptr<Window> CreateNativeWindow(uint32_t width, uint32_t height)
+{
+#ifdef _WIN32
+	return std::make_unique<Win32Window>(width, height);
+#else
+	(void)width;
+	(void)height;
+	throw std::runtime_error("no native window backend on this platform; use --headless");
+#endif
+}
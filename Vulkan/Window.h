@@ -0,0 +1,50 @@
+#pragma once
+#include "Dispatch.h"
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "EventQueue.h"
+
+enum class WindowEventType : uint8_t {
+	Close,
+	Resize,
+	KeyDown,
+	KeyUp,
+	MouseMove
+};
+
+struct WindowEvent {
+	WindowEventType type;
+	// Resize: new client size; MouseMove: cursor position in client coordinates.
+	int32_t x = 0;
+	int32_t y = 0;
+	// KeyDown/KeyUp: the platform's virtual key code.
+	uint32_t key = 0;
+};
+
+// Filled by the thread owning the window, drained by the render thread.
+using WindowEventQueue = SpscQueue<WindowEvent, 256>;
+
+// The OS side of the render loop. Every method except Wake must be called on the thread that created the window,
+// which is where the OS delivers its messages; rendering happens elsewhere and only sees the queued events.
+class Window
+{
+public:
+	virtual ~Window() = default;
+	virtual std::vector<const char*> InstanceExtensions() const = 0;
+	virtual bool PresentationSupport(vk::PhysicalDevice physicalDevice, uint32_t queueFamily) const = 0;
+	// Returns a null handle for backends without a surface.
+	virtual vk::SurfaceKHR CreateSurface(vk::Instance instance) = 0;
+	virtual void Show() = 0;
+	// Translates pending OS messages into events without blocking; false once the window is closed.
+	virtual bool PollEvents(WindowEventQueue& events) = 0;
+	// Like PollEvents, but sleeps until at least one message arrives or Wake is called.
+	virtual bool WaitEvents(WindowEventQueue& events) = 0;
+	// Makes a blocked WaitEvents return; safe from any thread.
+	virtual void Wake() = 0;
+};
+
+// A window with no surface for offscreen rendering: it never produces events and is never closed.
+std::unique_ptr<Window> CreateHeadlessWindow();
+// The platform's native window; throws where there is none.
+std::unique_ptr<Window> CreateNativeWindow(uint32_t width, uint32_t height);
@@ -10,4 +10,40 @@ struct VertexOut
     float4 color : COLOR;
 };
 
-typedef VertexOut Point;
\ No newline at end of file
+typedef VertexOut Point;
+
+// Set 0 is the bindless table (Descriptors.h): buffers and textures are selected by slot index.
+[[vk::binding(1, 0)]] Texture2D textures[];
+[[vk::binding(2, 0)]] SamplerState linearSampler;
+
+// Set 1 is the per-frame uniform ring, bound with a dynamic offset.
+struct Frame
+{
+    // xy: pan, z: zoom.
+    float4 view;
+    float time;
+};
+
+[[vk::binding(0, 1)]] ConstantBuffer<Frame> frame;
+
+struct DrawConstants
+{
+    uint instanceBuffer;
+};
+
+[[vk::push_constant]] DrawConstants draw;
+
+// Specialization constants, set per pipeline variant (PipelineKey::constants).
+// 0: vertex color times instance color, 1: vertex color, 2: instance color.
+[[vk::constant_id(0)]] const uint ColorSource = 0;
+
+// Inverse of EncodeOctahedral in VertexFormat.h, for normals fetched as R16G16Snorm.
+float3 DecodeOctahedral(float2 e)
+{
+    float3 n = float3(e, 1 - abs(e.x) - abs(e.y));
+    float t = saturate(-n.z);
+    // Per component: HLSL 2021, dxc's default, only takes scalar ternary conditions.
+    n.x += n.x >= 0 ? -t : t;
+    n.y += n.y >= 0 ? -t : t;
+    return normalize(n);
+}
\ No newline at end of file
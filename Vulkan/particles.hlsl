@@ -0,0 +1,78 @@
+// Particle simulation, dispatched on the compute queue (Particles.h). Positions and velocities persist in one
+// buffer; every step also writes the instances the scene pipeline draws the particles with, in the layout of
+// Instance in vs.hlsl, into another.
+
+// Set 0 is the bindless table (Descriptors.h), read here as raw buffers so one declaration covers both layouts.
+[[vk::binding(0, 0)]] RWByteAddressBuffer buffers[];
+
+// ParticleConstants in Particles.h.
+struct Constants
+{
+    uint stateBuffer;
+    uint instanceBuffer;
+    uint count;
+    // Non-zero on the first step: scatter the particles instead of integrating.
+    uint reset;
+    // xyz: quantization center, w: quantization scale of the sprite's positions.
+    float4 fold;
+    float size;
+    float dt;
+};
+
+[[vk::push_constant]] Constants particles;
+
+static const uint StateStride = 32;
+static const uint InstanceStride = 32;
+// Strength of the pull toward the center, and the softening that keeps it finite there.
+static const float Gravity = 0.05;
+static const float Softening = 0.01;
+
+uint Hash(uint x)
+{
+    x ^= x >> 16;
+    x *= 0x7feb352d;
+    x ^= x >> 15;
+    x *= 0x846ca68b;
+    x ^= x >> 16;
+    return x;
+}
+
+float Random(uint seed)
+{
+    return (Hash(seed) & 0xffffff) / 16777216.0;
+}
+
+[numthreads(256, 1, 1)]
+void main(uint3 id : SV_DispatchThreadID)
+{
+    uint i = id.x;
+    if (i >= particles.count) return;
+    RWByteAddressBuffer state = buffers[particles.stateBuffer];
+    float4 position;
+    float4 velocity;
+    if (particles.reset != 0) {
+        // A disc of particles on circular orbits.
+        float angle = Random(i * 2) * 6.2831853;
+        float radius = max(sqrt(Random(i * 2 + 1)) * 0.9, 0.05);
+        position = float4(cos(angle) * radius, sin(angle) * radius, 0, 0);
+        velocity = float4(-sin(angle), cos(angle), 0, 0) * sqrt(Gravity / radius);
+    }
+    else {
+        position = asfloat(state.Load4(i * StateStride));
+        velocity = asfloat(state.Load4(i * StateStride + 16));
+        float2 toCenter = -position.xy;
+        float distanceSq = dot(toCenter, toCenter) + Softening;
+        velocity.xy += toCenter * (Gravity * rsqrt(distanceSq) / distanceSq * particles.dt);
+        position.xy += velocity.xy * particles.dt;
+    }
+    state.Store4(i * StateStride, asuint(position));
+    state.Store4(i * StateStride + 16, asuint(velocity));
+    // The same fold of the position quantization into the transform that VulkanApp applies to CPU instances.
+    float s = particles.size;
+    float4 offsetScale = float4(position.xy + particles.fold.xy * s, s * particles.fold.w, position.z + particles.fold.z * s);
+    float speed = length(velocity.xy);
+    float4 color = float4(saturate(speed * 2), 0.4, saturate(1 - speed * 2), 1);
+    RWByteAddressBuffer instances = buffers[particles.instanceBuffer];
+    instances.Store4(i * InstanceStride, asuint(offsetScale));
+    instances.Store4(i * InstanceStride + 16, asuint(color));
+}
\ No newline at end of file
@@ -1,9 +1,20 @@
 #include "header.hlsli"
 
-VertexOut main(VertexIn vIn)
+struct Instance
 {
+    float4 offsetScale;
+    float4 color;
+};
+
+[[vk::binding(0, 0)]] StructuredBuffer<Instance> buffers[];
+
+// SV_InstanceID maps to InstanceIndex, which already includes the draw's firstInstance.
+VertexOut main(VertexIn vIn, uint instanceId : SV_InstanceID)
+{
+    Instance instance = buffers[draw.instanceBuffer][instanceId];
     VertexOut vOut;
-    vOut.pos = float4(vIn.pos, 1);
-    vOut.color = vIn.color;
+    vOut.pos = float4(vIn.pos * instance.offsetScale.z + instance.offsetScale.xyw, 1);
+    vOut.pos.xy = (vOut.pos.xy + frame.view.xy) * frame.view.z;
+    vOut.color = ColorSource == 1 ? vIn.color : ColorSource == 2 ? instance.color : vIn.color * instance.color;
     return vOut;
 }
\ No newline at end of file